@@ -0,0 +1,497 @@
+#include <QtTest>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include "EngineClient.h"
+#include "EngineServer.h"
+#include "StateStore.h"
+#include "TimeAccount.h"
+#include "TrackerEngine.h"
+
+namespace {
+
+const char *const CheckpointWriterArgument = "--checkpoint-writer";
+
+// Child process of stateStoreSurvivesKill: writes state as fast as it can
+// until it is killed. Elapsed time only grows, so every record names the
+// moment it was written.
+int runCheckpointWriter(const QString &directory)
+{
+    StateStore store(directory);
+    TimerState state;
+    state.running = true;
+    state.selectedTaskId = 3;
+    state.clientSessionId = "kill-test";
+    store.save(state);
+    QTextStream(stdout) << "ready" << Qt::endl;
+
+    for (qint64 elapsed = 1;; ++elapsed) {
+        // A full record now and then, as on a task change
+        if (elapsed % 500 == 0) {
+            state.elapsedMsecs = elapsed;
+            store.save(state);
+        } else {
+            store.checkpoint(elapsed);
+        }
+    }
+}
+
+quint32 crc32(const char *data, qsizetype size)
+{
+    quint32 crc = ~0u;
+    for (qsizetype i = 0; i < size; ++i) {
+        crc ^= quint8(data[i]);
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+    }
+    return ~crc;
+}
+
+struct StateLogScan
+{
+    qint64 elapsed = -1;   // of the last intact record
+    qint64 lastStart = 0;  // offset of that record
+    qint64 intactEnd = 0;  // bytes up to the first damaged one
+};
+
+// Walks a timer state log independently of StateStore. Records are
+// [u32 length][u8 op][payload][u32 crc32 of op + payload]; full records
+// are a QDataStream with the elapsed time first, checkpoints start with it
+// in little-endian.
+StateLogScan scanStateLog(const QByteArray &log)
+{
+    StateLogScan scan;
+    qint64 at = 0;
+    while (at + 9 <= log.size()) {
+        const char *record = log.constData() + at;
+        const quint32 length = qFromLittleEndian<quint32>(record);
+        if (at + 9 + length > log.size()
+            || qFromLittleEndian<quint32>(record + 5 + length) != crc32(record + 4, 1 + length))
+            break;
+        scan.elapsed = record[4] == 1 ? qFromBigEndian<qint64>(record + 5) : qFromLittleEndian<qint64>(record + 5);
+        scan.lastStart = at;
+        at += 9 + length;
+    }
+    scan.intactEnd = at;
+    return scan;
+}
+
+// Stands in for the REST API: a login succeeds, anything else is answered
+// with {"id": 1}. One request per connection.
+class ApiStub : public QTcpServer
+{
+public:
+    ApiStub()
+    {
+        connect(this, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket *socket = nextPendingConnection()) {
+                connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { respond(socket); });
+                connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+                    requests.remove(socket);
+                    socket->deleteLater();
+                });
+            }
+        });
+    }
+
+private:
+    void respond(QTcpSocket *socket)
+    {
+        QByteArray &request = requests[socket];
+        request += socket->readAll();
+        const qsizetype headerEnd = request.indexOf("\r\n\r\n");
+        if (headerEnd < 0)
+            return;
+        qint64 length = 0;
+        const QList<QByteArray> headers = request.left(headerEnd).split('\n');
+        for (const QByteArray &header : headers) {
+            if (header.toLower().startsWith("content-length:"))
+                length = header.mid(15).trimmed().toLongLong();
+        }
+        if (request.size() < headerEnd + 4 + length)
+            return;
+
+        const QByteArray body = request.split(' ').value(1) == "/api/v1/login"
+            ? QByteArray(R"({"success":true,"data":{"token":"test-token","user":{"id":7,"name":"Test User","task":[{"id":1,"name":"Task"}]}}})")
+            : QByteArray(R"({"id":1})");
+        socket->write("HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: close\r\nContent-Length: "
+                      + QByteArray::number(body.size()) + "\r\n\r\n" + body);
+        socket->disconnectFromHost();
+    }
+
+    QHash<QTcpSocket *, QByteArray> requests;
+};
+
+// An engine on its own thread as the daemon runs it, with the API stub on
+// another: the test's thread blocks in EngineClient calls
+class RunningEngine
+{
+public:
+    RunningEngine()
+    {
+        api = new ApiStub;
+        api->moveToThread(&apiThread);
+        apiThread.start();
+        QMetaObject::invokeMethod(api, [this]() { api->listen(QHostAddress::LocalHost); },
+                                  Qt::BlockingQueuedConnection);
+
+        QSettings settings("YourCompany", "TimeTrackerApp");
+        settings.setValue("api/baseUrl", QString("http://127.0.0.1:%1").arg(api->serverPort()));
+        settings.setValue("session/remember", false);
+        settings.sync();
+
+        engine = new TrackerEngine;
+        engine->moveToThread(&engineThread);
+        QObject::connect(&engineThread, &QThread::finished, engine, &QObject::deleteLater);
+        engineThread.start();
+        QMetaObject::invokeMethod(engine, &TrackerEngine::initialize, Qt::BlockingQueuedConnection);
+    }
+
+    ~RunningEngine()
+    {
+        QMetaObject::invokeMethod(engine, &TrackerEngine::shutdown, Qt::BlockingQueuedConnection);
+        engineThread.quit();
+        engineThread.wait();
+        QMetaObject::invokeMethod(api, [this]() { delete api; }, Qt::BlockingQueuedConnection);
+        apiThread.quit();
+        apiThread.wait();
+    }
+
+    bool isListening() const { return api->isListening(); }
+
+private:
+    QThread engineThread;
+    QThread apiThread;
+    TrackerEngine *engine;
+    ApiStub *api;
+};
+
+}
+
+// Correctness checks for the headless engine library. Links nothing that
+// needs a display, so it runs under a plain QCoreApplication; the engine
+// cases use a private control socket and settings.
+class EngineTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir settingsDirectory;
+
+private slots:
+    void initTestCase()
+    {
+        // Settings, engine data and the control socket of this run only
+        QVERIFY(settingsDirectory.isValid());
+        QStandardPaths::setTestModeEnabled(true);
+        QSettings::setPath(QSettings::NativeFormat, QSettings::UserScope, settingsDirectory.path());
+        QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, settingsDirectory.path());
+        const QByteArray user = "engine-test-" + QByteArray::number(QCoreApplication::applicationPid());
+        qputenv("USER", user);
+        qputenv("USERNAME", user);
+    }
+
+    void init()
+    {
+        QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+    }
+
+    // Days of a session driven tick by tick through an injected steady
+    // clock, with pauses, resumes, suspends and wall-clock jumps thrown in.
+    // The account's total must equal the steady intervals summed here,
+    // to the millisecond, however irregular the ticks.
+    void timeAccountDrift_data()
+    {
+        QTest::addColumn<quint32>("seed");
+        QTest::addColumn<int>("days");
+        QTest::newRow("2 days") << 1u << 2;
+        QTest::newRow("5 days") << 2u << 5;
+        QTest::newRow("9 days") << 3u << 9;
+    }
+
+    void timeAccountDrift()
+    {
+        QFETCH(quint32, seed);
+        QFETCH(int, days);
+        const qint64 hour = 60 * 60 * 1000;
+
+        const qint64 steadyStart = 123456789;
+        qint64 steady = steadyStart;
+        // Jumps and suspends move only the wall clock, which the account
+        // must never read; a DST change falls in the first night
+        const qint64 wallStart = QDateTime(QDate(2024, 3, 30), QTime(22, 0)).toMSecsSinceEpoch();
+        qint64 wall = wallStart;
+        TimeAccount account([&steady]() { return steady; });
+
+        QRandomGenerator random(seed);
+        qint64 expected = 0;     // closed intervals, summed independently
+        qint64 openSince = -1;   // steady start of the open interval
+        qint64 carried = 0;      // moved over by simulated restarts
+        const qint64 end = steady + days * 24 * hour;
+
+        while (steady < end) {
+            // A UI tick, late or early like a coalesced timer
+            const qint64 tick = 700 + random.bounded(900);
+            steady += tick;
+            wall += tick;
+
+            switch (random.bounded(2000)) {
+            case 0:
+            case 1:
+                // Start or pause
+                if (openSince < 0) {
+                    account.start();
+                    openSince = steady;
+                } else {
+                    account.pause();
+                    expected += steady - openSince;
+                    openSince = -1;
+                }
+                break;
+            case 2:
+                // NTP correction or DST change
+                wall += random.bounded(int(4 * hour)) - 2 * hour;
+                break;
+            case 3:
+                // Suspend: wall time passes, steady time doesn't
+                wall += random.bounded(int(8 * hour));
+                break;
+            case 4:
+                // Restart from the saved total while paused
+                if (openSince < 0) {
+                    carried = account.elapsedMsecs();
+                    account.reset(carried);
+                    expected = 0;
+                }
+                break;
+            default:
+                break;
+            }
+
+            const qint64 open = openSince >= 0 ? steady - openSince : 0;
+            QCOMPARE(account.elapsedMsecs(), carried + expected + open);
+            QCOMPARE(account.isRunning(), openSince >= 0);
+            const int toNextSecond = account.msecsToNextSecond();
+            QVERIFY(toNextSecond > 0 && toNextSecond <= 1000);
+        }
+
+        // The recorded intervals are the steady intervals, nothing more
+        qint64 recorded = 0;
+        for (const TimeAccount::Interval &interval : account.intervals())
+            recorded += interval.end - interval.start;
+        QCOMPARE(recorded, expected);
+        // The clocks really did part ways
+        QVERIFY(wall - wallStart != steady - steadyStart);
+    }
+
+    // A writer is killed at random points mid-stream; on reopen the store
+    // must come back with the last record that made it to disk intact, and
+    // a half-written or corrupt tail must be cut off rather than replayed
+    void stateStoreSurvivesKill()
+    {
+        QTemporaryDir directory;
+        QVERIFY(directory.isValid());
+        const QString logPath = QDir(directory.path()).filePath("timer-state.log");
+        QRandomGenerator random(15);
+
+        for (int round = 0; round < 12; ++round) {
+            QProcess writer;
+            writer.start(QCoreApplication::applicationFilePath(), { CheckpointWriterArgument, directory.path() });
+            QVERIFY(writer.waitForReadyRead(10000));
+            QThread::msleep(random.bounded(1, 50));
+            writer.kill();
+            QVERIFY(writer.waitForFinished(10000));
+
+            QFile file(logPath);
+            QVERIFY(file.open(QIODevice::ReadWrite));
+            const StateLogScan killed = scanStateLog(file.readAll());
+            QVERIFY(killed.elapsed >= 0);
+
+            // A kill rarely lands inside a write() call, so tear the tail
+            // on purpose: part of a copy of the last record, or all of it
+            // with its elapsed time changed under a stale CRC
+            file.seek(killed.lastStart);
+            QByteArray torn = file.read(killed.intactEnd - killed.lastStart);
+            if (random.bounded(2))
+                torn.truncate(1 + random.bounded(int(torn.size()) - 1));
+            else
+                torn[torn[4] == 1 ? 12 : 5] = char(torn[torn[4] == 1 ? 12 : 5] ^ 1);
+            file.resize(killed.intactEnd);
+            file.seek(killed.intactEnd);
+            file.write(torn);
+            file.close();
+
+            {
+                StateStore store(directory.path());
+                QVERIFY(store.hasState());
+                QCOMPARE(store.state().elapsedMsecs, killed.elapsed);
+                QCOMPARE(store.state().clientSessionId, QString("kill-test"));
+                QCOMPARE(store.state().selectedTaskId, 3);
+            }
+
+            // Truncated (or compacted) to intact records only
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            const QByteArray reopened = file.readAll();
+            file.close();
+            const StateLogScan recovered = scanStateLog(reopened);
+            QCOMPARE(recovered.intactEnd, qint64(reopened.size()));
+            QCOMPARE(recovered.elapsed, killed.elapsed);
+        }
+    }
+
+    // The control protocol end to end: an engine on its own thread under a
+    // plain QCoreApplication, driven through EngineClient
+    void engineOverIpc()
+    {
+        RunningEngine running;
+        QVERIFY(running.isListening());
+        EngineClient client;
+        QVERIFY2(client.connectToEngine(TrackerEngine::socketName()), qPrintable(client.errorString()));
+
+        QJsonObject reply = client.call({ { "cmd", "status" } });
+        QVERIFY(reply["ok"].toBool());
+        QVERIFY(!EngineStatus::fromJson(reply["status"].toObject()).loggedIn);
+
+        reply = client.call({ { "cmd", "start" }, { "taskId", 1 } });
+        QVERIFY(!reply["ok"].toBool());
+        QCOMPARE(reply["error"].toString(), QString("not logged in"));
+
+        // Login answers through events
+        QVERIFY(client.call({ { "cmd", "subscribe" } })["ok"].toBool());
+        reply = client.call({ { "cmd", "login" }, { "email", "test@example.com" }, { "password", "secret" } });
+        QVERIFY(reply["ok"].toBool());
+        bool loggedIn = false;
+        QDeadlineTimer deadline(10000);
+        while (!loggedIn && !deadline.hasExpired()) {
+            const QJsonObject event = client.nextEvent(int(deadline.remainingTime()));
+            QVERIFY2(!event.isEmpty(), "no login event");
+            QVERIFY2(event["event"].toString() != "loginFailed", qPrintable(event["message"].toString()));
+            loggedIn = event["event"].toString() == "status" && event["status"].toObject()["loggedIn"].toBool();
+        }
+        QVERIFY(loggedIn);
+
+        reply = client.call({ { "cmd", "start" }, { "taskId", 1 } });
+        QVERIFY2(reply["ok"].toBool(), qPrintable(reply["error"].toString()));
+        EngineStatus status = EngineStatus::fromJson(reply["status"].toObject());
+        QVERIFY(status.running);
+        QCOMPARE(status.taskId, 1);
+        QCOMPARE(status.userId, 7);
+        QVERIFY(!status.clientSessionId.isEmpty());
+        const QString clientSessionId = status.clientSessionId;
+
+        QThread::msleep(50);
+        reply = client.call({ { "cmd", "pause" } });
+        QVERIFY(reply["ok"].toBool());
+        status = EngineStatus::fromJson(reply["status"].toObject());
+        QVERIFY(!status.running);
+        QVERIFY(status.paused);
+        QVERIFY(status.elapsedMsecs >= 50);
+        const qint64 pausedAt = status.elapsedMsecs;
+
+        // Paused time doesn't count, and a paused session can't be restarted
+        QThread::msleep(50);
+        reply = client.call({ { "cmd", "status" } });
+        QCOMPARE(EngineStatus::fromJson(reply["status"].toObject()).elapsedMsecs, pausedAt);
+        reply = client.call({ { "cmd", "start" } });
+        QVERIFY(!reply["ok"].toBool());
+        QCOMPARE(reply["error"].toString(), QString("a session is paused; resume or stop it"));
+
+        reply = client.call({ { "cmd", "resume" } });
+        status = EngineStatus::fromJson(reply["status"].toObject());
+        QVERIFY(status.running);
+        QCOMPARE(status.clientSessionId, clientSessionId);
+
+        reply = client.call({ { "cmd", "summary" }, { "period", "week" } });
+        QVERIFY(reply["ok"].toBool());
+        const QJsonObject summary = reply["summary"].toObject();
+        QCOMPARE(summary["period"].toString(), QString("week"));
+        QCOMPARE(QDate::fromString(summary["from"].toString(), Qt::ISODate).dayOfWeek(), 1);
+        QVERIFY(summary["tasks"].isArray());
+        QVERIFY(summary["totalSecs"].toInteger() >= 0);
+
+        reply = client.call({ { "cmd", "stop" } });
+        status = EngineStatus::fromJson(reply["status"].toObject());
+        QVERIFY(!status.running);
+        QVERIFY(!status.paused);
+        QCOMPARE(status.elapsedMsecs, qint64(0));
+        QVERIFY(status.clientSessionId.isEmpty());
+
+        reply = client.call({ { "cmd", "bogus" } });
+        QVERIFY(!reply["ok"].toBool());
+        QCOMPARE(reply["error"].toString(), QString("unknown command: bogus"));
+    }
+
+    // A request longer than the limit is refused as a whole. Its bytes
+    // past the limit are a valid request on their own, which must not be
+    // answered; the connection stays usable.
+    void engineRejectsOverlongLine_data()
+    {
+        QTest::addColumn<bool>("split");
+        QTest::newRow("one write") << false;
+        // The server sees more than a line's worth before any newline
+        QTest::newRow("two writes") << true;
+    }
+
+    void engineRejectsOverlongLine()
+    {
+        QFETCH(bool, split);
+        RunningEngine running;
+        QLocalSocket socket;
+        socket.connectToServer(TrackerEngine::socketName());
+        QVERIFY(socket.waitForConnected(5000));
+
+        QByteArray line = R"({"cmd":"status","pad":")";
+        line += QByteArray(EngineServer::MaxLineBytes + 4096 - line.size(), 'x');
+        line += R"({"cmd":"status","id":99})";
+
+        QList<QJsonObject> replies;
+        auto readReplies = [&socket, &replies](int count) {
+            while (replies.size() < count) {
+                if (!socket.canReadLine() && !socket.waitForReadyRead(5000))
+                    return false;
+                while (socket.canReadLine())
+                    replies.append(QJsonDocument::fromJson(socket.readLine()).object());
+            }
+            return true;
+        };
+
+        if (split) {
+            socket.write(line.left(EngineServer::MaxLineBytes + 1024));
+            while (socket.bytesToWrite() > 0)
+                QVERIFY(socket.waitForBytesWritten(5000));
+            // Refused before the newline is even sent
+            QVERIFY2(readReplies(1), "no reply to the first piece");
+            line = line.mid(EngineServer::MaxLineBytes + 1024);
+        }
+        socket.write(line + '\n');
+        socket.write(R"({"cmd":"status","id":100})" "\n");
+        while (socket.bytesToWrite() > 0)
+            QVERIFY(socket.waitForBytesWritten(5000));
+
+        QVERIFY2(readReplies(2), "no reply");
+        QCOMPARE(replies.size(), 2);
+        QVERIFY(!replies[0]["ok"].toBool());
+        QCOMPARE(replies[0]["error"].toString(), QString("request too long"));
+        QCOMPARE(replies[1]["id"].toInt(), 100);
+        QCOMPARE(socket.state(), QLocalSocket::ConnectedState);
+    }
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    if (argc == 3 && qstrcmp(argv[1], CheckpointWriterArgument) == 0)
+        return runCheckpointWriter(QString::fromLocal8Bit(argv[2]));
+
+    EngineTest test;
+    return QTest::qExec(&test, argc, argv);
+}
+#include "EngineTest.moc"
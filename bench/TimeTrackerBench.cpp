@@ -0,0 +1,400 @@
+#include <QtTest>
+#include <QGuiApplication>
+#include <QPainter>
+#include <QImageWriter>
+#include <QHttpMultiPart>
+#include <QJsonDocument>
+#include <QRandomGenerator>
+#include <QTemporaryFile>
+#include <QTemporaryDir>
+#include "ScreenshotPipeline.h"
+#include "ScreenCapture.h"
+#include "ScreenshotScheduler.h"
+#include "TileDeltaEncoder.h"
+#include "PreviewRenderer.h"
+#include "Redaction.h"
+#include "UploadQueue.h"
+#include "UploadBodyDevice.h"
+#include "TrackTimePayload.h"
+#include "TaskCatalog.h"
+#include "ActivityLog.h"
+#include "InputActivity.h"
+
+// Hot-path benchmarks for capture, encode and upload preparation. Frames are
+// synthetic so the suite runs under QT_QPA_PLATFORM=offscreen on CI.
+class TimeTrackerBench : public QObject
+{
+    Q_OBJECT
+
+private:
+    // Desktop-like content: gradient wallpaper, flat windows and rows of
+    // high-frequency "text" that stress the entropy coders
+    static QImage syntheticFrame(const QSize &size, quint32 seed = 1)
+    {
+        QImage frame(size, QImage::Format_RGB32);
+        QPainter painter(&frame);
+        QLinearGradient wallpaper(0, 0, size.width(), size.height());
+        wallpaper.setColorAt(0, QColor(32, 64, 128));
+        wallpaper.setColorAt(1, QColor(96, 32, 96));
+        painter.fillRect(frame.rect(), wallpaper);
+
+        QRandomGenerator random(seed);
+        for (int w = 0; w < 6; ++w) {
+            const QRect window(random.bounded(size.width() / 2), random.bounded(size.height() / 2),
+                               size.width() / 3 + random.bounded(size.width() / 4),
+                               size.height() / 3 + random.bounded(size.height() / 4));
+            painter.fillRect(window, QColor(240, 240, 240));
+            painter.fillRect(window.x(), window.y(), window.width(), 28, QColor(60, 60, 70));
+            for (int y = window.y() + 40; y < window.bottom() - 12; y += 18) {
+                for (int x = window.x() + 8; x < window.right() - 8; x += 7 + random.bounded(5)) {
+                    if (random.bounded(6) != 0)
+                        painter.fillRect(x, y, 5, 11, QColor(20, 20, 20));
+                }
+            }
+        }
+        return frame;
+    }
+
+    static void addResolutionRows(const char *format, EncoderSettings::Format value)
+    {
+        const QList<QPair<const char *, QSize>> sizes = {
+            { "1080p", QSize(1920, 1080) },
+            { "1440p", QSize(2560, 1440) },
+            { "4K", QSize(3840, 2160) },
+        };
+        for (const auto &size : sizes)
+            QTest::addRow("%s-%s", format, size.first) << int(value) << size.second;
+    }
+
+private slots:
+    void grab_data()
+    {
+        QTest::addColumn<bool>("strips");
+        QTest::newRow("full") << false;
+        QTest::newRow("probeStrips") << true;
+    }
+
+    void grab()
+    {
+        QFETCH(bool, strips);
+        if (QGuiApplication::screens().isEmpty())
+            QSKIP("No screen available");
+
+        QBENCHMARK {
+            const QList<CapturedScreen> screens = strips
+                ? ScreenCapture::grabStrips(ScreenCapture::PerScreen, ScreenshotScheduler::ProbeRows)
+                : ScreenCapture::grab(ScreenCapture::PerScreen);
+            Q_UNUSED(screens);
+        }
+    }
+
+    // The scheduler hashes band-centre strips instead of full grabs; both
+    // must give the same hash
+    void probeHash()
+    {
+        const QImage frame = syntheticFrame(QSize(1920, 1080), 5);
+        const int rows = ScreenshotScheduler::ProbeRows;
+        QImage strips(frame.width(), rows, QImage::Format_RGB32);
+        for (int row = 0; row < rows; ++row) {
+            const int y = (row * 2 + 1) * frame.height() / (2 * rows);
+            memcpy(strips.scanLine(row), frame.constScanLine(y), strips.bytesPerLine());
+        }
+
+        quint64 hash = 0;
+        QBENCHMARK {
+            hash = ScreenshotScheduler::differenceHash(strips);
+        }
+        QCOMPARE(hash, ScreenshotScheduler::differenceHash(frame));
+    }
+
+    void encode_data()
+    {
+        QTest::addColumn<int>("format");
+        QTest::addColumn<QSize>("size");
+        addResolutionRows("png", EncoderSettings::Png);
+        addResolutionRows("jpeg", EncoderSettings::Jpeg);
+        addResolutionRows("webp", EncoderSettings::WebP);
+    }
+
+    void encode()
+    {
+        QFETCH(int, format);
+        QFETCH(QSize, size);
+        if (format == EncoderSettings::WebP && !QImageWriter::supportedImageFormats().contains("webp"))
+            QSKIP("WebP image plugin not installed");
+
+        const QImage frame = syntheticFrame(size);
+        EncoderSettings settings;
+        settings.format = EncoderSettings::Format(format);
+        settings.quality = format == EncoderSettings::Png ? -1 : 80;
+
+        qsizetype bytes = 0;
+        QBENCHMARK {
+            bytes = ScreenshotPipeline::encodeStill(frame, settings).data.size();
+        }
+        QVERIFY(bytes > 0);
+        qInfo("%s: %lld bytes", QTest::currentDataTag(), qint64(bytes));
+    }
+
+    void tileDelta_data()
+    {
+        QTest::addColumn<QSize>("size");
+        QTest::newRow("1080p") << QSize(1920, 1080);
+        QTest::newRow("4K") << QSize(3840, 2160);
+    }
+
+    void tileDelta()
+    {
+        QFETCH(QSize, size);
+        const QImage previous = syntheticFrame(size);
+        QImage next = previous.copy();
+        QPainter(&next).fillRect(100, 100, 300, 40, Qt::red);
+
+        TileDeltaEncoder encoder(64, 1000);
+        encoder.encode(previous);
+
+        qsizetype bytes = 0;
+        QBENCHMARK {
+            bytes = encoder.encode(next).size();
+        }
+        QVERIFY(bytes > 0);
+    }
+
+    void previewScale_data()
+    {
+        QTest::addColumn<bool>("boxFilter");
+        QTest::newRow("box") << true;
+        QTest::newRow("qt-smooth") << false;
+    }
+
+    void previewScale()
+    {
+        QFETCH(bool, boxFilter);
+        const QImage frame = syntheticFrame(QSize(3840, 2160));
+        QImage preview(640, 360, QImage::Format_RGB32);
+        QVector<quint16> scratch;
+
+        if (boxFilter) {
+            QBENCHMARK {
+                PreviewRenderer::downscale(frame.constBits(), frame.width(), frame.height(),
+                                           frame.bytesPerLine(), preview, scratch);
+            }
+        } else {
+            QBENCHMARK {
+                preview = frame.scaled(preview.size(), Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            }
+        }
+    }
+
+    // Budget: under 5 ms per 4K frame on top of the encode
+    void redact_data()
+    {
+        QTest::addColumn<int>("style");
+        QTest::addColumn<bool>("fullFrame");
+        QTest::newRow("fill-windows") << int(RedactionRules::Fill) << false;
+        QTest::newRow("pixelate-windows") << int(RedactionRules::Pixelate) << false;
+        QTest::newRow("fill-full") << int(RedactionRules::Fill) << true;
+        QTest::newRow("pixelate-full") << int(RedactionRules::Pixelate) << true;
+    }
+
+    void redact()
+    {
+        QFETCH(int, style);
+        QFETCH(bool, fullFrame);
+        // A 4K screen at 200% scaling: 1920x1080 logical
+        QImage frame = syntheticFrame(QSize(3840, 2160));
+        const QRect geometry(0, 0, 1920, 1080);
+        QList<QRect> regions;
+        if (fullFrame) {
+            regions << geometry;
+        } else {
+            // A password manager, a chat window and a fixed strip, overlapping
+            regions << QRect(100, 80, 700, 500) << QRect(600, 400, 900, 600) << QRect(0, 1040, 1920, 40);
+        }
+
+        QBENCHMARK {
+            Redaction::apply(frame, geometry, regions, RedactionRules::Style(style), 24);
+        }
+        QCOMPARE(frame.pixel(200, 200), frame.pixel(201, 201));
+    }
+
+    void multipart_data()
+    {
+        QTest::addColumn<bool>("streamed");
+        QTest::newRow("inline") << false;
+        QTest::newRow("journal") << true;
+    }
+
+    void multipart()
+    {
+        QFETCH(bool, streamed);
+        UploadItem item;
+        item.kind = UploadItem::Screenshot;
+        item.contentType = "image/png";
+        item.fileName = "screenshot.png";
+        item.body = QByteArray(2 * 1024 * 1024, 'x');
+        item.fields["sessionId"] = "12345";
+        item.fields["clientSessionId"] = "0b7c7f0e-8d5a-4f7e-9a57-3e4a6f1c2d10";
+
+        QTemporaryFile journal;
+        if (streamed) {
+            QVERIFY(journal.open());
+            journal.write(item.body);
+            journal.flush();
+            item.bodyOffset = 0;
+            item.bodySize = item.body.size();
+            item.body = QByteArray();
+        }
+
+        QBENCHMARK {
+            QHttpMultiPart *multiPart = nullptr;
+            if (streamed) {
+                auto *device = new UploadBodyDevice(journal.fileName(), item.bodyOffset, item.bodySize);
+                device->open(QIODevice::ReadOnly);
+                multiPart = UploadQueue::buildMultiPart(item, device);
+            } else {
+                multiPart = UploadQueue::buildMultiPart(item);
+            }
+            delete multiPart;
+        }
+    }
+
+    void trackTimeJson_data()
+    {
+        QTest::addColumn<bool>("compact");
+        QTest::newRow("indented") << false;
+        QTest::newRow("compact") << true;
+    }
+
+    void trackTimeJson()
+    {
+        QFETCH(bool, compact);
+        const QString clientSessionId = "0b7c7f0e-8d5a-4f7e-9a57-3e4a6f1c2d10";
+        const QJsonDocument::JsonFormat format = compact ? QJsonDocument::Compact : QJsonDocument::Indented;
+
+        QBENCHMARK {
+            QByteArray body = QJsonDocument(trackTimePayload(4821, 3725, 17, 42, clientSessionId)).toJson(format);
+            Q_UNUSED(body);
+        }
+    }
+
+    void taskSearch_data()
+    {
+        QTest::addColumn<QString>("query");
+        QTest::newRow("prefix-1") << "d";
+        QTest::newRow("prefix-2") << "de";
+        QTest::newRow("substring") << "ploy";
+        QTest::newRow("two-terms") << "api mig";
+        QTest::newRow("rare") << "task 4217";
+    }
+
+    void taskSearch()
+    {
+        QFETCH(QString, query);
+        // 50k names built from project-like words
+        static const QStringList words = {
+            "Deploy", "API", "Migration", "Review", "Design", "Backend", "Frontend", "Invoice",
+            "Meeting", "Support", "Research", "Database", "Onboarding", "Testing", "Release"
+        };
+        static const TaskSearchIndex index = [] {
+            QVector<TaskInfo> tasks;
+            QRandomGenerator random(7);
+            for (int i = 0; i < 50000; ++i)
+                tasks.append({ i, QString("%1 %2 - task %3").arg(words.at(random.bounded(int(words.size()))),
+                                                                  words.at(random.bounded(int(words.size())))).arg(i) });
+            TaskSearchIndex built;
+            built.build(tasks);
+            return built;
+        }();
+
+        QBENCHMARK {
+            QVector<int> matches = index.search(query);
+            Q_UNUSED(matches);
+        }
+    }
+
+    void activityLog_data()
+    {
+        QTest::addColumn<bool>("query");
+        QTest::newRow("heartbeat") << false;
+        QTest::newRow("weekTotals") << true;
+    }
+
+    void activityLog()
+    {
+        QFETCH(bool, query);
+        QTemporaryDir directory;
+        ActivityLog log(directory.path());
+
+        // A month of history, eight intervals a day over twenty tasks
+        const qint64 hour = 60 * 60 * 1000;
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        QRandomGenerator random(11);
+        for (qint64 start = now - 30 * 24 * hour; start < now - hour; start += 3 * hour) {
+            IntervalDelta delta;
+            delta.start = start;
+            delta.end = start + random.bounded(int(2 * hour));
+            delta.taskId = random.bounded(20);
+            log.record(delta);
+        }
+
+        IntervalDelta open;
+        open.start = now;
+        open.end = now;
+        open.taskId = 3;
+        if (query) {
+            qint64 total = 0;
+            QBENCHMARK {
+                total += log.totals(ActivityLog::Week, QDate::currentDate(), &open).value(3);
+            }
+            QVERIFY(total >= 0);
+        } else {
+            // Each heartbeat moves the open interval's end
+            QBENCHMARK {
+                open.end += 30000;
+                log.record(open);
+            }
+        }
+    }
+
+    void inputCounters_data()
+    {
+        QTest::addColumn<bool>("take");
+        QTest::newRow("event") << false;
+        QTest::newRow("sample") << true;
+    }
+
+    void inputCounters()
+    {
+        QFETCH(bool, take);
+        // Counting threads beside this one, as with an event source running
+        QList<QThread *> threads;
+        for (int i = 0; i < 3; ++i) {
+            threads.append(QThread::create([]() { InputCounters::add(InputCounters::Key); }));
+            threads.last()->start();
+        }
+        for (QThread *thread : std::as_const(threads)) {
+            thread->wait();
+            delete thread;
+        }
+
+        quint32 total = 0;
+        if (take) {
+            // Once a second per tracked session
+            QBENCHMARK {
+                InputCounters::add(InputCounters::Move);
+                total += InputCounters::take()[InputCounters::Move];
+            }
+        } else {
+            // Per input event
+            QBENCHMARK {
+                InputCounters::add(InputCounters::Key);
+            }
+            total = InputCounters::take()[InputCounters::Key];
+        }
+        QVERIFY(total > 0);
+    }
+};
+
+QTEST_MAIN(TimeTrackerBench)
+#include "TimeTrackerBench.moc"
@@ -0,0 +1,228 @@
+//api-stub.js
+// Minimal stand-in for the REST API, for checking how the client uses the
+// network: it counts TCP connections (or HTTP/2 sessions) and requests per
+// path, and records the encodings the client sent. Heartbeats are merged
+// with the reference aggregator. Screenshot blobs are remembered by key so
+// /api/v1/screenshot-ref can answer for frames the client didn't resend.
+// Activity rollups keep the newest totals per user and day.
+//
+// Usage: node api-stub.js [--port 3000] [--h2]
+//        GET /stats for the counters; --h2 serves cleartext HTTP/2 with
+//        prior knowledge (set api/http2Direct in the client)
+const http = require('http');
+const http2 = require('http2');
+const zlib = require('zlib');
+const { HeartbeatAggregator } = require('./heartbeat-aggregator');
+
+const MAX_BODY_BYTES = 64 * 1024 * 1024;
+
+const stats = {
+    connections: 0,
+    activeConnections: 0,
+    requests: 0,
+    byPath: {},
+    contentTypes: {},
+    contentEncodings: {},
+    wireBytes: 0,
+    bodyBytes: 0,
+    blobs: 0,
+    blobRefs: 0,
+    blobMisses: 0,
+    rollupDays: 0,
+    activityMinutes: 0
+};
+const aggregator = new HeartbeatAggregator();
+let nextSessionId = 1;
+const knownBlobs = new Set();
+// "userId/date" -> { generatedAt, tasks }
+const rollups = new Map();
+
+function count(table, key) {
+    table[key] = (table[key] || 0) + 1;
+}
+
+function readBody(req) {
+    return new Promise((resolve, reject) => {
+        const chunks = [];
+        let size = 0;
+        req.on('data', chunk => {
+            size += chunk.length;
+            if (size > MAX_BODY_BYTES) {
+                reject(new Error('body too large'));
+                req.destroy();
+                return;
+            }
+            chunks.push(chunk);
+        });
+        req.on('end', () => resolve(Buffer.concat(chunks)));
+        req.on('error', reject);
+    });
+}
+
+function decode(req, raw) {
+    const encoding = req.headers['content-encoding'] || 'identity';
+    count(stats.contentEncodings, encoding);
+    if (encoding === 'deflate') {
+        return zlib.inflateSync(raw);
+    }
+    if (encoding === 'gzip') {
+        return zlib.gunzipSync(raw);
+    }
+    return raw;
+}
+
+// Value of a plain form field in a multipart body
+function formField(body, name) {
+    const match = new RegExp(`name="${name}"\r\n\r\n([^\r]*)\r\n`).exec(body.toString('latin1'));
+    return match ? match[1] : null;
+}
+
+function send(res, status, json) {
+    res.writeHead(status, { 'Content-Type': 'application/json' });
+    res.end(JSON.stringify(json));
+}
+
+async function handle(req, res) {
+    const path = req.url.split('?')[0];
+    stats.requests++;
+    count(stats.byPath, `${req.method} ${path}`);
+
+    if (req.method === 'GET' && path === '/stats') {
+        send(res, 200, stats);
+        return;
+    }
+    if (req.method === 'GET' && path === '/api/v1/activity/rollups') {
+        send(res, 200, Object.fromEntries(rollups));
+        return;
+    }
+    if (req.method === 'GET' && path === '/api/v1/me') {
+        if (req.headers.authorization !== 'Bearer stub-token') {
+            send(res, 401, { success: false, message: 'invalid token' });
+            return;
+        }
+        send(res, 200, { success: true, data: { user: { id: 1, name: 'Stub User' } } });
+        return;
+    }
+    if (req.method !== 'POST') {
+        send(res, 404, { error: 'not found' });
+        return;
+    }
+
+    let body;
+    try {
+        const raw = await readBody(req);
+        body = decode(req, raw);
+        stats.wireBytes += raw.length;
+        stats.bodyBytes += body.length;
+    } catch (error) {
+        send(res, 400, { error: error.message });
+        return;
+    }
+
+    const contentType = (req.headers['content-type'] || '').split(';')[0];
+    count(stats.contentTypes, contentType);
+    // CBOR is counted but not decoded; answers are the same either way
+    let json = {};
+    if (contentType === 'application/json') {
+        try {
+            json = JSON.parse(body.toString('utf8'));
+        } catch (error) {
+            send(res, 400, { error: 'malformed JSON' });
+            return;
+        }
+    }
+
+    switch (path) {
+    case '/api/v1/login':
+        send(res, 200, {
+            success: true,
+            data: {
+                token: 'stub-token',
+                user: { id: 1, name: 'Stub User', task: [{ id: 1, name: 'Stub task' }] }
+            }
+        });
+        return;
+    case '/api/v1/track-time':
+        send(res, 200, { id: json.id || nextSessionId++ });
+        return;
+    case '/api/v1/track-time/heartbeat':
+        if (contentType !== 'application/json') {
+            send(res, 200, {});
+            return;
+        }
+        try {
+            const result = aggregator.apply(json);
+            stats.activityMinutes += result.activity;
+            send(res, 200, result);
+        } catch (error) {
+            send(res, 400, { error: error.message });
+        }
+        return;
+    case '/api/v1/activity/rollups':
+        if (contentType !== 'application/json') {
+            send(res, 200, {});
+            return;
+        }
+        for (const day of json.days || []) {
+            const key = `${json.userId}/${day.date}`;
+            const known = rollups.get(key);
+            // Each day carries its full totals; an older report is stale
+            if (known && known.generatedAt > json.generatedAt) {
+                continue;
+            }
+            if (!known) {
+                stats.rollupDays++;
+            }
+            rollups.set(key, { generatedAt: json.generatedAt, tasks: day.tasks });
+        }
+        send(res, 200, { success: true });
+        return;
+    case '/api/v1/upload-screenshot': {
+        const blob = formField(body, 'blob');
+        if (blob && !knownBlobs.has(blob)) {
+            knownBlobs.add(blob);
+            stats.blobs++;
+        }
+        send(res, 200, { success: true });
+        return;
+    }
+    case '/api/v1/screenshot-ref':
+        if (!knownBlobs.has(json.blob)) {
+            stats.blobMisses++;
+            send(res, 404, { success: false, message: 'unknown blob' });
+            return;
+        }
+        stats.blobRefs++;
+        send(res, 200, { success: true });
+        return;
+    default:
+        send(res, 404, { error: 'not found' });
+    }
+}
+
+function main(argv) {
+    let port = 3000;
+    let h2 = false;
+    for (let i = 0; i < argv.length; i++) {
+        if (argv[i] === '--port') {
+            port = Number(argv[++i]);
+        } else if (argv[i] === '--h2') {
+            h2 = true;
+        }
+    }
+
+    const server = h2 ? http2.createServer(handle) : http.createServer(handle);
+    // One TCP connection per HTTP/1.1 socket or HTTP/2 session
+    server.on(h2 ? 'session' : 'connection', connection => {
+        stats.connections++;
+        stats.activeConnections++;
+        connection.on('close', () => stats.activeConnections--);
+    });
+    server.listen(port, '127.0.0.1', () => {
+        console.log(`API stub (${h2 ? 'h2c' : 'HTTP/1.1'}) on http://127.0.0.1:${port}, stats at /stats`);
+    });
+}
+
+if (require.main === module) {
+    main(process.argv.slice(2));
+}
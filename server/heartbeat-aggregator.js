@@ -0,0 +1,201 @@
+//heartbeat-aggregator.js
+// Reference aggregator for the client's time-track heartbeats
+// (POST /api/v1/track-time/heartbeat). Every batch lists intervals of one
+// session as { start, end, taskId, seq } in epoch milliseconds. An interval
+// is identified by its start and only a higher seq may change it, so
+// batches can be retried, duplicated or reordered freely; the session
+// total is the length of the union of its intervals.
+//
+// A batch may also carry input activity, one entry per sampled minute:
+// { start, offset, keys, clicks, moves, rates } where start is the minute
+// in epoch milliseconds, offset the first sampled second in it, and rates
+// how many seconds fell into each band of events per second (0, 1-2, 3-5,
+// 6-10, 11-20, more). A minute split by a pause arrives as two entries with
+// different offsets; a repeated entry replaces itself.
+//
+// Usage: node heartbeat-aggregator.js <batches.jsonl>...
+//        (one request body per line)
+const fs = require('fs');
+
+const MAX_INTERVALS_PER_BATCH = 1000;
+const MAX_ACTIVITY_PER_BATCH = 1000;
+const RATE_BINS = 6;
+
+function isCount(value, max) {
+    return Number.isInteger(value) && value >= 0 && value <= max;
+}
+
+function validActivity(minute) {
+    return minute && Number.isSafeInteger(minute.start) && minute.start % 60000 === 0
+        && isCount(minute.offset, 59) && isCount(minute.keys, 0xffff)
+        && isCount(minute.clicks, 0xffff) && isCount(minute.moves, 0xffff)
+        && Array.isArray(minute.rates) && minute.rates.length === RATE_BINS
+        && minute.rates.every(seconds => isCount(seconds, 255));
+}
+
+function validate(body) {
+    if (!body || typeof body.clientSessionId !== 'string' || body.clientSessionId === '') {
+        return 'clientSessionId is required';
+    }
+    if (!Array.isArray(body.intervals) || body.intervals.length > MAX_INTERVALS_PER_BATCH) {
+        return 'intervals must be an array of at most ' + MAX_INTERVALS_PER_BATCH;
+    }
+    for (const interval of body.intervals) {
+        if (!Number.isSafeInteger(interval.start) || !Number.isSafeInteger(interval.end)
+            || interval.end < interval.start || !Number.isSafeInteger(interval.seq) || interval.seq < 1) {
+            return 'malformed interval';
+        }
+    }
+    if (body.activity !== undefined) {
+        if (!Array.isArray(body.activity) || body.activity.length > MAX_ACTIVITY_PER_BATCH) {
+            return 'activity must be an array of at most ' + MAX_ACTIVITY_PER_BATCH;
+        }
+        if (!body.activity.every(validActivity)) {
+            return 'malformed activity';
+        }
+    }
+    return null;
+}
+
+class HeartbeatAggregator {
+    constructor() {
+        // clientSessionId -> { userId, id, intervals: Map(start -> { end, taskId, seq }),
+        //                      activity: Map("start+offset" -> minute) }
+        this.sessions = new Map();
+    }
+
+    // Merges one request body; throws on malformed input
+    apply(body) {
+        const error = validate(body);
+        if (error) {
+            throw new Error(error);
+        }
+
+        let session = this.sessions.get(body.clientSessionId);
+        if (!session) {
+            session = { userId: body.userId, id: null, intervals: new Map(), activity: new Map() };
+            this.sessions.set(body.clientSessionId, session);
+        }
+        if (Number.isInteger(body.id)) {
+            session.id = body.id;
+        }
+
+        let applied = 0;
+        let ignored = 0;
+        for (const { start, end, taskId, seq } of body.intervals) {
+            const known = session.intervals.get(start);
+            if (known && known.seq >= seq) {
+                ignored++;
+                continue;
+            }
+            session.intervals.set(start, { end, taskId, seq });
+            applied++;
+        }
+        for (const { start, offset, keys, clicks, moves, rates } of body.activity || []) {
+            session.activity.set(`${start}+${offset}`, { start, keys, clicks, moves, rates });
+        }
+        return { applied, ignored, activity: (body.activity || []).length };
+    }
+
+    summary(clientSessionId) {
+        const session = this.sessions.get(clientSessionId);
+        if (!session) {
+            return null;
+        }
+
+        const intervals = [...session.intervals.entries()]
+            .map(([start, { end, taskId }]) => ({ start, end, taskId }))
+            .sort((a, b) => a.start - b.start);
+
+        // Union length, so overlapping reports are never counted twice
+        let totalMsecs = 0;
+        let coveredUntil = -Infinity;
+        const byTask = {};
+        for (const { start, end, taskId } of intervals) {
+            const from = Math.max(start, coveredUntil);
+            if (end > from) {
+                totalMsecs += end - from;
+                byTask[taskId] = (byTask[taskId] || 0) + end - from;
+                coveredUntil = end;
+            }
+        }
+
+        // Totals over the session, and the seconds per rate band
+        const activity = { minutes: 0, keys: 0, clicks: 0, moves: 0, activeSecs: 0, rates: new Array(RATE_BINS).fill(0) };
+        const minutes = new Set();
+        for (const { start, keys, clicks, moves, rates } of session.activity.values()) {
+            minutes.add(start);
+            activity.keys += keys;
+            activity.clicks += clicks;
+            activity.moves += moves;
+            rates.forEach((seconds, bin) => { activity.rates[bin] += seconds; });
+            activity.activeSecs += rates.slice(1).reduce((sum, seconds) => sum + seconds, 0);
+        }
+        activity.minutes = minutes.size;
+
+        return {
+            clientSessionId,
+            userId: session.userId,
+            id: session.id,
+            totalMsecs,
+            byTask,
+            firstStart: intervals.length ? intervals[0].start : null,
+            lastEnd: intervals.length ? Math.max(...intervals.map(i => i.end)) : null,
+            activity
+        };
+    }
+}
+
+// Mounts the heartbeat endpoint and a per-session summary on an express app
+function attach(app, aggregator = new HeartbeatAggregator()) {
+    const express = require('express');
+    app.post('/api/v1/track-time/heartbeat', express.json({ limit: '256kb' }), (req, res) => {
+        try {
+            res.json(aggregator.apply(req.body));
+        } catch (error) {
+            res.status(400).json({ error: error.message });
+        }
+    });
+    app.get('/api/v1/track-time/sessions/:clientSessionId', (req, res) => {
+        const summary = aggregator.summary(req.params.clientSessionId);
+        if (!summary) {
+            res.status(404).json({ error: 'unknown session' });
+            return;
+        }
+        res.json(summary);
+    });
+    return aggregator;
+}
+
+function main(argv) {
+    const aggregator = new HeartbeatAggregator();
+    let rejected = 0;
+    for (const file of argv) {
+        for (const line of fs.readFileSync(file, 'utf8').split('\n')) {
+            if (line.trim() === '') {
+                continue;
+            }
+            try {
+                aggregator.apply(JSON.parse(line));
+            } catch (error) {
+                console.error(`${file}: ${error.message}`);
+                rejected++;
+            }
+        }
+    }
+
+    for (const clientSessionId of aggregator.sessions.keys()) {
+        const { totalMsecs, byTask, userId, activity } = aggregator.summary(clientSessionId);
+        const tasks = Object.entries(byTask).map(([task, msecs]) => `task ${task} ${(msecs / 1000).toFixed(1)}s`);
+        console.log(`${clientSessionId} user ${userId}: ${(totalMsecs / 1000).toFixed(1)}s (${tasks.join(', ')})`
+            + (activity.minutes ? `, active ${activity.activeSecs}s of ${activity.minutes} min,`
+                + ` ${activity.keys} keys ${activity.clicks} clicks` : ''));
+    }
+    return rejected === 0 ? 0 : 1;
+}
+
+module.exports = { HeartbeatAggregator, attach, validate };
+
+if (require.main === module) {
+    process.exitCode = main(process.argv.slice(2));
+}
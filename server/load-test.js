@@ -0,0 +1,101 @@
+//load-test.js
+// Load test for the stream hub's fan-out. Starts a hub on a local port,
+// connects the given number of viewers spread over the streams, then
+// publishes start/end events and reports how long it took until every
+// subscriber had received each one, plus server memory.
+//
+// Usage: node load-test.js [--viewers 5000] [--streams 50] [--events 20]
+//        (needs ulimit -n above twice the viewer count)
+const { createServer } = require('http');
+const { WebSocket, WebSocketServer } = require('ws');
+const { StreamHub } = require('./stream-hub');
+
+function parseArgs(argv) {
+    const options = { viewers: 5000, streams: 50, events: 20 };
+    for (let i = 0; i < argv.length; i++) {
+        const key = argv[i].replace(/^--/, '');
+        if (key in options) {
+            options[key] = Number(argv[++i]);
+        }
+    }
+    return options;
+}
+
+function connectViewer(port, stream) {
+    return new Promise((resolve, reject) => {
+        const ws = new WebSocket(`ws://127.0.0.1:${port}/?stream=${stream}`, { perMessageDeflate: false });
+        ws.once('open', () => resolve(ws));
+        ws.once('error', reject);
+    });
+}
+
+async function main(argv) {
+    const { viewers, streams, events } = parseArgs(argv);
+
+    const httpServer = createServer();
+    const wsServer = new WebSocketServer({ server: httpServer, perMessageDeflate: false });
+    const hub = new StreamHub().attach(wsServer);
+    await new Promise(resolve => httpServer.listen(0, '127.0.0.1', resolve));
+    const { port } = httpServer.address();
+
+    const connectStarted = Date.now();
+    const sockets = [];
+    let received = 0;
+    let waiting = null;
+    // Connect in slices so the listen backlog isn't overrun
+    for (let i = 0; i < viewers; i += 500) {
+        const slice = [];
+        for (let j = i; j < Math.min(viewers, i + 500); j++) {
+            slice.push(connectViewer(port, String(j % streams)));
+        }
+        sockets.push(...await Promise.all(slice));
+    }
+    for (const ws of sockets) {
+        ws.on('message', () => {
+            if (--received === 0 && waiting) {
+                waiting();
+            }
+        });
+    }
+    console.log(`${viewers} viewers on ${streams} streams connected in ${Date.now() - connectStarted} ms`);
+
+    const latencies = [];
+    for (let e = 0; e < events; e++) {
+        const stream = String(e % streams);
+        const status = e % (2 * streams) < streams ? 'started' : 'ended';
+        const delivered = new Promise(resolve => {
+            waiting = resolve;
+        });
+        const started = process.hrtime.bigint();
+        received = hub.publish(`/live/${stream}/stream`, status);
+        if (received > 0) {
+            await delivered;
+        }
+        latencies.push(Number(process.hrtime.bigint() - started) / 1e6);
+    }
+
+    latencies.sort((a, b) => a - b);
+    const perEvent = Math.ceil(viewers / streams);
+    const memory = process.memoryUsage();
+    console.log(`${events} events to ~${perEvent} viewers each: `
+                + `p50 ${latencies[Math.floor(latencies.length / 2)].toFixed(2)} ms, `
+                + `max ${latencies[latencies.length - 1].toFixed(2)} ms`);
+    console.log(`hub: ${JSON.stringify(hub.stats)}; rss ${(memory.rss / 1048576).toFixed(0)} MB `
+                + `(viewers and hub share this process)`);
+
+    for (const ws of sockets) {
+        ws.terminate();
+    }
+    wsServer.close();
+    httpServer.close();
+    return hub.stats.evicted === 0 ? 0 : 1;
+}
+
+if (require.main === module) {
+    main(process.argv.slice(2)).then(code => {
+        process.exitCode = code;
+    }, error => {
+        console.error(error.message);
+        process.exitCode = 1;
+    });
+}
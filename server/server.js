@@ -3,6 +3,7 @@ const express = require('express');
 const { createServer } = require('http');
 const { WebSocketServer } = require('ws');
 const NodeMediaServer = require('node-media-server');
+const { StreamHub } = require('./stream-hub');
 
 const app = express();
 const httpServer = createServer(app);
@@ -28,44 +29,26 @@ const nms = new NodeMediaServer(rtmpConfig);
 // Serve static files
 app.use(express.static('public'));
 
-// WebSocket Broadcast
-const clients = new Set();
+// Viewers subscribe to the streams they watch; see stream-hub.js
+const hub = new StreamHub().attach(wsServer);
 
-wsServer.on('connection', (ws) => {
-    clients.add(ws);
-    console.log('New WebSocket client connected');
-
-    ws.on('close', () => {
-        clients.remove(ws);
-        console.log('WebSocket client disconnected');
-    });
+app.get('/hub/stats', (req, res) => {
+    res.json({ ...hub.stats, topics: hub.topics.size, live: hub.live.size });
 });
 
 // Broadcast stream status
 nms.on('prePublish', (id, StreamPath, args) => {
-    console.log('Stream started:', StreamPath);
-    clients.forEach(client => {
-        client.send(JSON.stringify({
-            type: 'stream_status',
-            status: 'started',
-            path: StreamPath
-        }));
-    });
+    const viewers = hub.publish(StreamPath, 'started');
+    console.log('Stream started:', StreamPath, 'viewers:', viewers);
 });
 
 nms.on('donePublish', (id, StreamPath, args) => {
-    console.log('Stream ended:', StreamPath);
-    clients.forEach(client => {
-        client.send(JSON.stringify({
-            type: 'stream_status',
-            status: 'ended',
-            path: StreamPath
-        }));
-    });
+    const viewers = hub.publish(StreamPath, 'ended');
+    console.log('Stream ended:', StreamPath, 'viewers:', viewers);
 });
 
 // Start servers
 nms.run();
 httpServer.listen(5000, () => {
     console.log('HTTP & WebSocket Server running on port 5000');
-});
\ No newline at end of file
+});
@@ -0,0 +1,191 @@
+//stream-hub.js
+// WebSocket fan-out of live-stream events. Every user publishes under their
+// own RTMP key (/live/<userId>/stream) and viewers subscribe to the streams
+// they watch, so a publish event only reaches that stream's subscribers.
+// Each event is serialized once and the same frame goes to every
+// subscriber; slow viewers are skipped instead of buffering without bound,
+// and viewers that stop answering pings are evicted.
+//
+// Viewer protocol (JSON text frames):
+//   -> { "type": "subscribe", "streams": ["42", ...] }
+//   -> { "type": "unsubscribe", "streams": ["42", ...] }
+//   <- { "type": "stream_status", "stream": "42", "status": "started"|"ended", "path": ... }
+// A viewer may also subscribe on connect with ?stream=42&stream=43.
+const { WebSocket } = require('ws');
+
+const DEFAULTS = {
+    // Skip a viewer while this much is still queued on its socket
+    maxBufferedBytes: 1024 * 1024,
+    // Drop it after missing this many events in a row
+    maxSkippedEvents: 32,
+    heartbeatMsecs: 30000,
+    maxTopicsPerClient: 64,
+    maxMessageBytes: 16 * 1024
+};
+
+// "/live/42/stream" -> "42"; the old shared "/live/stream" key maps to "stream"
+function streamKey(streamPath) {
+    const parts = streamPath.split('/').filter(part => part !== '');
+    if (parts[0] === 'live') {
+        parts.shift();
+    }
+    if (parts.length > 1 && parts[parts.length - 1] === 'stream') {
+        parts.pop();
+    }
+    return parts.join('/');
+}
+
+class StreamHub {
+    constructor(options = {}) {
+        this.options = { ...DEFAULTS, ...options };
+        this.topics = new Map();   // stream key -> Set of sockets
+        this.live = new Map();     // stream key -> last status message
+        this.stats = { clients: 0, sent: 0, skipped: 0, evicted: 0 };
+        this.heartbeat = null;
+    }
+
+    attach(wsServer) {
+        wsServer.on('connection', (ws, req) => this.handleConnection(ws, req));
+        this.heartbeat = setInterval(() => this.sweep(wsServer), this.options.heartbeatMsecs);
+        this.heartbeat.unref();
+        wsServer.on('close', () => clearInterval(this.heartbeat));
+        return this;
+    }
+
+    handleConnection(ws, req) {
+        ws.isAlive = true;
+        ws.skipped = 0;
+        ws.topics = new Set();
+        this.stats.clients++;
+
+        ws.on('pong', () => {
+            ws.isAlive = true;
+        });
+        ws.on('message', (data, isBinary) => this.handleMessage(ws, data, isBinary));
+        ws.on('close', () => {
+            this.stats.clients--;
+            for (const topic of ws.topics) {
+                this.unsubscribe(ws, topic);
+            }
+        });
+        ws.on('error', () => ws.terminate());
+
+        const query = new URL(req.url, 'http://localhost').searchParams;
+        this.subscribe(ws, query.getAll('stream'));
+    }
+
+    handleMessage(ws, data, isBinary) {
+        if (isBinary || data.length > this.options.maxMessageBytes) {
+            return;
+        }
+        let message;
+        try {
+            message = JSON.parse(data.toString('utf8'));
+        } catch (error) {
+            return;
+        }
+        if (!message || !Array.isArray(message.streams)) {
+            return;
+        }
+        if (message.type === 'subscribe') {
+            this.subscribe(ws, message.streams);
+        } else if (message.type === 'unsubscribe') {
+            for (const topic of message.streams) {
+                this.unsubscribe(ws, String(topic));
+            }
+        }
+    }
+
+    subscribe(ws, streams) {
+        for (const value of streams) {
+            const topic = String(value);
+            if (ws.topics.has(topic) || ws.topics.size >= this.options.maxTopicsPerClient) {
+                continue;
+            }
+            ws.topics.add(topic);
+            let subscribers = this.topics.get(topic);
+            if (!subscribers) {
+                subscribers = new Set();
+                this.topics.set(topic, subscribers);
+            }
+            subscribers.add(ws);
+
+            // Late joiners learn the current state right away
+            const status = this.live.get(topic);
+            if (status) {
+                this.sendTo(ws, status);
+            }
+        }
+    }
+
+    unsubscribe(ws, topic) {
+        ws.topics.delete(topic);
+        const subscribers = this.topics.get(topic);
+        if (subscribers) {
+            subscribers.delete(ws);
+            if (subscribers.size === 0) {
+                this.topics.delete(topic);
+            }
+        }
+    }
+
+    // Returns the number of viewers the event was sent to
+    publish(streamPath, status) {
+        const topic = streamKey(streamPath);
+        // Encoded once; every subscriber is sent the same buffer
+        const payload = Buffer.from(JSON.stringify({ type: 'stream_status', stream: topic, status, path: streamPath }));
+        if (status === 'started') {
+            this.live.set(topic, payload);
+        } else {
+            this.live.delete(topic);
+        }
+        return this.broadcast(topic, payload);
+    }
+
+    broadcast(topic, payload) {
+        const subscribers = this.topics.get(topic);
+        if (!subscribers) {
+            return 0;
+        }
+        let sent = 0;
+        for (const ws of subscribers) {
+            if (this.sendTo(ws, payload)) {
+                sent++;
+            }
+        }
+        return sent;
+    }
+
+    sendTo(ws, payload) {
+        if (ws.readyState !== WebSocket.OPEN) {
+            return false;
+        }
+        if (ws.bufferedAmount > this.options.maxBufferedBytes) {
+            this.stats.skipped++;
+            if (++ws.skipped > this.options.maxSkippedEvents) {
+                this.stats.evicted++;
+                ws.terminate();
+            }
+            return false;
+        }
+        ws.skipped = 0;
+        ws.send(payload, { binary: false });
+        this.stats.sent++;
+        return true;
+    }
+
+    // Terminates viewers that missed the previous ping, pings the rest
+    sweep(wsServer) {
+        for (const ws of wsServer.clients) {
+            if (!ws.isAlive) {
+                this.stats.evicted++;
+                ws.terminate();
+                continue;
+            }
+            ws.isAlive = false;
+            ws.ping();
+        }
+    }
+}
+
+module.exports = { StreamHub, streamKey };
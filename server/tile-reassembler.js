@@ -0,0 +1,137 @@
+//tile-reassembler.js
+// Reference decoder for the client's tile delta screenshots
+// (application/x-tile-delta). Rebuilds full frames from a keyframe plus the
+// changed tiles of each following frame and checks every result against the
+// SHA-1 the client computed over the original frame.
+//
+// Usage: node tile-reassembler.js <frame.ttd>... [--out <dir>]
+const fs = require('fs');
+const path = require('path');
+const zlib = require('zlib');
+const crypto = require('crypto');
+
+const HEADER_SIZE = 4 + 1 + 1 + 2 + 4 * 5 + 20;
+
+function decodePayload(blob) {
+    // qCompress() prefixes the zlib stream with the big-endian raw length
+    const raw = zlib.inflateSync(blob.subarray(4));
+    if (raw.toString('ascii', 0, 4) !== 'TTDF') {
+        throw new Error('Not a tile delta payload');
+    }
+
+    const header = {
+        version: raw.readUInt8(4),
+        keyframe: (raw.readUInt8(5) & 1) !== 0,
+        tileSize: raw.readUInt16LE(6),
+        width: raw.readUInt32LE(8),
+        height: raw.readUInt32LE(12),
+        sequence: raw.readUInt32LE(16),
+        keyframeSequence: raw.readUInt32LE(20),
+        tileCount: raw.readUInt32LE(24),
+        sha1: raw.subarray(28, 48).toString('hex')
+    };
+    if (header.version !== 1) {
+        throw new Error(`Unsupported tile delta version ${header.version}`);
+    }
+    return { header, raw };
+}
+
+class TileReassembler {
+    constructor() {
+        this.frame = null;
+        this.width = 0;
+        this.height = 0;
+        this.sequence = 0;
+    }
+
+    // Applies one payload and returns the reconstructed frame as raw RGB32
+    // rows (width * 4 bytes each, no padding)
+    apply(blob) {
+        const { header, raw } = decodePayload(blob);
+
+        if (header.keyframe) {
+            this.width = header.width;
+            this.height = header.height;
+            this.frame = Buffer.alloc(header.width * header.height * 4);
+        } else if (!this.frame || header.sequence !== this.sequence + 1
+                   || header.width !== this.width || header.height !== this.height) {
+            throw new Error(`Frame ${header.sequence} does not follow ${this.sequence}, keyframe needed`);
+        }
+
+        const { tileSize, width, height } = header;
+        const rowBytes = width * 4;
+        let offset = HEADER_SIZE;
+        for (let i = 0; i < header.tileCount; i++) {
+            const column = raw.readUInt16LE(offset);
+            const row = raw.readUInt16LE(offset + 2);
+            offset += 4;
+
+            const x = column * tileSize;
+            const y = row * tileSize;
+            const tileBytes = Math.min(tileSize, width - x) * 4;
+            const tileHeight = Math.min(tileSize, height - y);
+            for (let line = 0; line < tileHeight; line++) {
+                raw.copy(this.frame, (y + line) * rowBytes + x * 4, offset, offset + tileBytes);
+                offset += tileBytes;
+            }
+        }
+
+        this.sequence = header.sequence;
+
+        const digest = crypto.createHash('sha1').update(this.frame).digest('hex');
+        return { header, frame: this.frame, lossless: digest === header.sha1 };
+    }
+}
+
+// Binary PPM, readable by most image viewers
+function toPpm(frame, width, height) {
+    const head = Buffer.from(`P6\n${width} ${height}\n255\n`, 'ascii');
+    const body = Buffer.alloc(width * height * 3);
+    for (let src = 0, dst = 0; src < frame.length; src += 4, dst += 3) {
+        body[dst] = frame[src + 2];
+        body[dst + 1] = frame[src + 1];
+        body[dst + 2] = frame[src];
+    }
+    return Buffer.concat([head, body]);
+}
+
+function main(argv) {
+    const files = [];
+    let outDir = null;
+    for (let i = 0; i < argv.length; i++) {
+        if (argv[i] === '--out') {
+            outDir = argv[++i];
+        } else {
+            files.push(argv[i]);
+        }
+    }
+
+    // Uploads can arrive out of order; the chain is defined by sequence
+    const decoded = files.map(file => {
+        const blob = fs.readFileSync(file);
+        return { file, blob, sequence: decodePayload(blob).header.sequence };
+    });
+    decoded.sort((a, b) => a.sequence - b.sequence);
+
+    const reassembler = new TileReassembler();
+    let failures = 0;
+    for (const { file, blob } of decoded) {
+        const { header, frame, lossless } = reassembler.apply(blob);
+        console.log(`${path.basename(file)}: seq ${header.sequence} ${header.keyframe ? 'keyframe' : 'delta'}`
+                    + ` ${header.tileCount} tiles, ${blob.length} bytes, ${lossless ? 'lossless' : 'MISMATCH'}`);
+        if (!lossless) {
+            failures++;
+        }
+        if (outDir) {
+            fs.writeFileSync(path.join(outDir, `frame-${header.sequence}.ppm`),
+                             toPpm(frame, header.width, header.height));
+        }
+    }
+    return failures === 0 ? 0 : 1;
+}
+
+module.exports = { TileReassembler, decodePayload };
+
+if (require.main === module) {
+    process.exitCode = main(process.argv.slice(2));
+}
@@ -0,0 +1,265 @@
+#include "ActivityLog.h"
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// Records: [i64 start][i64 end][i32 task][u16 crc of the first 20][u16 0]
+constexpr int RecordSize = 24;
+constexpr int PayloadSize = 20;
+// Rewrite once the file holds this many times the live intervals
+constexpr qint64 CompactRatio = 4;
+constexpr qint64 MinCompactRecords = 1024;
+constexpr qint64 DayMsecs = 24 * 60 * 60 * 1000;
+
+// Julian day 0 is a Monday
+qint64 weekOf(qint64 julianDay)
+{
+    return julianDay - julianDay % 7;
+}
+
+QByteArray encodeRecord(const IntervalDelta &delta)
+{
+    QByteArray bytes(RecordSize, '\0');
+    qToLittleEndian<qint64>(delta.start, bytes.data());
+    qToLittleEndian<qint64>(delta.end, bytes.data() + 8);
+    qToLittleEndian<qint32>(delta.taskId, bytes.data() + 16);
+    qToLittleEndian<quint16>(qChecksum(QByteArrayView(bytes.constData(), PayloadSize)), bytes.data() + PayloadSize);
+    return bytes;
+}
+
+bool decodeRecord(const char *at, IntervalDelta *delta)
+{
+    if (qFromLittleEndian<quint16>(at + PayloadSize) != qChecksum(QByteArrayView(at, PayloadSize)))
+        return false;
+    delta->start = qFromLittleEndian<qint64>(at);
+    delta->end = qFromLittleEndian<qint64>(at + 8);
+    delta->taskId = qFromLittleEndian<qint32>(at + 16);
+    return delta->end >= delta->start;
+}
+
+}
+
+ActivityLog::ActivityLog(const QString &directory, int retentionDays)
+    : retentionDays(qMax(1, retentionDays)),
+      records(0),
+      cachedDayStart(0),
+      cachedDayEnd(0),
+      cachedDay(0)
+{
+    QDir().mkpath(directory);
+    log.setFileName(QDir(directory).filePath("activity.log"));
+    replay();
+}
+
+ActivityLog::~ActivityLog()
+{
+    log.flush();
+}
+
+void ActivityLog::record(const IntervalDelta &delta)
+{
+    if (apply(delta))
+        append(delta);
+}
+
+bool ActivityLog::apply(const IntervalDelta &delta)
+{
+    if (delta.end < delta.start || delta.taskId < 0)
+        return false;
+
+    const int index = indexByStart.value(delta.start, -1);
+    if (index >= 0) {
+        // Repeats and stale reports of a known interval change nothing
+        if (delta.end <= ends[index])
+            return false;
+        add(tasks[index], ends[index], delta.end);
+        ends[index] = delta.end;
+    } else if (starts.isEmpty() || delta.start > starts.last()) {
+        starts.append(delta.start);
+        ends.append(delta.end);
+        tasks.append(delta.taskId);
+        indexByStart.insert(delta.start, int(starts.size()) - 1);
+        add(delta.taskId, delta.start, delta.end);
+    } else {
+        // Out of order, e.g. an interval restored after a crash
+        const int at = int(std::lower_bound(starts.cbegin(), starts.cend(), delta.start) - starts.cbegin());
+        starts.insert(at, delta.start);
+        ends.insert(at, delta.end);
+        tasks.insert(at, delta.taskId);
+        for (int i = at; i < starts.size(); ++i)
+            indexByStart.insert(starts[i], i);
+        add(delta.taskId, delta.start, delta.end);
+    }
+    return true;
+}
+
+QHash<int, qint64> ActivityLog::totals(Period period, const QDate &date, const IntervalDelta *live) const
+{
+    const qint64 day = date.toJulianDay();
+    const qint64 key = period == Day ? day : weekOf(day);
+    QHash<int, qint64> result = (period == Day ? dayTotals : weekTotals).value(key);
+
+    if (live && live->taskId >= 0) {
+        const int index = indexByStart.value(live->start, -1);
+        qint64 from = index >= 0 ? ends[index] : live->start;
+        while (from < live->end) {
+            const qint64 chunkDay = dayOf(from);
+            const qint64 chunkEnd = qMin(live->end, cachedDayEnd);
+            if ((period == Day ? chunkDay : weekOf(chunkDay)) == key)
+                result[live->taskId] += chunkEnd - from;
+            from = chunkEnd;
+        }
+    }
+    return result;
+}
+
+qint64 ActivityLog::trackedBetween(qint64 from, qint64 to, int taskId) const
+{
+    // Intervals don't overlap, so ends are in start order too
+    const int first = int(std::upper_bound(ends.cbegin(), ends.cend(), from) - ends.cbegin());
+    const int last = int(std::lower_bound(starts.cbegin(), starts.cend(), to) - starts.cbegin());
+
+    qint64 total = 0;
+    for (int i = first; i < last; ++i) {
+        if (taskId >= 0 && tasks[i] != taskId)
+            continue;
+        total += qMax<qint64>(0, qMin(ends[i], to) - qMax(starts[i], from));
+    }
+    return total;
+}
+
+QVector<DayRollup> ActivityLog::takeChangedDays()
+{
+    QList<qint64> days = changedDays.values();
+    std::sort(days.begin(), days.end());
+    changedDays.clear();
+
+    QVector<DayRollup> rollups;
+    rollups.reserve(days.size());
+    for (qint64 day : std::as_const(days))
+        rollups.append({ QDate::fromJulianDay(day), dayTotals.value(day) });
+    return rollups;
+}
+
+void ActivityLog::add(int taskId, qint64 from, qint64 to)
+{
+    while (from < to) {
+        const qint64 day = dayOf(from);
+        const qint64 chunkEnd = qMin(to, cachedDayEnd);
+        dayTotals[day][taskId] += chunkEnd - from;
+        weekTotals[weekOf(day)][taskId] += chunkEnd - from;
+        changedDays.insert(day);
+        from = chunkEnd;
+    }
+}
+
+qint64 ActivityLog::dayOf(qint64 msecs) const
+{
+    if (msecs >= cachedDayStart && msecs < cachedDayEnd)
+        return cachedDay;
+
+    // Local midnights, which move with DST
+    const QDate date = QDateTime::fromMSecsSinceEpoch(msecs).date();
+    cachedDay = date.toJulianDay();
+    cachedDayStart = date.startOfDay().toMSecsSinceEpoch();
+    cachedDayEnd = date.addDays(1).startOfDay().toMSecsSinceEpoch();
+    return cachedDay;
+}
+
+void ActivityLog::append(const IntervalDelta &delta)
+{
+    if (!log.isOpen())
+        return;
+
+    log.seek(log.size());
+    log.write(encodeRecord(delta));
+    log.flush();
+    ++records;
+    if (records >= MinCompactRecords && records > CompactRatio * starts.size())
+        compact();
+}
+
+void ActivityLog::replay()
+{
+    if (!log.open(QIODevice::ReadWrite)) {
+        qWarning() << "Could not open activity log" << log.errorString();
+        return;
+    }
+
+    const QByteArray data = log.readAll();
+    qint64 validEnd = 0;
+    IntervalDelta delta;
+    while (validEnd + RecordSize <= data.size() && decodeRecord(data.constData() + validEnd, &delta)) {
+        apply(delta);
+        validEnd += RecordSize;
+    }
+    records = validEnd / RecordSize;
+
+    if (validEnd < data.size()) {
+        qWarning() << "Activity log damaged after" << validEnd << "bytes, truncating";
+        log.resize(validEnd);
+    }
+
+    // Whatever the last run didn't get to report; the server takes a day's
+    // totals again without harm
+    changedDays.clear();
+    const qint64 today = QDate::currentDate().toJulianDay();
+    for (qint64 day : { today - 1, today }) {
+        if (dayTotals.contains(day))
+            changedDays.insert(day);
+    }
+
+    if (records >= MinCompactRecords && records > CompactRatio * starts.size())
+        compact();
+}
+
+void ActivityLog::compact()
+{
+    // Intervals past the retention period go, with the days they covered
+    const qint64 cutoff = QDateTime::currentMSecsSinceEpoch() - retentionDays * DayMsecs;
+    const int expired = int(std::upper_bound(ends.cbegin(), ends.cend(), cutoff) - ends.cbegin());
+    if (expired > 0) {
+        starts.remove(0, expired);
+        ends.remove(0, expired);
+        tasks.remove(0, expired);
+        indexByStart.clear();
+        for (int i = 0; i < starts.size(); ++i)
+            indexByStart.insert(starts[i], i);
+
+        const qint64 cutoffDay = QDateTime::fromMSecsSinceEpoch(cutoff).date().toJulianDay();
+        for (auto it = dayTotals.begin(); it != dayTotals.end();)
+            it = it.key() < cutoffDay ? dayTotals.erase(it) : std::next(it);
+        for (auto it = weekTotals.begin(); it != weekTotals.end();)
+            it = it.key() + 7 <= cutoffDay ? weekTotals.erase(it) : std::next(it);
+    }
+
+    // One record per interval, replacing the file atomically
+    QSaveFile out(log.fileName());
+    if (!out.open(QIODevice::WriteOnly)) {
+        qWarning() << "Activity log compaction failed" << out.errorString();
+        return;
+    }
+    QByteArray bytes;
+    bytes.reserve(starts.size() * RecordSize);
+    for (int i = 0; i < starts.size(); ++i) {
+        IntervalDelta delta;
+        delta.start = starts[i];
+        delta.end = ends[i];
+        delta.taskId = tasks[i];
+        bytes += encodeRecord(delta);
+    }
+    out.write(bytes);
+
+    log.close();
+    if (out.commit())
+        records = starts.size();
+    else
+        qWarning() << "Activity log compaction failed" << out.errorString();
+    if (!log.open(QIODevice::ReadWrite))
+        qWarning() << "Could not reopen activity log" << log.errorString();
+}
@@ -0,0 +1,78 @@
+#ifndef ACTIVITYLOG_H
+#define ACTIVITYLOG_H
+
+#include <QDate>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include "TrackTimePayload.h"
+
+// Local history of tracked intervals per task, so "today" and "this week"
+// are answered on the client instead of by a report query on the server.
+//
+// Intervals are held column-wise (starts, ends and tasks in separate
+// arrays, in start order), which keeps range scans sequential. Every
+// update also maintains running per-day and per-week totals, so summaries
+// cost a hash lookup, not a scan. Updates arrive as heartbeat deltas: the
+// open interval is re-reported with a growing end and only the new part is
+// added to the totals, in O(1). Days split at local midnight, weeks start
+// on Monday.
+//
+// On disk the log is a sequence of fixed-size, checksummed records; a
+// record for an interval already known supersedes it. The file is
+// rewritten once superseded records dominate it, dropping intervals past
+// the retention period.
+class ActivityLog
+{
+public:
+    enum Period { Day, Week };
+
+    ActivityLog(const QString &directory, int retentionDays = 90);
+    ~ActivityLog();
+
+    void record(const IntervalDelta &delta);
+
+    // Per-task msecs in the day or week holding `date`. `live` is the open
+    // interval as of now, ahead of its last report; pass nullptr for only
+    // what has been recorded.
+    QHash<int, qint64> totals(Period period, const QDate &date, const IntervalDelta *live = nullptr) const;
+    // Msecs tracked between two wall-clock instants, for one task or all
+    qint64 trackedBetween(qint64 from, qint64 to, int taskId = -1) const;
+
+    // Days whose totals changed since the last call, with their totals
+    QVector<DayRollup> takeChangedDays();
+
+    int intervalCount() const { return int(starts.size()); }
+
+private:
+    // Updates the columns and totals; false if the delta changed nothing
+    bool apply(const IntervalDelta &delta);
+    void add(int taskId, qint64 from, qint64 to);
+    qint64 dayOf(qint64 msecs) const;
+    void append(const IntervalDelta &delta);
+    void replay();
+    void compact();
+
+    QFile log;
+    int retentionDays;
+    qint64 records; // in the file, superseded ones included
+
+    // One entry per interval, in start order
+    QVector<qint64> starts;
+    QVector<qint64> ends;
+    QVector<qint32> tasks;
+    QHash<qint64, int> indexByStart;
+
+    // Julian day (of the week's Monday) -> task -> msecs
+    QHash<qint64, QHash<int, qint64>> dayTotals;
+    QHash<qint64, QHash<int, qint64>> weekTotals;
+    QSet<qint64> changedDays;
+
+    // Bounds of the last day looked up; nearly every update falls in it
+    mutable qint64 cachedDayStart;
+    mutable qint64 cachedDayEnd;
+    mutable qint64 cachedDay;
+};
+
+#endif // ACTIVITYLOG_H
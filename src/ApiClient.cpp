@@ -0,0 +1,118 @@
+#include "ApiClient.h"
+#include "PerfMonitor.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QHttpMultiPart>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QCborValue>
+#include <QSettings>
+#include <QUrl>
+
+ApiClient::ApiClient(QNetworkAccessManager *manager, QObject *parent)
+    : QObject(parent),
+      networkManager(manager),
+      bodyEncoding(Json),
+      compressionThreshold(1024),
+      http2Direct(false)
+{
+}
+
+void ApiClient::loadSettings()
+{
+    QSettings settings("YourCompany", "TimeTrackerApp");
+    // Set your actual API URL here
+    setBaseUrl(settings.value("api/baseUrl", "http://127.0.0.1:3000").toString());
+    setEncoding(settings.value("api/encoding", "json").toString() == "cbor" ? Cbor : Json);
+    setCompressionThreshold(settings.value("api/compressThreshold", 1024).toLongLong());
+    setHttp2Direct(settings.value("api/http2Direct", false).toBool());
+}
+
+QNetworkRequest ApiClient::request(const QString &endpoint) const
+{
+    QNetworkRequest request(QUrl(base + endpoint));
+    if (!bearer.isEmpty())
+        request.setRawHeader("Authorization", "Bearer " + bearer.toUtf8());
+    request.setRawHeader("Accept", "application/json");
+    request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    if (http2Direct)
+        request.setAttribute(QNetworkRequest::Http2DirectAttribute, true);
+    return request;
+}
+
+QByteArray ApiClient::encode(const QJsonObject &json, QByteArray *contentType) const
+{
+    if (bodyEncoding == Cbor) {
+        *contentType = "application/cbor";
+        return QCborValue::fromJsonValue(json).toCbor();
+    }
+    *contentType = "application/json";
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+QNetworkReply *ApiClient::get(const QNetworkRequest &request)
+{
+    return track(networkManager->get(request), 0, 0);
+}
+
+QNetworkReply *ApiClient::post(const QString &endpoint, const QJsonObject &json)
+{
+    QByteArray contentType;
+    const QByteArray body = encode(json, &contentType);
+    return post(request(endpoint), body, contentType);
+}
+
+QNetworkReply *ApiClient::post(QNetworkRequest request, const QByteArray &body, const QByteArray &contentType)
+{
+    request.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+
+    // Images and tile deltas are compressed already; only structured
+    // bodies are worth deflating
+    const bool compressible = contentType == "application/json" || contentType == "application/cbor";
+    if (compressible && compressionThreshold > 0 && body.size() >= compressionThreshold) {
+        const QByteArray deflated = deflate(body);
+        if (!deflated.isEmpty()) {
+            request.setRawHeader("Content-Encoding", "deflate");
+            return track(networkManager->post(request, deflated), body.size(), deflated.size());
+        }
+    }
+    return track(networkManager->post(request, body), body.size(), body.size());
+}
+
+QNetworkReply *ApiClient::post(QNetworkRequest request, QIODevice *body, const QByteArray &contentType)
+{
+    request.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+    const qint64 size = body->size();
+    QNetworkReply *reply = networkManager->post(request, body);
+    body->setParent(reply);
+    return track(reply, size, size);
+}
+
+QNetworkReply *ApiClient::post(const QNetworkRequest &request, QHttpMultiPart *multiPart)
+{
+    QNetworkReply *reply = networkManager->post(request, multiPart);
+    multiPart->setParent(reply); // so that it will be deleted when reply is deleted
+    // Part sizes aren't known up front; UploadQueue accounts for the bytes
+    return track(reply, 0, 0);
+}
+
+QByteArray ApiClient::deflate(const QByteArray &body)
+{
+    // HTTP's "deflate" coding is the zlib format, which is what qCompress
+    // produces after its 4-byte length prefix
+    const QByteArray compressed = qCompress(body, 6);
+    if (compressed.size() <= 4 || compressed.size() - 4 >= body.size())
+        return QByteArray();
+    return compressed.mid(4);
+}
+
+QNetworkReply *ApiClient::track(QNetworkReply *reply, qint64 bodyBytes, qint64 wireBytes)
+{
+    const qint64 started = PerfMonitor::nowNsecs();
+    connect(reply, &QNetworkReply::finished, this, [reply, started, bodyBytes, wireBytes]() {
+        PerfMonitor::instance()->recordRequest(reply->url().path(), PerfMonitor::nowNsecs() - started,
+                                               bodyBytes, wireBytes, reply->error() == QNetworkReply::NoError,
+                                               reply->attribute(QNetworkRequest::Http2WasUsedAttribute).toBool());
+    });
+    return reply;
+}
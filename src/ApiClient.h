@@ -0,0 +1,73 @@
+#ifndef APICLIENT_H
+#define APICLIENT_H
+
+#include <QObject>
+#include <QNetworkRequest>
+#include <QByteArray>
+#include <QString>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QHttpMultiPart;
+class QIODevice;
+class QJsonObject;
+
+// Single entry point for the REST API. Owns the request template (base
+// URL, bearer token, HTTP/2) so every call shares one connection pool on
+// the shared QNetworkAccessManager; with HTTP/2 concurrent requests are
+// multiplexed over one connection instead of opening up to six. Structured
+// bodies are sent as compact JSON or CBOR, compressible bodies above a
+// threshold are deflated, and every request's latency is recorded per
+// endpoint in PerfMonitor.
+class ApiClient : public QObject
+{
+    Q_OBJECT
+public:
+    enum Encoding { Json, Cbor };
+
+    explicit ApiClient(QNetworkAccessManager *manager, QObject *parent = nullptr);
+
+    // Base URL and transport options from the api/ settings
+    void loadSettings();
+
+    void setBaseUrl(const QString &url) { base = url; }
+    QString baseUrl() const { return base; }
+    void setToken(const QString &token) { bearer = token; }
+    bool hasToken() const { return !bearer.isEmpty(); }
+
+    void setEncoding(Encoding encoding) { bodyEncoding = encoding; }
+    Encoding encoding() const { return bodyEncoding; }
+    // JSON and CBOR bodies of at least this many bytes are sent with
+    // Content-Encoding: deflate; 0 disables compression
+    void setCompressionThreshold(qint64 bytes) { compressionThreshold = qMax<qint64>(0, bytes); }
+    // HTTP/2 over cleartext with prior knowledge. HTTPS negotiates HTTP/2
+    // through ALPN on its own; plain HTTP needs a server known to speak h2c.
+    void setHttp2Direct(bool enabled) { http2Direct = enabled; }
+
+    QNetworkRequest request(const QString &endpoint) const;
+    // Serialized in the configured encoding
+    QByteArray encode(const QJsonObject &json, QByteArray *contentType) const;
+
+    QNetworkReply *get(const QNetworkRequest &request);
+    QNetworkReply *post(const QString &endpoint, const QJsonObject &json);
+    QNetworkReply *post(QNetworkRequest request, const QByteArray &body, const QByteArray &contentType);
+    // Streams the device; the reply takes ownership of it
+    QNetworkReply *post(QNetworkRequest request, QIODevice *body, const QByteArray &contentType);
+    // The reply takes ownership of the multipart
+    QNetworkReply *post(const QNetworkRequest &request, QHttpMultiPart *multiPart);
+
+    // Deflated body, or an empty array when compression doesn't pay off
+    static QByteArray deflate(const QByteArray &body);
+
+private:
+    QNetworkReply *track(QNetworkReply *reply, qint64 bodyBytes, qint64 wireBytes);
+
+    QNetworkAccessManager *networkManager;
+    QString base;
+    QString bearer;
+    Encoding bodyEncoding;
+    qint64 compressionThreshold;
+    bool http2Direct;
+};
+
+#endif // APICLIENT_H
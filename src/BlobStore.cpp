@@ -0,0 +1,142 @@
+#include "BlobStore.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDebug>
+
+namespace {
+
+constexpr int KeyLength = 16;
+
+bool isKey(const QString &key)
+{
+    if (key.size() != KeyLength)
+        return false;
+    for (QChar c : key) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+}
+
+BlobStore::BlobStore(const QString &directory, qint64 maxBytes)
+    : dir(directory),
+      maxBytes(maxBytes),
+      bytes(0),
+      clock(0)
+{
+    QDir().mkpath(dir);
+
+    // Oldest first, so the recovered order matches the last run's
+    const QFileInfoList files = QDir(dir).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+    for (const QFileInfo &file : files) {
+        if (!isKey(file.fileName())) {
+            // Leftovers of an interrupted write
+            QFile::remove(file.filePath());
+            continue;
+        }
+        Entry &entry = entries[file.fileName()];
+        entry.size = file.size();
+        bytes += entry.size;
+        use(file.fileName(), entry);
+    }
+    evict();
+}
+
+QString BlobStore::key(quint64 frameHash)
+{
+    return QString("%1").arg(frameHash, KeyLength, 16, QChar('0'));
+}
+
+bool BlobStore::touch(const QString &key)
+{
+    QMutexLocker locker(&mutex);
+    auto it = entries.find(key);
+    if (it == entries.end())
+        return false;
+
+    use(key, *it);
+    QFile file(pathFor(key));
+    if (!file.open(QIODevice::ReadWrite) || !file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime)) {
+        // Gone behind our back; forget it
+        bytes -= it->size;
+        byLastUse.remove(it->lastUse);
+        entries.erase(it);
+        return false;
+    }
+    return true;
+}
+
+QByteArray BlobStore::read(const QString &key)
+{
+    if (!touch(key))
+        return QByteArray();
+
+    QFile file(pathFor(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not read screenshot blob" << key << file.errorString();
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+bool BlobStore::insert(const QString &key, const QByteArray &data)
+{
+    if (!isKey(key) || data.size() > maxBytes)
+        return false;
+
+    QMutexLocker locker(&mutex);
+    if (entries.contains(key))
+        return true;
+
+    QSaveFile file(pathFor(key));
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "Could not store screenshot blob" << key << file.errorString();
+        return false;
+    }
+
+    Entry &entry = entries[key];
+    entry.size = data.size();
+    bytes += entry.size;
+    use(key, entry);
+    evict();
+    return true;
+}
+
+qint64 BlobStore::totalBytes() const
+{
+    QMutexLocker locker(&mutex);
+    return bytes;
+}
+
+int BlobStore::count() const
+{
+    QMutexLocker locker(&mutex);
+    return int(entries.size());
+}
+
+QString BlobStore::pathFor(const QString &key) const
+{
+    return QDir(dir).filePath(key);
+}
+
+void BlobStore::use(const QString &key, Entry &entry)
+{
+    if (entry.lastUse)
+        byLastUse.remove(entry.lastUse);
+    entry.lastUse = ++clock;
+    byLastUse.insert(entry.lastUse, key);
+}
+
+void BlobStore::evict()
+{
+    while (bytes > maxBytes && !byLastUse.isEmpty()) {
+        const QString key = byLastUse.take(byLastUse.firstKey());
+        bytes -= entries.take(key).size;
+        QFile::remove(pathFor(key));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef BLOBSTORE_H
+#define BLOBSTORE_H
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+
+// Content-addressed local store of encoded screenshots. Blobs are keyed by
+// a fast hash of the raw frame, so an unchanged screen maps to the blob
+// that was already encoded (and uploaded) for it. Only an exact match
+// stands in for a frame; a near one could hide what changed on screen.
+// Disk use is bounded: once the total passes the cap, the least recently
+// used blobs are evicted. File times carry the recency across restarts.
+// Safe to use from any thread.
+class BlobStore
+{
+public:
+    BlobStore(const QString &directory, qint64 maxBytes);
+
+    static QString key(quint64 frameHash);
+
+    // Marks the blob as used; false if the store doesn't have it
+    bool touch(const QString &key);
+    // Empty if the store doesn't have the blob
+    QByteArray read(const QString &key);
+    bool insert(const QString &key, const QByteArray &data);
+
+    qint64 totalBytes() const;
+    int count() const;
+
+private:
+    struct Entry
+    {
+        qint64 size = 0;
+        quint64 lastUse = 0;
+    };
+
+    QString pathFor(const QString &key) const;
+    void use(const QString &key, Entry &entry);
+    void evict();
+
+    mutable QMutex mutex;
+    QString dir;
+    qint64 maxBytes;
+    qint64 bytes;
+    quint64 clock;
+    QHash<QString, Entry> entries;
+    QMap<quint64, QString> byLastUse; // oldest first
+};
+
+#endif // BLOBSTORE_H
@@ -0,0 +1,184 @@
+#include "CaptureSource.h"
+#include "PerfMonitor.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QImage>
+#include <QThread>
+#include <QTimer>
+#include <QDateTime>
+#include <cstring>
+#ifdef TIMETRACKER_HAVE_XSHM
+#include "X11ShmCaptureSource.h"
+#endif
+
+CaptureSource *CaptureSource::create(QObject *parent)
+{
+#ifdef TIMETRACKER_HAVE_XSHM
+    if (QGuiApplication::platformName() == "xcb" && X11ShmCaptureSource::isAvailable())
+        return new X11ShmCaptureSource(parent);
+#endif
+    return new ScreenCaptureSource(parent);
+}
+
+CaptureSource::CaptureSource(QObject *parent)
+    : QObject(parent),
+      captureThread(nullptr),
+      tickTimer(nullptr),
+      active(false)
+{
+}
+
+CaptureSource::~CaptureSource()
+{
+    // Subclasses stop() in their own destructors, while close() still
+    // dispatches to them
+    if (captureThread) {
+        captureThread->quit();
+        captureThread->wait();
+    }
+    delete tickTimer;
+}
+
+QScreen *CaptureSource::selectedScreen() const
+{
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (QScreen *screen : screens) {
+        if (screen->name() == screenName)
+            return screen;
+    }
+    return QGuiApplication::primaryScreen();
+}
+
+bool CaptureSource::start(int fps)
+{
+    if (active)
+        return true;
+
+    if (!open()) {
+        emit error(QString("Could not open %1 screen capture").arg(backendName()));
+        return false;
+    }
+
+    if (!tickTimer) {
+        tickTimer = new QTimer;
+        tickTimer->setTimerType(Qt::PreciseTimer);
+        if (grabsOffThread()) {
+            captureThread = new QThread(this);
+            captureThread->setObjectName("ScreenCapture");
+            captureThread->start();
+            tickTimer->moveToThread(captureThread);
+        }
+        // The timer is the context object, so tick() runs on its thread
+        connect(tickTimer, &QTimer::timeout, tickTimer, [this]() { tick(); });
+    }
+
+    const int interval = 1000 / qMax(1, fps);
+    QMetaObject::invokeMethod(tickTimer, [this, interval]() { tickTimer->start(interval); });
+
+    active = true;
+    return true;
+}
+
+void CaptureSource::stop()
+{
+    if (!active)
+        return;
+
+    // Wait for an in-progress grab so close() can free the buffers safely.
+    // Readers only hold frames inside their frameReady handlers, which run
+    // on this thread, so none can be outstanding here.
+    if (captureThread)
+        QMetaObject::invokeMethod(tickTimer, &QTimer::stop, Qt::BlockingQueuedConnection);
+    else
+        tickTimer->stop();
+
+    active = false;
+    frameRing.detachAll();
+    close();
+}
+
+void CaptureSource::tick()
+{
+    const int slot = frameRing.beginWrite();
+    if (slot < 0)
+        return; // readers are still busy with every other slot, skip
+
+    bool grabbed;
+    {
+        PerfScope scope(PerfMonitor::Capture);
+        grabbed = grab(slot);
+    }
+    if (!grabbed) {
+        frameRing.abort(slot);
+        return;
+    }
+    frameRing.commit(slot, QDateTime::currentMSecsSinceEpoch());
+
+    // One notification in flight is enough; readers always take the latest
+    if (notifyPending.testAndSetOrdered(0, 1)) {
+        QMetaObject::invokeMethod(this, [this]() {
+            notifyPending.storeRelease(0);
+            emit frameReady(frameRing.latestSequence());
+        }, Qt::QueuedConnection);
+    }
+}
+
+ScreenCaptureSource::ScreenCaptureSource(QObject *parent)
+    : CaptureSource(parent),
+      screen(nullptr)
+{
+}
+
+ScreenCaptureSource::~ScreenCaptureSource()
+{
+    stop();
+}
+
+bool ScreenCaptureSource::open()
+{
+    screen = selectedScreen();
+    if (!screen)
+        return false;
+
+    // Probe once so the buffers match the grab's device pixel size
+    const QImage probe = screen->grabWindow(0).toImage();
+    if (probe.isNull())
+        return false;
+    size = probe.size();
+
+    const qsizetype bytesPerLine = qsizetype(size.width()) * 4;
+    buffers.resize(frameRing.slotCount());
+    for (int i = 0; i < buffers.size(); ++i) {
+        buffers[i] = QByteArray(bytesPerLine * size.height(), Qt::Uninitialized);
+        frameRing.attach(i, reinterpret_cast<uchar *>(buffers[i].data()), size.width(), size.height(), bytesPerLine);
+    }
+    return true;
+}
+
+void ScreenCaptureSource::close()
+{
+    buffers.clear();
+    screen = nullptr;
+}
+
+bool ScreenCaptureSource::grab(int slot)
+{
+    // The screen may have been unplugged since open()
+    if (!screen || !QGuiApplication::screens().contains(screen))
+        return false;
+
+    QImage image = screen->grabWindow(0).toImage();
+    if (image.isNull())
+        return false;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32)
+        image = image.convertToFormat(QImage::Format_RGB32);
+
+    uchar *bits = frameRing.slotBits(slot);
+    const qsizetype bytesPerLine = frameRing.slotBytesPerLine(slot);
+    const int rows = qMin(image.height(), size.height());
+    const size_t rowBytes = size_t(qMin(image.width(), size.width())) * 4;
+    for (int y = 0; y < rows; ++y)
+        std::memcpy(bits + y * bytesPerLine, image.constScanLine(y), rowBytes);
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef CAPTURESOURCE_H
+#define CAPTURESOURCE_H
+
+#include <QObject>
+#include <QSize>
+#include <QAtomicInt>
+#include <QByteArray>
+#include "FrameRing.h"
+
+class QThread;
+class QTimer;
+class QScreen;
+
+// Single in-process screen capture feeding a FrameRing. Everything that
+// needs live frames (preview, ffmpeg) reads from the ring instead of
+// grabbing the screen on its own. Backends that can grab off the GUI thread
+// get a dedicated capture thread.
+class CaptureSource : public QObject
+{
+    Q_OBJECT
+public:
+    // Picks the cheapest backend available on this platform
+    static CaptureSource *create(QObject *parent = nullptr);
+    ~CaptureSource();
+
+    // Monitor to capture, by QScreen::name(); empty or unknown means the
+    // primary screen. Takes effect on the next start().
+    void setScreenName(const QString &name) { screenName = name; }
+
+    bool start(int fps);
+    void stop();
+    bool isActive() const { return active; }
+
+    QSize frameSize() const { return size; }
+    FrameRing *ring() { return &frameRing; }
+    virtual const char *backendName() const = 0;
+
+signals:
+    // Queued to the thread the source lives in; coalesced while unhandled
+    void frameReady(quint64 sequence);
+    void error(const QString &message);
+
+protected:
+    explicit CaptureSource(QObject *parent = nullptr);
+
+    // Allocates the slot buffers, attaches them to the ring and sets size
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    // Fills one ring slot with the current screen contents
+    virtual bool grab(int slot) = 0;
+    virtual bool grabsOffThread() const { return false; }
+
+    QScreen *selectedScreen() const;
+
+    FrameRing frameRing;
+    QSize size;
+    QString screenName;
+
+private:
+    void tick();
+
+    QThread *captureThread;
+    QTimer *tickTimer;
+    QAtomicInt notifyPending;
+    bool active;
+};
+
+// Portable fallback: QScreen grabs on the GUI thread, copied once into the
+// ring so readers see the same interface as the zero-copy backends
+class ScreenCaptureSource : public CaptureSource
+{
+    Q_OBJECT
+public:
+    explicit ScreenCaptureSource(QObject *parent = nullptr);
+    ~ScreenCaptureSource();
+
+    const char *backendName() const override { return "qscreen"; }
+
+protected:
+    bool open() override;
+    void close() override;
+    bool grab(int slot) override;
+
+private:
+    QVector<QByteArray> buffers;
+    QScreen *screen;
+};
+
+#endif // CAPTURESOURCE_H
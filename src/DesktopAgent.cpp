@@ -0,0 +1,184 @@
+#include "DesktopAgent.h"
+#include "BlobStore.h"
+#include "IdleMonitor.h"
+#include "InputActivity.h"
+#include "ScreenshotScheduler.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QDebug>
+
+DesktopAgent::DesktopAgent(QObject *parent)
+    : QObject(parent),
+      engine(nullptr),
+      inputSampler(nullptr),
+      tracking(false)
+{
+    QSettings settings("YourCompany", "TimeTrackerApp");
+
+    idle = new IdleMonitor(nullptr, this);
+    idle->setThreshold(settings.value("afk/thresholdSecs", 180).toLongLong() * 1000);
+    connect(idle, &IdleMonitor::idle, this, &DesktopAgent::idleDetected);
+
+    // Counts of keys, clicks and motion per minute, a far cheaper signal
+    // than screenshots
+    if (settings.value("activity/inputMetrics", true).toBool()) {
+        inputSampler = new InputActivitySampler(InputEventSource::create(), idle, this);
+        connect(inputSampler, &InputActivitySampler::minuteReady, this, [this](const ActivityMinute &minute) {
+            if (!engine)
+                return;
+            QMetaObject::invokeMethod(engine, [engine = engine, session = sampledSessionId, minute]() {
+                engine->recordInputActivity(session, minute);
+            });
+        });
+    }
+
+    screenshotPipeline = new ScreenshotPipeline(this);
+    EncoderSettings encoderSettings;
+    encoderSettings.format = EncoderSettings::formatFromString(settings.value("screenshot/format", "png").toString());
+    encoderSettings.quality = settings.value("screenshot/quality", -1).toInt();
+    encoderSettings.maxWidth = settings.value("screenshot/maxWidth", 0).toInt();
+    encoderSettings.maxHeight = settings.value("screenshot/maxHeight", 0).toInt();
+    encoderSettings.keyframeInterval = settings.value("screenshot/keyframeInterval", 20).toInt();
+    screenshotPipeline->setEncoderSettings(encoderSettings);
+    screenshotPipeline->setMaxWorkers(settings.value("screenshot/workers", 2).toInt());
+    screenshotPipeline->setCaptureMode(ScreenCapture::modeFromString(settings.value("screenshot/capture", "screens").toString()));
+    screenshotPipeline->setRedactionRules(RedactionRules::fromSettings(settings));
+    // 0 turns deduplication off
+    const qint64 blobCacheBytes = settings.value("screenshot/blobCacheMB", 64).toLongLong() * 1024 * 1024;
+    if (blobCacheBytes > 0) {
+        blobStore.reset(new BlobStore(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                                      + "/screenshot-blobs", blobCacheBytes));
+        screenshotPipeline->setBlobStore(blobStore.get());
+    }
+    connect(screenshotPipeline, &ScreenshotPipeline::screenshotEncoded,
+            this, &DesktopAgent::upload, Qt::QueuedConnection);
+    connect(screenshotPipeline, &ScreenshotPipeline::screenshotFailed, this, [](const QString &reason) {
+        qWarning() << reason;
+    });
+
+    // Shots follow activity and screen changes; the server's policy, once
+    // known, bounds the rate
+    screenshotScheduler = new ScreenshotScheduler(this);
+    ScreenshotPolicy screenshotPolicy;
+    screenshotPolicy.averageIntervalMsecs = settings.value("screenshot/averageIntervalSecs", 30).toLongLong() * 1000;
+    screenshotScheduler->setPolicy(screenshotPolicy);
+    screenshotScheduler->setIdleSource([this]() { return idle->idleMsecs(); });
+    screenshotScheduler->setGrabber([this]() { return ScreenCapture::grab(screenshotPipeline->captureMode()); });
+    screenshotScheduler->setProbeGrabber([this]() {
+        return ScreenCapture::grabStrips(screenshotPipeline->captureMode(), ScreenshotScheduler::ProbeRows);
+    });
+    // Probes never leave the machine; windows are only looked up for the
+    // frames that are kept
+    connect(screenshotScheduler, &ScreenshotScheduler::screenshotDue, this, [this](QList<CapturedScreen> screens) {
+        screenshotPipeline->markRedactions(screens);
+        screenshotPipeline->submit(screens, sessionId, clientSessionId);
+    });
+}
+
+DesktopAgent::~DesktopAgent()
+{
+    // Its workers use the blob store
+    delete screenshotPipeline;
+}
+
+void DesktopAgent::attach(TrackerEngine *trackerEngine)
+{
+    engine = trackerEngine;
+    connect(engine, &TrackerEngine::statusChanged, this, &DesktopAgent::follow);
+    connect(engine, &TrackerEngine::sessionStarted, this,
+            [this](const QString &, int, const QString &, const QJsonObject &policy) {
+        if (!policy.isEmpty())
+            screenshotScheduler->setPolicy(ScreenshotPolicy::fromJson(policy, screenshotScheduler->policy()));
+    });
+    connect(engine, &TrackerEngine::trackingStopped, this,
+            [this](const QString &stoppedSessionId, const QString &stoppedClientSessionId) {
+        // Take final screenshot; only the grab runs here, encoding happens
+        // on the pipeline's workers
+        screenshotPipeline->capture(stoppedSessionId, stoppedClientSessionId);
+    });
+    connect(engine, &TrackerEngine::uploadDropped, this, [this](const UploadItem &item, const QString &) {
+        // The server may now be missing a link in the delta chain
+        if (item.kind == UploadItem::Screenshot)
+            screenshotPipeline->requestKeyframe();
+        else if (item.kind == UploadItem::ScreenshotRef)
+            uploadBlob(item);
+    });
+}
+
+void DesktopAgent::follow(const EngineStatus &status)
+{
+    sessionId = status.sessionId;
+    clientSessionId = status.clientSessionId;
+    if (status.running == tracking)
+        return;
+
+    tracking = status.running;
+    if (tracking) {
+        idle->start();
+        screenshotScheduler->start();
+        if (inputSampler) {
+            sampledSessionId = clientSessionId;
+            inputSampler->start();
+        }
+    } else {
+        idle->stop();
+        screenshotScheduler->stop();
+        if (inputSampler)
+            inputSampler->stop();
+    }
+}
+
+void DesktopAgent::upload(const EncodedScreenshot &shot)
+{
+    UploadItem item;
+    item.fields["sessionId"] = shot.sessionId;
+    item.fields["clientSessionId"] = shot.clientSessionId;
+    item.fields["screen"] = shot.screenName;
+    if (!shot.blobKey.isEmpty())
+        item.fields["blob"] = shot.blobKey;
+    item.fileName = shot.fileName;
+
+    if (shot.duplicate) {
+        // Only the blob's key goes out; the type stays with the item for a
+        // full upload, should the server not have the blob
+        item.kind = UploadItem::ScreenshotRef;
+        item.endpoint = "/api/v1/screenshot-ref";
+        item.contentType = "application/json";
+        item.body = QJsonDocument(QJsonObject::fromVariantMap(item.fields)).toJson(QJsonDocument::Compact);
+        item.fields["mimeType"] = QString::fromLatin1(shot.mimeType);
+    } else {
+        item.kind = UploadItem::Screenshot;
+        item.endpoint = "/api/v1/upload-screenshot";
+        item.contentType = shot.mimeType;
+        item.body = shot.data;
+    }
+    enqueue(item);
+}
+
+void DesktopAgent::uploadBlob(const UploadItem &reference)
+{
+    UploadItem item;
+    item.kind = UploadItem::Screenshot;
+    item.endpoint = "/api/v1/upload-screenshot";
+    item.fileName = reference.fileName;
+    item.fields = reference.fields;
+    item.contentType = item.fields.take("mimeType").toString().toLatin1();
+    if (blobStore)
+        item.body = blobStore->read(item.fields.value("blob").toString());
+    if (item.body.isEmpty()) {
+        qWarning() << "Screenshot blob" << item.fields.value("blob").toString()
+                   << "unknown to the server and no longer stored, dropping it";
+        return;
+    }
+    enqueue(item);
+}
+
+void DesktopAgent::enqueue(const UploadItem &item)
+{
+    // Queued into the engine's thread
+    QMetaObject::invokeMethod(engine, [engine = engine, item]() {
+        engine->enqueueUpload(item);
+    });
+}
@@ -0,0 +1,55 @@
+#ifndef DESKTOPAGENT_H
+#define DESKTOPAGENT_H
+
+#include <QObject>
+#include <memory>
+#include "ScreenshotPipeline.h"
+#include "TrackerEngine.h"
+
+class BlobStore;
+class IdleMonitor;
+class InputActivitySampler;
+class ScreenshotScheduler;
+
+// The parts of tracking that need the desktop: idle detection and
+// screenshots. Screens can only be grabbed on the GUI thread, so this lives
+// there and follows the engine's status, running while a session runs;
+// encoded shots go to the engine's upload queue. What to do when the user
+// goes idle is the host's call, through idle(). Encoded shots are kept in a
+// local blob store, so an unchanged screen is sent as a reference to the
+// blob the server already has. Input is counted (never recorded) into
+// per-minute activity that goes out with the session's heartbeats.
+class DesktopAgent : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DesktopAgent(QObject *parent = nullptr);
+    ~DesktopAgent();
+
+    // Connects to an engine, which may live in another thread
+    void attach(TrackerEngine *engine);
+
+    IdleMonitor *idleMonitor() const { return idle; }
+
+signals:
+    void idleDetected(qint64 idleMsecs);
+
+private:
+    void follow(const EngineStatus &status);
+    void upload(const EncodedScreenshot &shot);
+    void uploadBlob(const UploadItem &reference);
+    void enqueue(const UploadItem &item);
+
+    TrackerEngine *engine;
+    IdleMonitor *idle;
+    ScreenshotScheduler *screenshotScheduler;
+    ScreenshotPipeline *screenshotPipeline;
+    InputActivitySampler *inputSampler;
+    std::unique_ptr<BlobStore> blobStore;
+    QString sessionId;
+    QString clientSessionId;
+    QString sampledSessionId; // the session input is being counted for
+    bool tracking;
+};
+
+#endif // DESKTOPAGENT_H
@@ -0,0 +1,236 @@
+#include "EngineClient.h"
+#include "EngineServer.h"
+#include "TimeAccount.h"
+#include "TrackerEngine.h"
+#include <QDate>
+#include <QDeadlineTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QTextStream>
+
+namespace {
+
+const char *const Usage =
+    "Usage: TimeTrackerApp --ctl <command>\n"
+    "  status            show the timer and upload state\n"
+    "  task <id>         select the task for the next session\n"
+    "  start [taskId]    start a session\n"
+    "  pause | resume | stop\n"
+    "  login <email>     log in, reading the password from standard input\n"
+    "  logout\n"
+    "  summary [day|week] [yyyy-mm-dd]\n"
+    "                    tracked time per task, today or this week by default\n"
+    "  watch             print status changes until interrupted\n"
+    "  quit              stop the running instance\n";
+
+QString describe(const QJsonObject &json)
+{
+    const EngineStatus status = EngineStatus::fromJson(json);
+    if (!status.loggedIn)
+        return "Logged out";
+
+    QString state = status.running ? "Running" : status.paused ? "Paused" : "Stopped";
+    QString line = QString("%1 %2, task %3, user %4")
+                       .arg(state, TimeAccount::format(status.elapsedMsecs / 1000))
+                       .arg(status.taskId)
+                       .arg(status.userName);
+    if (status.pendingUploads > 0) {
+        line += QString("; %1 upload(s) pending").arg(status.pendingUploads);
+        if (!status.uploadError.isEmpty())
+            line += QString(", retrying in %1 s (%2)").arg(status.retryInSecs).arg(status.uploadError);
+    }
+    return line;
+}
+
+QString describeSummary(const QJsonObject &json)
+{
+    QString text = json["period"].toString() == "week"
+        ? QString("Week of %1 to %2\n").arg(json["from"].toString(), json["to"].toString())
+        : QString("%1\n").arg(json["from"].toString());
+    const QJsonArray tasks = json["tasks"].toArray();
+    for (const QJsonValue &value : tasks) {
+        const QJsonObject task = value.toObject();
+        text += QString("  task %1  %2\n").arg(task["taskId"].toInt(), -6)
+                    .arg(TimeAccount::format(task["secs"].toInteger()));
+    }
+    text += QString("  total        %1").arg(TimeAccount::format(json["totalSecs"].toInteger()));
+    return text;
+}
+
+}
+
+EngineClient::EngineClient(QObject *parent)
+    : QObject(parent),
+      socket(new QLocalSocket(this)),
+      nextId(1)
+{
+}
+
+bool EngineClient::connectToEngine(const QString &name, int msecs)
+{
+    socket->connectToServer(name);
+    return socket->waitForConnected(msecs);
+}
+
+QString EngineClient::errorString() const
+{
+    return socket->errorString();
+}
+
+QJsonObject EngineClient::call(QJsonObject request, int msecs)
+{
+    const int id = nextId++;
+    request["id"] = id;
+    socket->write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+
+    QDeadlineTimer deadline(msecs);
+    while (!deadline.hasExpired()) {
+        const QJsonObject message = readMessage(int(deadline.remainingTime()));
+        if (message.isEmpty())
+            break;
+        if (message.contains("event"))
+            events.enqueue(message);
+        else if (message["id"].toInt() == id)
+            return message;
+    }
+    return QJsonObject();
+}
+
+QJsonObject EngineClient::nextEvent(int msecs)
+{
+    if (!events.isEmpty())
+        return events.dequeue();
+
+    // A negative timeout waits forever
+    QDeadlineTimer deadline(msecs);
+    while (!deadline.hasExpired()) {
+        const QJsonObject message = readMessage(int(deadline.remainingTime()));
+        if (message.isEmpty())
+            break;
+        if (message.contains("event"))
+            return message;
+    }
+    return QJsonObject();
+}
+
+QJsonObject EngineClient::readMessage(int msecs)
+{
+    while (!socket->canReadLine()) {
+        if (socket->bytesAvailable() > EngineServer::MaxLineBytes || !socket->waitForReadyRead(msecs))
+            return QJsonObject();
+    }
+    return QJsonDocument::fromJson(socket->readLine()).object();
+}
+
+bool EngineClient::isEngineRunning(const QString &name)
+{
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    return probe.waitForConnected(500);
+}
+
+int EngineClient::runCommand(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const QString command = arguments.value(0);
+    if (command.isEmpty() || command == "help") {
+        out << Usage;
+        return command.isEmpty() ? 2 : 0;
+    }
+
+    EngineClient client;
+    if (!client.connectToEngine(TrackerEngine::socketName())) {
+        err << "TimeTracker is not running: " << client.errorString() << "\n";
+        return 1;
+    }
+
+    QJsonObject request;
+    request["cmd"] = command;
+    if (command == "task" || command == "start") {
+        bool ok = true;
+        const int taskId = arguments.value(1).toInt(&ok);
+        if (arguments.size() > 1 && !ok) {
+            err << "Task id must be a number\n";
+            return 2;
+        }
+        if (arguments.size() > 1)
+            request["taskId"] = taskId;
+        else if (command == "task") {
+            out << Usage;
+            return 2;
+        }
+    } else if (command == "login") {
+        if (arguments.size() < 2) {
+            out << Usage;
+            return 2;
+        }
+        request["email"] = arguments.at(1);
+        request["password"] = QTextStream(stdin).readLine();
+        // Login answers through events
+        client.call({ { "cmd", "subscribe" } });
+    } else if (command == "watch") {
+        request["cmd"] = "subscribe";
+    } else if (command == "summary") {
+        for (const QString &argument : arguments.mid(1)) {
+            if (argument == "day" || argument == "week") {
+                request["period"] = argument;
+            } else if (QDate::fromString(argument, Qt::ISODate).isValid()) {
+                request["date"] = argument;
+            } else {
+                out << Usage;
+                return 2;
+            }
+        }
+    }
+
+    const QJsonObject reply = client.call(request);
+    if (reply.isEmpty()) {
+        err << "No answer from TimeTracker\n";
+        return 1;
+    }
+    if (!reply["ok"].toBool()) {
+        err << reply["error"].toString() << "\n";
+        return 1;
+    }
+
+    if (command == "login") {
+        for (;;) {
+            const QJsonObject event = client.nextEvent(30000);
+            if (event.isEmpty()) {
+                err << "Login timed out\n";
+                return 1;
+            }
+            if (event["event"].toString() == "loginFailed") {
+                err << event["title"].toString() << ": " << event["message"].toString() << "\n";
+                return 1;
+            }
+            if (event["event"].toString() == "status" && event["status"].toObject()["loggedIn"].toBool()) {
+                out << describe(event["status"].toObject()) << "\n";
+                return 0;
+            }
+        }
+    }
+
+    if (command == "summary") {
+        out << describeSummary(reply["summary"].toObject()) << "\n";
+        return 0;
+    }
+
+    out << describe(reply["status"].toObject()) << "\n";
+    if (command == "watch") {
+        out.flush();
+        for (;;) {
+            const QJsonObject event = client.nextEvent(-1);
+            if (event.isEmpty())
+                return 0; // the engine went away
+            if (event["event"].toString() == "status")
+                out << describe(event["status"].toObject()) << "\n";
+            else
+                out << event["event"].toString() << "\n";
+            out.flush();
+        }
+    }
+    return 0;
+}
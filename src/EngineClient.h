@@ -0,0 +1,40 @@
+#ifndef ENGINECLIENT_H
+#define ENGINECLIENT_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QQueue>
+#include <QStringList>
+
+class QLocalSocket;
+
+// Client side of the EngineServer protocol, with blocking calls for
+// command-line use
+class EngineClient : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EngineClient(QObject *parent = nullptr);
+
+    bool connectToEngine(const QString &name, int msecs = 1000);
+    QString errorString() const;
+
+    // Sends the request and waits for its reply; events that arrive in
+    // the meantime are kept for nextEvent(). Empty on timeout.
+    QJsonObject call(QJsonObject request, int msecs = 5000);
+    QJsonObject nextEvent(int msecs);
+
+    static bool isEngineRunning(const QString &name);
+    // `--ctl` entry point: runs one command against the running engine
+    // and prints the result; returns the process exit code
+    static int runCommand(const QStringList &arguments);
+
+private:
+    QJsonObject readMessage(int msecs);
+
+    QLocalSocket *socket;
+    QQueue<QJsonObject> events;
+    int nextId;
+};
+
+#endif // ENGINECLIENT_H
@@ -0,0 +1,169 @@
+#include "EngineServer.h"
+#include "TrackerEngine.h"
+#include <QDate>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+EngineServer::EngineServer(TrackerEngine *engine, QObject *parent)
+    : QObject(parent),
+      engine(engine),
+      server(new QLocalServer(this))
+{
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &EngineServer::handleConnection);
+
+    connect(engine, &TrackerEngine::statusChanged, this, [this](const EngineStatus &status) {
+        broadcast({ { "event", "status" }, { "status", status.toJson() } });
+    });
+    connect(engine, &TrackerEngine::loginFailed, this, [this](const QString &title, const QString &message) {
+        broadcast({ { "event", "loginFailed" }, { "title", title }, { "message", message } });
+    });
+    connect(engine, &TrackerEngine::sessionExpired, this, [this]() {
+        broadcast({ { "event", "sessionExpired" } });
+    });
+}
+
+bool EngineServer::listen(const QString &name)
+{
+    if (server->listen(name))
+        return true;
+    if (server->serverError() != QAbstractSocket::AddressInUseError)
+        return false;
+
+    QLocalSocket probe;
+    probe.connectToServer(name);
+    if (probe.waitForConnected(500))
+        return false;
+    QLocalServer::removeServer(name);
+    return server->listen(name);
+}
+
+void EngineServer::close()
+{
+    server->close();
+    subscribers.clear();
+    discarding.clear();
+}
+
+QString EngineServer::errorString() const
+{
+    return server->errorString();
+}
+
+void EngineServer::handleConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            subscribers.remove(socket);
+            discarding.remove(socket);
+            socket->deleteLater();
+        });
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            handleReadyRead(socket);
+        });
+    }
+}
+
+void EngineServer::handleReadyRead(QLocalSocket *socket)
+{
+    for (;;) {
+        const bool discard = discarding.contains(socket);
+        if (!discard && !socket->canReadLine() && socket->bytesAvailable() <= MaxLineBytes)
+            return;
+        // readLine() stops one byte short of its limit
+        const QByteArray line = socket->readLine(MaxLineBytes + 1);
+        if (line.isEmpty())
+            return;
+        if (discard) {
+            // The rest of an over-long request; its pieces aren't requests
+            if (line.endsWith('\n'))
+                discarding.remove(socket);
+            continue;
+        }
+        if (!line.endsWith('\n')) {
+            // Answered once, however the rest of it arrives
+            write(socket, { { "ok", false }, { "error", "request too long" } });
+            discarding.insert(socket);
+            continue;
+        }
+        QJsonParseError error;
+        const QJsonDocument document = QJsonDocument::fromJson(line, &error);
+        if (!document.isObject()) {
+            write(socket, { { "ok", false }, { "error", "malformed request: " + error.errorString() } });
+            continue;
+        }
+        const QJsonObject request = document.object();
+        QJsonObject reply = handleCommand(socket, request);
+        if (request.contains("id"))
+            reply["id"] = request["id"];
+        write(socket, reply);
+    }
+}
+
+QJsonObject EngineServer::handleCommand(QLocalSocket *socket, const QJsonObject &request)
+{
+    const QString command = request["cmd"].toString();
+    QString error;
+    QJsonObject summary;
+
+    if (command == "status") {
+        // Every reply carries the status
+    } else if (command == "subscribe") {
+        subscribers.insert(socket);
+    } else if (command == "task") {
+        engine->setTask(request["taskId"].toInt(-1));
+    } else if (command == "start") {
+        if (request.contains("taskId"))
+            engine->setTask(request["taskId"].toInt(-1));
+        const EngineStatus status = engine->status();
+        if (!status.loggedIn)
+            error = "not logged in";
+        else if (status.taskId == -1)
+            error = "no task selected";
+        else if (status.paused)
+            error = "a session is paused; resume or stop it";
+        else
+            engine->start();
+    } else if (command == "pause") {
+        engine->pause();
+    } else if (command == "resume") {
+        engine->resume();
+    } else if (command == "stop") {
+        engine->stop();
+    } else if (command == "login") {
+        // The outcome arrives as a status or loginFailed event
+        engine->login(request["email"].toString(), request["password"].toString());
+    } else if (command == "logout") {
+        engine->logout();
+    } else if (command == "summary") {
+        QDate date = QDate::fromString(request["date"].toString(), Qt::ISODate);
+        if (!date.isValid())
+            date = QDate::currentDate();
+        summary = engine->summary(request["period"].toString() == "week" ? ActivityLog::Week : ActivityLog::Day, date);
+    } else if (command == "quit") {
+        engine->requestQuit();
+    } else {
+        error = "unknown command: " + command;
+    }
+
+    QJsonObject reply;
+    reply["ok"] = error.isEmpty();
+    if (!error.isEmpty())
+        reply["error"] = error;
+    if (!summary.isEmpty())
+        reply["summary"] = summary;
+    reply["status"] = engine->status().toJson();
+    return reply;
+}
+
+void EngineServer::broadcast(const QJsonObject &event)
+{
+    for (QLocalSocket *socket : std::as_const(subscribers))
+        write(socket, event);
+}
+
+void EngineServer::write(QLocalSocket *socket, const QJsonObject &json)
+{
+    socket->write(QJsonDocument(json).toJson(QJsonDocument::Compact) + '\n');
+}
@@ -0,0 +1,52 @@
+#ifndef ENGINESERVER_H
+#define ENGINESERVER_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QSet>
+
+class QLocalServer;
+class QLocalSocket;
+class TrackerEngine;
+
+// Local control socket of a TrackerEngine, reachable by the same user only.
+// The protocol is one compact JSON object per line. Requests carry a "cmd"
+// (status, subscribe, task, start, pause, resume, stop, login, logout,
+// summary, quit) and an optional "id" echoed in the reply; replies hold
+// "ok", an "error" when it isn't, and the engine status afterwards.
+// summary takes a "period" ("day", the default, or "week") and an ISO
+// "date" (today by default); its reply adds a "summary" with the period,
+// "from" and "to" dates, "totalSecs" and "tasks" as {taskId, secs}, most
+// time first. Subscribed clients also get {"event": ...} lines whenever
+// the status changes, a login fails or the session expires. Lives in the
+// engine's thread.
+class EngineServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit EngineServer(TrackerEngine *engine, QObject *parent = nullptr);
+
+    // Takes over a socket left behind by a crashed instance, never one
+    // another instance is still serving
+    bool listen(const QString &name);
+    void close();
+    QString errorString() const;
+
+    // Longer requests are answered with an error and skipped whole; the
+    // connection stays open
+    static constexpr qint64 MaxLineBytes = 64 * 1024;
+
+private:
+    void handleConnection();
+    void handleReadyRead(QLocalSocket *socket);
+    QJsonObject handleCommand(QLocalSocket *socket, const QJsonObject &request);
+    void broadcast(const QJsonObject &event);
+    static void write(QLocalSocket *socket, const QJsonObject &json);
+
+    TrackerEngine *engine;
+    QLocalServer *server;
+    QSet<QLocalSocket *> subscribers;
+    QSet<QLocalSocket *> discarding; // inside an over-long request
+};
+
+#endif // ENGINESERVER_H
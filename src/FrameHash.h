@@ -0,0 +1,65 @@
+#ifndef FRAMEHASH_H
+#define FRAMEHASH_H
+
+#include <QtGlobal>
+#include <cstring>
+
+// Fast non-cryptographic hashing of raw pixel rows. Four independent
+// multiply-rotate lanes run over 8-byte words with no dependency between
+// them, so the inner loop vectorizes and stays close to memory bandwidth.
+namespace FrameHash {
+
+constexpr quint64 Prime1 = 0x9E3779B185EBCA87ULL;
+constexpr quint64 Prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr quint64 Prime3 = 0x165667B19E3779F9ULL;
+
+inline quint64 rotl(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+inline quint64 mix(quint64 acc, quint64 word)
+{
+    return rotl(acc + word * Prime2, 31) * Prime1;
+}
+
+// Hashes `rows` rows of `rowBytes` bytes each, `stride` bytes apart
+inline quint64 hashRows(const uchar *bits, int rowBytes, qsizetype stride, int rows, quint64 seed = 0)
+{
+    quint64 lane[4] = { seed + Prime1 + Prime2, seed + Prime2, seed, seed - Prime1 };
+    const int words = rowBytes / 8;
+    const int laneWords = words & ~3;
+
+    for (int y = 0; y < rows; ++y) {
+        const uchar *row = bits + y * stride;
+        for (int i = 0; i < laneWords; i += 4) {
+            quint64 w[4];
+            std::memcpy(w, row + i * 8, sizeof(w));
+            for (int k = 0; k < 4; ++k)
+                lane[k] = mix(lane[k], w[k]);
+        }
+        for (int i = laneWords; i < words; ++i) {
+            quint64 w;
+            std::memcpy(&w, row + i * 8, 8);
+            lane[i & 3] = mix(lane[i & 3], w);
+        }
+        if (rowBytes & 7) {
+            quint64 w = 0;
+            std::memcpy(&w, row + words * 8, rowBytes & 7);
+            lane[0] = mix(lane[0], w);
+        }
+    }
+
+    quint64 h = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+    h ^= quint64(rowBytes) * Prime3 + quint64(rows);
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+} // namespace FrameHash
+
+#endif // FRAMEHASH_H
@@ -0,0 +1,98 @@
+#include "FrameRing.h"
+
+FrameRing::FrameRing(int slotCount)
+    : entries(qMax(2, slotCount)),
+      nextSequence(1),
+      latest(-1)
+{
+}
+
+void FrameRing::attach(int slot, uchar *bits, int width, int height, qsizetype bytesPerLine)
+{
+    QMutexLocker locker(&mutex);
+    Entry &entry = entries[slot];
+    entry.bits = bits;
+    entry.width = width;
+    entry.height = height;
+    entry.bytesPerLine = bytesPerLine;
+    entry.sequence = 0;
+}
+
+void FrameRing::detachAll()
+{
+    QMutexLocker locker(&mutex);
+    for (Entry &entry : entries)
+        entry = Entry();
+    latest = -1;
+}
+
+int FrameRing::beginWrite()
+{
+    QMutexLocker locker(&mutex);
+
+    // Reuse the oldest free slot; the latest one stays readable
+    int candidate = -1;
+    for (int i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries[i];
+        if (i == latest || entry.writing || entry.readers > 0 || !entry.bits)
+            continue;
+        if (candidate < 0 || entry.sequence < entries[candidate].sequence)
+            candidate = i;
+    }
+
+    if (candidate >= 0)
+        entries[candidate].writing = true;
+    return candidate;
+}
+
+void FrameRing::commit(int slot, qint64 timestamp)
+{
+    QMutexLocker locker(&mutex);
+    Entry &entry = entries[slot];
+    entry.writing = false;
+    entry.sequence = nextSequence++;
+    entry.timestamp = timestamp;
+    latest = slot;
+}
+
+void FrameRing::abort(int slot)
+{
+    QMutexLocker locker(&mutex);
+    entries[slot].writing = false;
+}
+
+bool FrameRing::acquireLatest(Frame &frame, quint64 newerThan)
+{
+    QMutexLocker locker(&mutex);
+    if (latest < 0 || entries[latest].sequence <= newerThan)
+        return false;
+
+    Entry &entry = entries[latest];
+    ++entry.readers;
+
+    frame.bits = entry.bits;
+    frame.width = entry.width;
+    frame.height = entry.height;
+    frame.bytesPerLine = entry.bytesPerLine;
+    frame.sequence = entry.sequence;
+    frame.timestamp = entry.timestamp;
+    frame.slot = latest;
+    return true;
+}
+
+void FrameRing::release(Frame &frame)
+{
+    if (frame.slot < 0)
+        return;
+
+    QMutexLocker locker(&mutex);
+    --entries[frame.slot].readers;
+    frame.slot = -1;
+    frame.bits = nullptr;
+}
+
+quint64 FrameRing::latestSequence() const
+{
+    QMutexLocker locker(&mutex);
+    return latest < 0 ? 0 : entries[latest].sequence;
+}
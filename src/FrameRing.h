@@ -0,0 +1,65 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <QMutex>
+#include <QVector>
+
+// Small ring of frame buffers shared between one capture thread and any
+// number of readers (preview, encoder pipe). The buffers are owned by the
+// capture source, which can point them straight at memory the platform
+// grabs into (e.g. XShm segments), so frames are written once and read in
+// place. The producer never touches a slot a reader still holds.
+class FrameRing
+{
+public:
+    struct Frame
+    {
+        const uchar *bits = nullptr;
+        int width = 0;
+        int height = 0;
+        qsizetype bytesPerLine = 0;
+        quint64 sequence = 0;
+        qint64 timestamp = 0;
+        int slot = -1;
+    };
+
+    explicit FrameRing(int slotCount = 3);
+
+    int slotCount() const { return entries.size(); }
+    void attach(int slot, uchar *bits, int width, int height, qsizetype bytesPerLine);
+    void detachAll();
+
+    // Producer side: returns -1 when every slot is busy and the frame
+    // should be skipped
+    int beginWrite();
+    uchar *slotBits(int slot) const { return entries[slot].bits; }
+    qsizetype slotBytesPerLine(int slot) const { return entries[slot].bytesPerLine; }
+    void commit(int slot, qint64 timestamp);
+    void abort(int slot);
+
+    // Reader side: every successful acquire must be paired with release()
+    bool acquireLatest(Frame &frame, quint64 newerThan = 0);
+    void release(Frame &frame);
+
+    quint64 latestSequence() const;
+
+private:
+    struct Entry
+    {
+        uchar *bits = nullptr;
+        int width = 0;
+        int height = 0;
+        qsizetype bytesPerLine = 0;
+        quint64 sequence = 0;
+        qint64 timestamp = 0;
+        int readers = 0;
+        bool writing = false;
+    };
+
+    mutable QMutex mutex;
+    QVector<Entry> entries;
+    quint64 nextSequence;
+    int latest;
+};
+
+#endif // FRAMERING_H
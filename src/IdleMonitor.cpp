@@ -0,0 +1,133 @@
+#include "IdleMonitor.h"
+#include "PerfMonitor.h"
+#include <QGuiApplication>
+#include <QEvent>
+#include <QTimer>
+#ifdef TIMETRACKER_HAVE_XSS
+#include "X11IdleBackend.h"
+#endif
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+#ifdef Q_OS_WIN
+class WindowsIdleBackend : public IdleBackend
+{
+public:
+    const char *name() const override { return "win32"; }
+
+    qint64 idleMsecs() override
+    {
+        LASTINPUTINFO info;
+        info.cbSize = sizeof(info);
+        if (!GetLastInputInfo(&info))
+            return -1;
+        // Both are 32-bit tick counts, so the difference survives wraparound
+        return qint64(DWORD(GetTickCount() - info.dwTime));
+    }
+};
+#endif
+
+}
+
+IdleBackend *IdleBackend::create()
+{
+#ifdef Q_OS_WIN
+    return new WindowsIdleBackend;
+#else
+#ifdef TIMETRACKER_HAVE_XSS
+    if (QGuiApplication::platformName() == "xcb" && X11IdleBackend::isAvailable())
+        return new X11IdleBackend;
+#endif
+    return new ApplicationIdleBackend;
+#endif
+}
+
+ApplicationIdleBackend::ApplicationIdleBackend()
+{
+    lastInput.start();
+    QCoreApplication::instance()->installEventFilter(this);
+}
+
+ApplicationIdleBackend::~ApplicationIdleBackend()
+{
+    if (QCoreApplication::instance())
+        QCoreApplication::instance()->removeEventFilter(this);
+}
+
+bool ApplicationIdleBackend::eventFilter(QObject *watched, QEvent *event)
+{
+    switch (event->type()) {
+    case QEvent::KeyPress:
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseMove:
+    case QEvent::Wheel:
+    case QEvent::TouchBegin:
+        lastInput.start();
+        break;
+    default:
+        break;
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+IdleMonitor::IdleMonitor(IdleBackend *idleBackend, QObject *parent)
+    : QObject(parent),
+      backend(idleBackend ? idleBackend : IdleBackend::create()),
+      thresholdMsecs(3 * 60 * 1000),
+      active(false)
+{
+    checkTimer = new QTimer(this);
+    checkTimer->setSingleShot(true);
+    connect(checkTimer, &QTimer::timeout, this, &IdleMonitor::check);
+}
+
+IdleMonitor::~IdleMonitor() = default;
+
+void IdleMonitor::setThreshold(qint64 msecs)
+{
+    thresholdMsecs = qMax<qint64>(1000, msecs);
+    if (active)
+        check();
+}
+
+void IdleMonitor::start()
+{
+    active = true;
+    sinceStart.start();
+    check();
+}
+
+void IdleMonitor::stop()
+{
+    active = false;
+    checkTimer->stop();
+}
+
+void IdleMonitor::check()
+{
+    if (!active)
+        return;
+
+    PerfScope scope(PerfMonitor::AfkCheck);
+
+    qint64 idleFor = backend->idleMsecs();
+    if (idleFor < 0) {
+        // The backend couldn't answer this time; try again a budget later
+        checkTimer->start(int(thresholdMsecs));
+        return;
+    }
+
+    // Idle time from before start() doesn't count against this session
+    idleFor = qMin(idleFor, sinceStart.elapsed());
+    if (idleFor >= thresholdMsecs) {
+        stop();
+        emit idle(idleFor);
+        return;
+    }
+
+    // Nothing can cross the threshold before the remaining budget is spent
+    checkTimer->start(int(thresholdMsecs - idleFor));
+}
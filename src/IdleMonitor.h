@@ -0,0 +1,85 @@
+#ifndef IDLEMONITOR_H
+#define IDLEMONITOR_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <memory>
+
+class QTimer;
+
+// Source of system-wide idle time, i.e. how long ago the user last touched
+// any input device in any application
+class IdleBackend
+{
+public:
+    virtual ~IdleBackend() = default;
+
+    // Picks the best backend for this platform; never returns null
+    static IdleBackend *create();
+
+    virtual const char *name() const = 0;
+    // Milliseconds since the last input event, or -1 if unknown
+    virtual qint64 idleMsecs() = 0;
+    // False if input to other applications goes unseen
+    virtual bool isSystemWide() const { return true; }
+};
+
+// Last resort where the platform has no idle query: only sees input
+// delivered to this application, through an application-wide event filter
+class ApplicationIdleBackend : public QObject, public IdleBackend
+{
+    Q_OBJECT
+public:
+    ApplicationIdleBackend();
+    ~ApplicationIdleBackend();
+
+    const char *name() const override { return "application"; }
+    qint64 idleMsecs() override { return lastInput.elapsed(); }
+    bool isSystemWide() const override { return false; }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    QElapsedTimer lastInput;
+};
+
+// Emits idle() once the user has been inactive for the threshold. Instead
+// of polling, it asks the backend how long the user has already been idle
+// and sleeps for exactly the remaining budget; any input in the meantime
+// just means the next check arms a longer timer.
+class IdleMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    // Takes ownership of the backend; null picks the platform default
+    explicit IdleMonitor(IdleBackend *backend = nullptr, QObject *parent = nullptr);
+    ~IdleMonitor();
+
+    void setThreshold(qint64 msecs);
+    qint64 threshold() const { return thresholdMsecs; }
+
+    void start();
+    void stop();
+    bool isActive() const { return active; }
+
+    const char *backendName() const { return backend->name(); }
+    bool isSystemWide() const { return backend->isSystemWide(); }
+    // Current system idle time straight from the backend, -1 if unknown
+    qint64 idleMsecs() const { return backend->idleMsecs(); }
+
+signals:
+    // Fired once per start(); the monitor is stopped afterwards
+    void idle(qint64 idleMsecs);
+
+private:
+    void check();
+
+    std::unique_ptr<IdleBackend> backend;
+    QTimer *checkTimer;
+    QElapsedTimer sinceStart;
+    qint64 thresholdMsecs;
+    bool active;
+};
+
+#endif // IDLEMONITOR_H
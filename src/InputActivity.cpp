@@ -0,0 +1,269 @@
+#include "InputActivity.h"
+#include "IdleMonitor.h"
+#include <QDateTime>
+#include <QGuiApplication>
+#include <QTimer>
+#include <QDebug>
+#ifdef TIMETRACKER_HAVE_XI
+#include "X11InputSource.h"
+#endif
+#ifdef Q_OS_WIN
+#include <QSemaphore>
+#include <QThread>
+#include <windows.h>
+#endif
+
+namespace {
+
+constexpr int SampleMsecs = 1000;
+constexpr qint64 MinuteMsecs = 60 * 1000;
+// Threads past the last slot share it; adds stay atomic, only the line is
+// contended then
+constexpr int MaxSlots = 16;
+
+struct alignas(64) Slot
+{
+    QAtomicInteger<quint32> counts[InputCounters::KindCount];
+};
+
+Slot slots[MaxSlots];
+QAtomicInteger<int> slotsUsed(0);
+
+Slot &localSlot()
+{
+    thread_local Slot *slot = &slots[qMin(slotsUsed.fetchAndAddRelaxed(1), MaxSlots - 1)];
+    return *slot;
+}
+
+quint16 saturatingAdd(quint16 value, quint32 count)
+{
+    return quint16(qMin<quint32>(0xffff, value + count));
+}
+
+#ifdef Q_OS_WIN
+constexpr DWORD BatchMsecs = 100;
+
+// Raw Input on a message-only window, on a thread of its own. Only the
+// event kind is read: key down or up, button down, moved or not.
+class WindowsInputSource : public InputEventSource
+{
+public:
+    ~WindowsInputSource() override { stop(); }
+
+    const char *name() const override { return "rawinput"; }
+
+    bool start() override
+    {
+        if (thread)
+            return true;
+        QSemaphore ready;
+        bool registered = false;
+        thread = QThread::create([this, &ready, &registered]() { run(ready, registered); });
+        thread->start();
+        ready.acquire();
+        if (!registered) {
+            thread->wait();
+            delete thread;
+            thread = nullptr;
+        }
+        return registered;
+    }
+
+    void stop() override
+    {
+        if (!thread)
+            return;
+        PostThreadMessageW(threadId, WM_QUIT, 0, 0);
+        thread->wait();
+        delete thread;
+        thread = nullptr;
+    }
+
+private:
+    void run(QSemaphore &ready, bool &registered)
+    {
+        threadId = GetCurrentThreadId();
+        HWND window = CreateWindowExW(0, L"STATIC", nullptr, 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr, nullptr, nullptr);
+        // Generic desktop keyboards and mice; INPUTSINK delivers input meant
+        // for other applications too
+        RAWINPUTDEVICE devices[2] = {
+            { 0x01, 0x06, RIDEV_INPUTSINK, window },
+            { 0x01, 0x02, RIDEV_INPUTSINK, window },
+        };
+        registered = window && RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE));
+        ready.release();
+        if (!registered) {
+            if (window)
+                DestroyWindow(window);
+            return;
+        }
+
+        MSG message;
+        bool quit = false;
+        while (!quit) {
+            bool moved = false;
+            while (PeekMessageW(&message, nullptr, 0, 0, PM_REMOVE)) {
+                if (message.message == WM_QUIT) {
+                    quit = true;
+                    break;
+                }
+                if (message.message == WM_INPUT)
+                    count(reinterpret_cast<HRAWINPUT>(message.lParam), &moved);
+                // DefWindowProc cleans up after WM_INPUT
+                DispatchMessageW(&message);
+            }
+            if (moved)
+                InputCounters::add(InputCounters::Move);
+            if (quit)
+                break;
+            // Wait for input, then let a batch pile up
+            MsgWaitForMultipleObjects(0, nullptr, FALSE, INFINITE, QS_ALLINPUT);
+            Sleep(BatchMsecs);
+        }
+
+        for (RAWINPUTDEVICE &device : devices) {
+            device.dwFlags = RIDEV_REMOVE;
+            device.hwndTarget = nullptr;
+        }
+        RegisterRawInputDevices(devices, 2, sizeof(RAWINPUTDEVICE));
+        DestroyWindow(window);
+    }
+
+    static void count(HRAWINPUT handle, bool *moved)
+    {
+        RAWINPUT input;
+        UINT size = sizeof(input);
+        if (GetRawInputData(handle, RID_INPUT, &input, &size, sizeof(RAWINPUTHEADER)) == UINT(-1))
+            return;
+
+        if (input.header.dwType == RIM_TYPEKEYBOARD) {
+            if (!(input.data.keyboard.Flags & RI_KEY_BREAK))
+                InputCounters::add(InputCounters::Key);
+        } else if (input.header.dwType == RIM_TYPEMOUSE) {
+            const USHORT pressed = RI_MOUSE_LEFT_BUTTON_DOWN | RI_MOUSE_RIGHT_BUTTON_DOWN | RI_MOUSE_MIDDLE_BUTTON_DOWN
+                                 | RI_MOUSE_BUTTON_4_DOWN | RI_MOUSE_BUTTON_5_DOWN | RI_MOUSE_WHEEL | RI_MOUSE_HWHEEL;
+            if (input.data.mouse.usButtonFlags & pressed)
+                InputCounters::add(InputCounters::Click);
+            if (input.data.mouse.lLastX || input.data.mouse.lLastY)
+                *moved = true;
+        }
+    }
+
+    QThread *thread = nullptr;
+    DWORD threadId = 0;
+};
+#endif
+
+}
+
+void InputCounters::add(Kind kind, quint32 count)
+{
+    localSlot().counts[kind].fetchAndAddRelaxed(count);
+}
+
+std::array<quint32, InputCounters::KindCount> InputCounters::take()
+{
+    std::array<quint32, KindCount> totals = {};
+    const int used = qMin(slotsUsed.loadRelaxed(), MaxSlots);
+    for (int i = 0; i < used; ++i) {
+        for (int kind = 0; kind < KindCount; ++kind)
+            totals[kind] += slots[i].counts[kind].fetchAndStoreRelaxed(0);
+    }
+    return totals;
+}
+
+InputEventSource *InputEventSource::create()
+{
+#ifdef Q_OS_WIN
+    return new WindowsInputSource;
+#else
+#ifdef TIMETRACKER_HAVE_XI
+    if (QGuiApplication::platformName() == "xcb" && X11InputSource::isAvailable())
+        return new X11InputSource;
+#endif
+    return nullptr;
+#endif
+}
+
+InputActivitySampler::InputActivitySampler(InputEventSource *eventSource, IdleMonitor *idleMonitor, QObject *parent)
+    : QObject(parent),
+      source(eventSource),
+      idle(idleMonitor),
+      active(false)
+{
+    sampleTimer = new QTimer(this);
+    sampleTimer->setTimerType(Qt::CoarseTimer);
+    sampleTimer->setInterval(SampleMsecs);
+    connect(sampleTimer, &QTimer::timeout, this, &InputActivitySampler::sample);
+}
+
+InputActivitySampler::~InputActivitySampler()
+{
+    if (source && active)
+        source->stop();
+}
+
+void InputActivitySampler::start()
+{
+    if (active)
+        return;
+    if (source && !source->start()) {
+        qWarning() << "Input source" << source->name() << "unavailable, sampling idle time only";
+        source.reset();
+    }
+    // Whatever was counted while stopped isn't ours
+    InputCounters::take();
+    current = ActivityMinute();
+    active = true;
+    sampleTimer->start();
+}
+
+void InputActivitySampler::stop()
+{
+    if (!active)
+        return;
+    sampleTimer->stop();
+    if (source)
+        source->stop();
+    // The last, partial second
+    sample();
+    finishMinute();
+    active = false;
+}
+
+void InputActivitySampler::sample()
+{
+    // The second just sampled decides the minute, not the tick's lateness
+    const qint64 now = QDateTime::currentMSecsSinceEpoch() - SampleMsecs / 2;
+    const qint64 minute = now - now % MinuteMsecs;
+    if (current.start != minute) {
+        finishMinute();
+        current.start = minute;
+        current.offset = quint8((now - minute) / 1000);
+    }
+
+    quint32 events = 0;
+    if (source) {
+        const std::array<quint32, InputCounters::KindCount> counts = InputCounters::take();
+        current.keys = saturatingAdd(current.keys, counts[InputCounters::Key]);
+        current.clicks = saturatingAdd(current.clicks, counts[InputCounters::Click]);
+        current.moves = saturatingAdd(current.moves, counts[InputCounters::Move]);
+        events = counts[InputCounters::Key] + counts[InputCounters::Click] + counts[InputCounters::Move];
+    } else {
+        // Only whether there was any input at all is known
+        const qint64 idleFor = idle ? idle->idleMsecs() : -1;
+        events = idleFor >= 0 && idleFor < SampleMsecs ? 1 : 0;
+    }
+
+    quint8 &seconds = current.seconds[ActivityMinute::rateBin(events)];
+    if (seconds < 255)
+        ++seconds;
+}
+
+void InputActivitySampler::finishMinute()
+{
+    if (current.start == 0)
+        return;
+    emit minuteReady(current);
+    current = ActivityMinute();
+}
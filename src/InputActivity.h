@@ -0,0 +1,76 @@
+#ifndef INPUTACTIVITY_H
+#define INPUTACTIVITY_H
+
+#include <QObject>
+#include <array>
+#include <memory>
+#include "TrackTimePayload.h"
+
+class QTimer;
+class IdleMonitor;
+
+// Input event counters, safe to bump from any thread without a lock. Each
+// recording thread gets a cache line of its own, so a count is a relaxed
+// add no other thread contends for; take() swaps every line back to zero.
+namespace InputCounters {
+
+enum Kind { Key, Click, Move, KindCount };
+
+void add(Kind kind, quint32 count = 1);
+// Counts since the last take(), summed over threads
+std::array<quint32, KindCount> take();
+
+}
+
+// Counts system-wide input on a thread of its own, never looking at which
+// key or where the pointer went. Events are read in batches at most ten
+// times a second, so wake-ups don't follow the devices' report rate, and
+// pointer motion counts once per batch that had any.
+class InputEventSource
+{
+public:
+    virtual ~InputEventSource() = default;
+
+    // Null where the platform has no system-wide input events
+    static InputEventSource *create();
+
+    virtual const char *name() const = 0;
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+};
+
+// Turns the counters into fixed-size per-minute records. Once a second the
+// counts are taken and the second is filed into the minute's rate
+// histogram; each wall-clock minute then becomes one ActivityMinute. With
+// no event source, the idle time still tells active seconds from idle ones
+// and the counts stay zero.
+class InputActivitySampler : public QObject
+{
+    Q_OBJECT
+public:
+    // Takes ownership of the source; null samples idle time only
+    InputActivitySampler(InputEventSource *source, IdleMonitor *idle, QObject *parent = nullptr);
+    ~InputActivitySampler();
+
+    // stop() emits the minute sampled so far
+    void start();
+    void stop();
+    bool isActive() const { return active; }
+
+    const char *sourceName() const { return source ? source->name() : "idle"; }
+
+signals:
+    void minuteReady(const ActivityMinute &minute);
+
+private:
+    void sample();
+    void finishMinute();
+
+    std::unique_ptr<InputEventSource> source;
+    IdleMonitor *idle;
+    QTimer *sampleTimer;
+    ActivityMinute current;
+    bool active;
+};
+
+#endif // INPUTACTIVITY_H
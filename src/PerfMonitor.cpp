@@ -0,0 +1,303 @@
+#include "PerfMonitor.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QtAlgorithms>
+#include <QDebug>
+
+namespace {
+
+const char *const MetricNames[PerfMonitor::MetricCount] = {
+    "capture", "encode", "upload", "afk_check", "timer_tick", "preview", "state_checkpoint"
+};
+
+quint32 currentThreadIndex()
+{
+    static QAtomicInteger<quint32> nextIndex(1);
+    thread_local quint32 index = nextIndex.fetchAndAddRelaxed(1);
+    return index;
+}
+
+}
+
+PerfMonitor *PerfMonitor::instance()
+{
+    static PerfMonitor *monitor = [] {
+        PerfMonitor *created = new PerfMonitor;
+        // Timers and the debug server need the main thread, whichever
+        // thread happens to record first
+        if (QCoreApplication::instance())
+            created->moveToThread(QCoreApplication::instance()->thread());
+        return created;
+    }();
+    return monitor;
+}
+
+qint64 PerfMonitor::nowNsecs()
+{
+    static QElapsedTimer clock = [] {
+        QElapsedTimer started;
+        started.start();
+        return started;
+    }();
+    return clock.nsecsElapsed();
+}
+
+const char *PerfMonitor::metricName(Metric metric)
+{
+    return MetricNames[metric];
+}
+
+PerfMonitor::PerfMonitor(QObject *parent)
+    : QObject(parent),
+      trace(TraceCapacity),
+      traceNext(0),
+      traceWrapped(false),
+      logTimer(nullptr),
+      debugServer(nullptr)
+{
+}
+
+void PerfMonitor::recordLatency(Metric metric, qint64 startNsecs, qint64 durationNsecs)
+{
+    Histogram &histogram = histograms[metric];
+    const quint64 micros = quint64(qMax<qint64>(0, durationNsecs)) / 1000;
+    const int bucket = micros == 0 ? 0 : qMin(BucketCount - 1, 64 - qCountLeadingZeroBits(micros));
+
+    histogram.buckets[bucket].fetchAndAddRelaxed(1);
+    histogram.count.fetchAndAddRelaxed(1);
+    histogram.totalNsecs.fetchAndAddRelaxed(quint64(qMax<qint64>(0, durationNsecs)));
+    qint64 seenMax = histogram.maxNsecs.loadRelaxed();
+    while (durationNsecs > seenMax && !histogram.maxNsecs.testAndSetRelaxed(seenMax, durationNsecs, seenMax)) {
+    }
+
+    appendTrace({ startNsecs, durationNsecs, currentThreadIndex(), quint8(metric), 'X' });
+}
+
+void PerfMonitor::addBytes(Metric metric, qint64 bytes)
+{
+    histograms[metric].bytes.fetchAndAddRelaxed(quint64(qMax<qint64>(0, bytes)));
+}
+
+void PerfMonitor::setQueueDepth(Metric metric, int depth)
+{
+    Histogram &histogram = histograms[metric];
+    if (histogram.queueDepth.fetchAndStoreRelaxed(depth) == depth)
+        return;
+    qint32 seenMax = histogram.maxQueueDepth.loadRelaxed();
+    while (depth > seenMax && !histogram.maxQueueDepth.testAndSetRelaxed(seenMax, depth, seenMax)) {
+    }
+
+    appendTrace({ nowNsecs(), depth, currentThreadIndex(), quint8(metric), 'C' });
+}
+
+void PerfMonitor::setMemoryBytes(Metric metric, qint64 bytes)
+{
+    Histogram &histogram = histograms[metric];
+    histogram.memoryBytes.storeRelaxed(bytes);
+    qint64 seenMax = histogram.maxMemoryBytes.loadRelaxed();
+    while (bytes > seenMax && !histogram.maxMemoryBytes.testAndSetRelaxed(seenMax, bytes, seenMax)) {
+    }
+}
+
+void PerfMonitor::recordRequest(const QString &endpoint, qint64 durationNsecs, qint64 bodyBytes, qint64 wireBytes,
+                                bool ok, bool http2)
+{
+    QMutexLocker locker(&endpointMutex);
+    EndpointStats &stats = endpoints[endpoint];
+    ++stats.count;
+    stats.errors += ok ? 0 : 1;
+    stats.http2 += http2 ? 1 : 0;
+    stats.totalNsecs += quint64(qMax<qint64>(0, durationNsecs));
+    stats.maxNsecs = qMax(stats.maxNsecs, durationNsecs);
+    stats.bodyBytes += quint64(qMax<qint64>(0, bodyBytes));
+    stats.wireBytes += quint64(qMax<qint64>(0, wireBytes));
+}
+
+double PerfMonitor::markStartup(const QString &phase)
+{
+    const double msecs = nowNsecs() / 1e6;
+    QMutexLocker locker(&endpointMutex);
+    if (startup.contains(phase))
+        return -1;
+    startup[phase] = msecs;
+    return msecs;
+}
+
+void PerfMonitor::appendTrace(const TraceEvent &event)
+{
+    QMutexLocker locker(&traceMutex);
+    trace[traceNext] = event;
+    if (++traceNext == TraceCapacity) {
+        traceNext = 0;
+        traceWrapped = true;
+    }
+}
+
+QJsonObject PerfMonitor::snapshot() const
+{
+    QJsonObject metrics;
+    for (int m = 0; m < MetricCount; ++m) {
+        const Histogram &histogram = histograms[m];
+        const quint64 count = histogram.count.loadRelaxed();
+
+        quint64 counts[BucketCount];
+        for (int i = 0; i < BucketCount; ++i)
+            counts[i] = histogram.buckets[i].loadRelaxed();
+
+        // Upper bound of the bucket holding the requested rank
+        auto percentile = [&](double p) -> qint64 {
+            const quint64 rank = quint64(p * count);
+            quint64 seen = 0;
+            for (int i = 0; i < BucketCount; ++i) {
+                seen += counts[i];
+                if (seen > rank)
+                    return qint64(1) << i;
+            }
+            return qint64(1) << (BucketCount - 1);
+        };
+
+        QJsonObject metric;
+        metric["count"] = qint64(count);
+        metric["meanUs"] = count ? double(histogram.totalNsecs.loadRelaxed()) / count / 1000.0 : 0.0;
+        metric["p50Us"] = count ? percentile(0.50) : 0;
+        metric["p90Us"] = count ? percentile(0.90) : 0;
+        metric["p99Us"] = count ? percentile(0.99) : 0;
+        metric["maxUs"] = histogram.maxNsecs.loadRelaxed() / 1000;
+        metric["bytes"] = qint64(histogram.bytes.loadRelaxed());
+        metric["queueDepth"] = histogram.queueDepth.loadRelaxed();
+        metric["maxQueueDepth"] = histogram.maxQueueDepth.loadRelaxed();
+        metric["memoryBytes"] = histogram.memoryBytes.loadRelaxed();
+        metric["maxMemoryBytes"] = histogram.maxMemoryBytes.loadRelaxed();
+        metrics[MetricNames[m]] = metric;
+    }
+
+    QJsonObject requests;
+    {
+        QMutexLocker locker(&endpointMutex);
+        for (auto it = endpoints.cbegin(); it != endpoints.cend(); ++it) {
+            const EndpointStats &stats = it.value();
+            QJsonObject endpoint;
+            endpoint["count"] = qint64(stats.count);
+            endpoint["errors"] = qint64(stats.errors);
+            endpoint["http2"] = qint64(stats.http2);
+            endpoint["meanUs"] = stats.count ? double(stats.totalNsecs) / stats.count / 1000.0 : 0.0;
+            endpoint["maxUs"] = stats.maxNsecs / 1000;
+            endpoint["bodyBytes"] = qint64(stats.bodyBytes);
+            endpoint["wireBytes"] = qint64(stats.wireBytes);
+            requests[it.key()] = endpoint;
+        }
+    }
+    metrics["endpoints"] = requests;
+    {
+        QMutexLocker locker(&endpointMutex);
+        metrics["startup"] = startup;
+    }
+    return metrics;
+}
+
+QByteArray PerfMonitor::chromeTrace() const
+{
+    QVector<TraceEvent> events;
+    {
+        QMutexLocker locker(&traceMutex);
+        if (traceWrapped)
+            events = trace.mid(traceNext) + trace.mid(0, traceNext);
+        else
+            events = trace.mid(0, traceNext);
+    }
+
+    QJsonArray traceEvents;
+    const qint64 pid = QCoreApplication::applicationPid();
+    for (const TraceEvent &event : std::as_const(events)) {
+        QJsonObject json;
+        json["name"] = MetricNames[event.metric];
+        json["cat"] = "timetracker";
+        json["ph"] = QString(QChar(event.phase));
+        json["ts"] = double(event.timestamp) / 1000.0;
+        json["pid"] = pid;
+        json["tid"] = qint64(event.thread);
+        if (event.phase == 'X')
+            json["dur"] = double(event.value) / 1000.0;
+        else
+            json["args"] = QJsonObject{ { "depth", event.value } };
+        traceEvents.append(json);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = traceEvents;
+    root["displayTimeUnit"] = "ms";
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool PerfMonitor::exportTrace(const QString &path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(chromeTrace());
+    return file.commit();
+}
+
+void PerfMonitor::startLogging(int intervalSecs)
+{
+    if (intervalSecs <= 0) {
+        if (logTimer)
+            logTimer->stop();
+        return;
+    }
+
+    if (!logTimer) {
+        logTimer = new QTimer(this);
+        connect(logTimer, &QTimer::timeout, this, [this]() {
+            qInfo().noquote() << "perf" << QJsonDocument(snapshot()).toJson(QJsonDocument::Compact);
+        });
+    }
+    logTimer->start(intervalSecs * 1000);
+}
+
+bool PerfMonitor::startDebugServer(quint16 port)
+{
+    if (!debugServer) {
+        debugServer = new QTcpServer(this);
+        connect(debugServer, &QTcpServer::newConnection, this, &PerfMonitor::handleDebugConnection);
+    }
+    // Loopback only: metrics never leave the machine
+    if (!debugServer->isListening() && !debugServer->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Perf debug endpoint unavailable:" << debugServer->errorString();
+        return false;
+    }
+    return true;
+}
+
+void PerfMonitor::handleDebugConnection()
+{
+    while (QTcpSocket *socket = debugServer->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+            if (!socket->canReadLine())
+                return;
+            const QList<QByteArray> request = socket->readLine().split(' ');
+            const QByteArray path = request.value(1);
+
+            QByteArray status = "200 OK";
+            QByteArray body;
+            if (path == "/metrics")
+                body = QJsonDocument(snapshot()).toJson(QJsonDocument::Indented);
+            else if (path == "/trace")
+                body = chromeTrace();
+            else
+                status = "404 Not Found";
+
+            socket->write("HTTP/1.0 " + status + "\r\nContent-Type: application/json\r\nContent-Length: "
+                          + QByteArray::number(body.size()) + "\r\nConnection: close\r\n\r\n" + body);
+            socket->disconnectFromHost();
+        });
+    }
+}
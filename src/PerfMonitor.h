@@ -0,0 +1,120 @@
+#ifndef PERFMONITOR_H
+#define PERFMONITOR_H
+
+#include <QObject>
+#include <QAtomicInteger>
+#include <QJsonObject>
+#include <QMutex>
+#include <QHash>
+#include <QVector>
+
+class QTcpServer;
+class QTimer;
+
+// Always-on, low-overhead instrumentation for the agent's hot paths.
+// Latencies go into lock-free log2 histograms; a bounded ring keeps the
+// most recent trace events for export in Chrome trace-event format.
+// Metrics can be logged periodically or read from a localhost-only HTTP
+// endpoint (GET /metrics, GET /trace).
+class PerfMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    enum Metric { Capture, Encode, Upload, AfkCheck, TimerTick, Preview, StateCheckpoint, MetricCount };
+
+    static PerfMonitor *instance();
+    static qint64 nowNsecs();
+    static const char *metricName(Metric metric);
+
+    // Thread-safe
+    void recordLatency(Metric metric, qint64 startNsecs, qint64 durationNsecs);
+    void addBytes(Metric metric, qint64 bytes);
+    void setQueueDepth(Metric metric, int depth);
+    // Buffer memory currently held by the stage, e.g. upload bodies
+    void setMemoryBytes(Metric metric, qint64 bytes);
+    // One finished API request, keyed by URL path. wireBytes is the body
+    // size after compression.
+    void recordRequest(const QString &endpoint, qint64 durationNsecs, qint64 bodyBytes, qint64 wireBytes,
+                       bool ok, bool http2);
+    // Records when a startup phase was reached, in msecs since process
+    // start. Only the first mark of a phase counts; later ones return -1.
+    double markStartup(const QString &phase);
+
+    QJsonObject snapshot() const;
+    QByteArray chromeTrace() const;
+    bool exportTrace(const QString &path) const;
+
+    void startLogging(int intervalSecs);
+    bool startDebugServer(quint16 port);
+
+private:
+    explicit PerfMonitor(QObject *parent = nullptr);
+
+    static constexpr int BucketCount = 32; // 2^i microseconds
+    static constexpr int TraceCapacity = 16384;
+
+    struct Histogram
+    {
+        QAtomicInteger<quint64> buckets[BucketCount];
+        QAtomicInteger<quint64> count;
+        QAtomicInteger<quint64> totalNsecs;
+        QAtomicInteger<qint64> maxNsecs;
+        QAtomicInteger<quint64> bytes;
+        QAtomicInteger<qint32> queueDepth;
+        QAtomicInteger<qint32> maxQueueDepth;
+        QAtomicInteger<qint64> memoryBytes;
+        QAtomicInteger<qint64> maxMemoryBytes;
+    };
+
+    struct EndpointStats
+    {
+        quint64 count = 0;
+        quint64 errors = 0;
+        quint64 http2 = 0;
+        quint64 totalNsecs = 0;
+        qint64 maxNsecs = 0;
+        quint64 bodyBytes = 0;
+        quint64 wireBytes = 0;
+    };
+
+    struct TraceEvent
+    {
+        qint64 timestamp;
+        qint64 value; // duration for spans, depth for counters
+        quint32 thread;
+        quint8 metric;
+        char phase;
+    };
+
+    void appendTrace(const TraceEvent &event);
+    void handleDebugConnection();
+
+    Histogram histograms[MetricCount];
+    mutable QMutex endpointMutex;
+    QHash<QString, EndpointStats> endpoints;
+    QJsonObject startup; // phase -> msecs, guarded by endpointMutex
+    mutable QMutex traceMutex;
+    QVector<TraceEvent> trace;
+    int traceNext;
+    bool traceWrapped;
+    QTimer *logTimer;
+    QTcpServer *debugServer;
+};
+
+// Records the lifetime of the scope as one latency sample
+class PerfScope
+{
+public:
+    explicit PerfScope(PerfMonitor::Metric metric)
+        : metric(metric), start(PerfMonitor::nowNsecs()) {}
+    ~PerfScope()
+    {
+        PerfMonitor::instance()->recordLatency(metric, start, PerfMonitor::nowNsecs() - start);
+    }
+
+private:
+    PerfMonitor::Metric metric;
+    qint64 start;
+};
+
+#endif // PERFMONITOR_H
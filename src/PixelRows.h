@@ -0,0 +1,32 @@
+#ifndef PIXELROWS_H
+#define PIXELROWS_H
+
+#include <QtGlobal>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PIXELROWS_USE_SSE2
+#endif
+
+// Row kernels shared by the box filters that downscale or pixelate frames
+namespace PixelRows {
+
+// acc[i] += row[i] for n bytes, widening to 16 bits
+inline void accumulate(quint16 *acc, const uchar *row, int n)
+{
+    int i = 0;
+#ifdef PIXELROWS_USE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i *target = reinterpret_cast<__m128i *>(acc + i);
+        _mm_storeu_si128(target, _mm_add_epi16(_mm_loadu_si128(target), _mm_unpacklo_epi8(pixels, zero)));
+        _mm_storeu_si128(target + 1, _mm_add_epi16(_mm_loadu_si128(target + 1), _mm_unpackhi_epi8(pixels, zero)));
+    }
+#endif
+    for (; i < n; ++i)
+        acc[i] += row[i];
+}
+
+} // namespace PixelRows
+
+#endif // PIXELROWS_H
@@ -0,0 +1,145 @@
+#include "PreviewRenderer.h"
+#include "FrameHash.h"
+#include "PerfMonitor.h"
+#include "PixelRows.h"
+#include <cstring>
+
+namespace {
+
+constexpr int BaseIntervalMsecs = 100;
+constexpr int MinIntervalMsecs = 66;
+constexpr int MaxIntervalMsecs = 2000;
+constexpr int MaxRowTaps = 4;
+
+}
+
+PreviewRenderer::PreviewRenderer(QObject *parent)
+    : QObject(parent),
+      lastHash(0),
+      averageCost(0),
+      cpuBudget(0.05),
+      interval(BaseIntervalMsecs),
+      active(true)
+{
+}
+
+void PreviewRenderer::setTargetSize(const QSize &size)
+{
+    if (size != targetSize) {
+        targetSize = size;
+        lastHash = 0; // force a redraw at the new size
+    }
+}
+
+void PreviewRenderer::setActive(bool isActive)
+{
+    active = isActive;
+    if (active)
+        lastHash = 0;
+}
+
+bool PreviewRenderer::offer(const FrameRing::Frame &frame)
+{
+    if (!active || !frame.bits || targetSize.isEmpty())
+        return false;
+    if (sinceLastRender.isValid() && sinceLastRender.elapsed() < interval)
+        return false;
+
+    QElapsedTimer cost;
+    cost.start();
+    const qint64 traceStart = PerfMonitor::nowNsecs();
+    sinceLastRender.start();
+
+    QSize fitted = QSize(frame.width, frame.height).scaled(targetSize, Qt::KeepAspectRatio);
+    fitted = fitted.boundedTo(QSize(frame.width, frame.height));
+    if (fitted.isEmpty())
+        return false;
+
+    // Hash only the rows the downscaler samples; anything else can't show
+    // up in the preview anyway
+    quint64 hash = FrameHash::Prime3 ^ (quint64(fitted.width()) << 32 | quint64(fitted.height()));
+    for (int dy = 0; dy < fitted.height(); ++dy) {
+        const int y = int((qint64(2 * dy + 1) * frame.height) / (2 * fitted.height()));
+        hash = FrameHash::hashRows(frame.bits + y * frame.bytesPerLine, frame.width * 4, 0, 1, hash);
+    }
+
+    const bool changed = hash != lastHash;
+    if (changed) {
+        lastHash = hash;
+        if (preview.size() != fitted)
+            preview = QImage(fitted, QImage::Format_RGB32);
+        downscale(frame.bits, frame.width, frame.height, frame.bytesPerLine, preview, scratch);
+    }
+
+    const qint64 nsecs = cost.nsecsElapsed();
+    PerfMonitor::instance()->recordLatency(PerfMonitor::Preview, traceStart, nsecs);
+    adapt(nsecs, changed);
+    emit frameCost(nsecs, changed);
+    return changed;
+}
+
+void PreviewRenderer::adapt(qint64 costNsecs, bool changed)
+{
+    averageCost = averageCost == 0 ? costNsecs : (averageCost * 7 + costNsecs) / 8;
+
+    // Slowest rate that keeps the average cost within the CPU budget
+    const int budgetInterval = int(averageCost / 1000000.0 / cpuBudget);
+
+    // Static content backs off gradually, any change snaps back
+    const int contentInterval = changed ? BaseIntervalMsecs : qMin(MaxIntervalMsecs, interval * 3 / 2);
+
+    interval = qBound(MinIntervalMsecs, qMax(budgetInterval, contentInterval), MaxIntervalMsecs);
+}
+
+void PreviewRenderer::downscale(const uchar *bits, int width, int height, qsizetype bytesPerLine,
+                                QImage &dst, QVector<quint16> &scratch)
+{
+    const int dstWidth = dst.width();
+    const int dstHeight = dst.height();
+    const int rowValues = width * 4;
+    scratch.resize(rowValues);
+    quint16 *acc = scratch.data();
+
+    // Column spans and fixed-point reciprocals for every tap count
+    QVector<int> columnStart(dstWidth + 1);
+    for (int dx = 0; dx <= dstWidth; ++dx)
+        columnStart[dx] = int(qint64(dx) * width / dstWidth);
+    QVector<quint32> reciprocal(MaxRowTaps * dstWidth);
+    for (int taps = 1; taps <= MaxRowTaps; ++taps) {
+        for (int dx = 0; dx < dstWidth; ++dx) {
+            const int columns = qMax(1, columnStart[dx + 1] - columnStart[dx]);
+            reciprocal[(taps - 1) * dstWidth + dx] = (1u << 22) / quint32(columns * taps);
+        }
+    }
+
+    for (int dy = 0; dy < dstHeight; ++dy) {
+        const int y0 = int(qint64(dy) * height / dstHeight);
+        const int y1 = qMax(y0 + 1, int(qint64(dy + 1) * height / dstHeight));
+        const int taps = qMin(MaxRowTaps, y1 - y0);
+
+        std::memset(acc, 0, size_t(rowValues) * sizeof(quint16));
+        for (int k = 0; k < taps; ++k) {
+            const int y = y0 + ((2 * k + 1) * (y1 - y0)) / (2 * taps);
+            PixelRows::accumulate(acc, bits + y * bytesPerLine, rowValues);
+        }
+
+        const quint32 *inv = reciprocal.constData() + (taps - 1) * dstWidth;
+        quint32 *out = reinterpret_cast<quint32 *>(dst.scanLine(dy));
+        for (int dx = 0; dx < dstWidth; ++dx) {
+            quint32 blue = 0, green = 0, red = 0;
+            const quint16 *p = acc + columnStart[dx] * 4;
+            const quint16 *end = acc + qMax(columnStart[dx + 1], columnStart[dx] + 1) * 4;
+            for (; p < end; p += 4) {
+                blue += p[0];
+                green += p[1];
+                red += p[2];
+            }
+            const quint32 scale = inv[dx];
+            const quint32 half = 1u << 21;
+            out[dx] = 0xff000000u
+                | (((red * scale + half) >> 22) << 16)
+                | (((green * scale + half) >> 22) << 8)
+                | ((blue * scale + half) >> 22);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef PREVIEWRENDERER_H
+#define PREVIEWRENDERER_H
+
+#include <QObject>
+#include <QImage>
+#include <QVector>
+#include <QElapsedTimer>
+#include "FrameRing.h"
+
+// Turns captured frames into the small live preview. Frames are box
+// filtered straight into one reusable preview-sized image, unchanged
+// content is skipped, and the render rate adapts to window visibility and
+// a CPU budget measured from the cost of each rendered frame.
+class PreviewRenderer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit PreviewRenderer(QObject *parent = nullptr);
+
+    void setTargetSize(const QSize &size);
+    // Fraction of one core the preview may use, e.g. 0.05 for 5%
+    void setCpuBudget(double fraction) { cpuBudget = qBound(0.001, fraction, 1.0); }
+    void setActive(bool active);
+    bool isActive() const { return active; }
+
+    // Returns true when image() was updated from this frame
+    bool offer(const FrameRing::Frame &frame);
+    const QImage &image() const { return preview; }
+
+    int currentIntervalMsecs() const { return interval; }
+    qint64 averageCostNsecs() const { return averageCost; }
+
+    // Averages up to four sampled rows per output row, then full box
+    // columns. dst must be Format_RGB32 and smaller than the source.
+    static void downscale(const uchar *bits, int width, int height, qsizetype bytesPerLine,
+                          QImage &dst, QVector<quint16> &scratch);
+
+signals:
+    void frameCost(qint64 nsecs, bool rendered);
+
+private:
+    void adapt(qint64 costNsecs, bool changed);
+
+    QImage preview;
+    QSize targetSize;
+    QVector<quint16> scratch;
+    QElapsedTimer sinceLastRender;
+    quint64 lastHash;
+    qint64 averageCost;
+    double cpuBudget;
+    int interval;
+    bool active;
+};
+
+#endif // PREVIEWRENDERER_H
@@ -0,0 +1,161 @@
+#include "Redaction.h"
+#include "PixelRows.h"
+#include "ScreenCapture.h"
+#include <QRegion>
+#include <QSettings>
+#include <QVector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define REDACTION_USE_SSE2
+#endif
+
+namespace {
+
+constexpr quint32 FillColor = 0xff000000;
+
+void fillPixels(quint32 *pixels, int count, quint32 color)
+{
+    int i = 0;
+#ifdef REDACTION_USE_SSE2
+    const __m128i value = _mm_set1_epi32(int(color));
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), value);
+#endif
+    for (; i < count; ++i)
+        pixels[i] = color;
+}
+
+void fillRect(uchar *bits, qsizetype stride, const QRect &rect, quint32 color)
+{
+    for (int y = rect.top(); y <= rect.bottom(); ++y)
+        fillPixels(reinterpret_cast<quint32 *>(bits + y * stride) + rect.left(), rect.width(), color);
+}
+
+// Each block becomes its average colour. A band of block rows is summed
+// column-wise in one sequential pass, then every block of the band is
+// reduced and written back.
+void pixelateRect(uchar *bits, qsizetype stride, const QRect &rect, int block, QVector<quint16> &acc)
+{
+    const int rowBytes = rect.width() * 4;
+    acc.resize(rowBytes);
+
+    for (int top = rect.top(); top <= rect.bottom(); top += block) {
+        const int rows = qMin(block, rect.bottom() + 1 - top);
+        acc.fill(0);
+        for (int y = top; y < top + rows; ++y)
+            PixelRows::accumulate(acc.data(), bits + y * stride + rect.left() * 4, rowBytes);
+
+        for (int left = 0; left < rect.width(); left += block) {
+            const int columns = qMin(block, rect.width() - left);
+            quint32 sum[4] = { 0, 0, 0, 0 };
+            const quint16 *cell = acc.constData() + left * 4;
+            for (int x = 0; x < columns; ++x) {
+                for (int c = 0; c < 4; ++c)
+                    sum[c] += cell[x * 4 + c];
+            }
+            const quint32 samples = quint32(columns * rows);
+            quint32 color = 0;
+            for (int c = 0; c < 4; ++c)
+                color |= (sum[c] / samples) << (c * 8);
+            for (int y = top; y < top + rows; ++y)
+                fillPixels(reinterpret_cast<quint32 *>(bits + y * stride) + rect.left() + left, columns, color);
+        }
+    }
+}
+
+QList<QRegularExpression> patterns(const QStringList &list)
+{
+    QList<QRegularExpression> result;
+    for (const QString &pattern : list) {
+        QRegularExpression expression(pattern, QRegularExpression::CaseInsensitiveOption);
+        if (expression.isValid())
+            result.append(expression);
+    }
+    return result;
+}
+
+bool matchesAny(const QList<QRegularExpression> &expressions, const QString &text)
+{
+    if (text.isEmpty())
+        return false;
+    for (const QRegularExpression &expression : expressions) {
+        if (expression.match(text).hasMatch())
+            return true;
+    }
+    return false;
+}
+
+}
+
+RedactionRules RedactionRules::fromSettings(const QSettings &settings)
+{
+    RedactionRules rules;
+    rules.titles = patterns(settings.value("redact/windowTitles",
+                                           QStringList{ "KeePass", "1Password", "Bitwarden", "LastPass" }).toStringList());
+    rules.classes = patterns(settings.value("redact/windowClasses").toStringList());
+
+    const QStringList rects = settings.value("redact/rects").toStringList();
+    for (const QString &rect : rects) {
+        const QStringList parts = rect.split(',');
+        if (parts.size() == 4)
+            rules.rects.append(QRect(parts[0].trimmed().toInt(), parts[1].trimmed().toInt(),
+                                     parts[2].trimmed().toInt(), parts[3].trimmed().toInt()));
+    }
+
+    rules.style = settings.value("redact/style", "pixelate").toString().toLower() == "fill" ? Fill : Pixelate;
+    // 16-bit column sums hold up to 257 rows of bytes
+    rules.blockSize = qBound(2, settings.value("redact/blockSize", 24).toInt(), 256);
+    return rules;
+}
+
+QList<QRect> Redaction::regions(const RedactionRules &rules)
+{
+    QList<QRect> result = rules.rects;
+    if (rules.titles.isEmpty() && rules.classes.isEmpty())
+        return result;
+
+    result += ScreenCapture::windowsMatching([&rules](const QString &title, const QStringList &classes) {
+        if (matchesAny(rules.titles, title))
+            return true;
+        for (const QString &windowClass : classes) {
+            if (matchesAny(rules.classes, windowClass))
+                return true;
+        }
+        return false;
+    });
+    return result;
+}
+
+void Redaction::apply(QImage &image, const QRect &geometry, const QList<QRect> &regions,
+                      RedactionRules::Style style, int blockSize)
+{
+    if (regions.isEmpty() || image.isNull() || geometry.isEmpty())
+        return;
+
+    // Logical to image pixels; partly covered pixels are masked too
+    const qreal scaleX = qreal(image.width()) / geometry.width();
+    const qreal scaleY = qreal(image.height()) / geometry.height();
+    QRegion masked;
+    for (const QRect &region : regions) {
+        const QRectF scaled((region.x() - geometry.x()) * scaleX, (region.y() - geometry.y()) * scaleY,
+                            region.width() * scaleX, region.height() * scaleY);
+        const QRect pixels = scaled.toAlignedRect().intersected(image.rect());
+        if (!pixels.isEmpty())
+            masked += pixels;
+    }
+    if (masked.isEmpty())
+        return;
+
+    if (image.depth() != 32)
+        image = image.convertToFormat(QImage::Format_RGB32);
+    uchar *bits = image.bits();
+    const qsizetype stride = image.bytesPerLine();
+
+    QVector<quint16> scratch;
+    for (const QRect &rect : masked) {
+        if (style == RedactionRules::Fill)
+            fillRect(bits, stride, rect, FillColor);
+        else
+            pixelateRect(bits, stride, rect, blockSize, scratch);
+    }
+}
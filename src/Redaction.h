@@ -0,0 +1,48 @@
+#ifndef REDACTION_H
+#define REDACTION_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QRegularExpression>
+
+class QSettings;
+
+struct RedactionRules
+{
+    enum Style { Fill, Pixelate };
+
+    QList<QRegularExpression> titles;  // window titles, case-insensitive
+    QList<QRegularExpression> classes; // window classes (WM_CLASS on X11)
+    QList<QRect> rects;                // logical virtual-desktop coordinates
+    Style style = Pixelate;
+    int blockSize = 24;                // Pixelate only, in image pixels
+
+    bool isEmpty() const { return titles.isEmpty() && classes.isEmpty() && rects.isEmpty(); }
+
+    // redact/windowTitles and redact/windowClasses are regex lists,
+    // redact/rects a list of "x,y,w,h"; password managers are masked by
+    // default
+    static RedactionRules fromSettings(const QSettings &settings);
+};
+
+// Masks sensitive content out of captured frames before they are encoded.
+// Regions are resolved on the GUI thread at grab time, next to the grab, so
+// they match what was on screen; the masking itself runs on the encoder
+// workers and writes into the frame's own buffer.
+namespace Redaction {
+
+// GUI thread only. Fixed rects plus the frames of visible windows matching
+// the rules. A matching window is masked whole even where another window
+// covers it.
+QList<QRect> regions(const RedactionRules &rules);
+
+// Masks the parts of regions (logical coordinates) that fall inside an
+// image showing `geometry`. In place unless the image is shared or isn't
+// 32-bit.
+void apply(QImage &image, const QRect &geometry, const QList<QRect> &regions,
+           RedactionRules::Style style, int blockSize);
+
+}
+
+#endif // REDACTION_H
@@ -0,0 +1,377 @@
+#include "ScreenCapture.h"
+#include "PerfMonitor.h"
+#include <QGuiApplication>
+#include <QScreen>
+#include <QPixmap>
+#include <QPainter>
+#include <QCursor>
+#include <cstring>
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+namespace {
+
+QRect nativeActiveWindow();
+QList<QRect> nativeWindowsMatching(const ScreenCapture::WindowFilter &accept);
+
+CapturedScreen grabScreen(QScreen *screen, const QRect &area, const QString &name)
+{
+    PerfScope scope(PerfMonitor::Capture);
+    CapturedScreen captured;
+    captured.name = name;
+    if (area.isValid()) {
+        captured.image = screen->grabWindow(0, area.x(), area.y(), area.width(), area.height()).toImage();
+        captured.geometry = area.translated(screen->geometry().topLeft());
+    } else {
+        captured.image = screen->grabWindow(0).toImage();
+        captured.geometry = screen->geometry();
+    }
+    return captured;
+}
+
+// One-pixel strips through the centres of `rows` equal bands, stacked into
+// a rows-high image: what a sparse hash needs from a screen at a small
+// fraction of a full grab's cost
+CapturedScreen grabScreenStrips(QScreen *screen, const QRect &area, const QString &name, int rows)
+{
+    PerfScope scope(PerfMonitor::Capture);
+    const QRect region = area.isValid() ? area : QRect(QPoint(0, 0), screen->geometry().size());
+    CapturedScreen captured;
+    captured.name = name;
+    captured.geometry = region.translated(screen->geometry().topLeft());
+    if (region.isEmpty() || rows <= 0)
+        return captured;
+
+    QImage strips;
+    for (int row = 0; row < rows; ++row) {
+        const int y = region.y() + (row * 2 + 1) * region.height() / (2 * rows);
+        const QImage strip = screen->grabWindow(0, region.x(), y, region.width(), 1).toImage()
+                                 .convertToFormat(QImage::Format_RGB32);
+        if (strip.isNull())
+            return CapturedScreen();
+        if (strips.isNull())
+            strips = QImage(strip.width(), rows, QImage::Format_RGB32);
+        memcpy(strips.scanLine(row), strip.constScanLine(0), qMin(strips.bytesPerLine(), strip.bytesPerLine()));
+    }
+    captured.image = strips;
+    return captured;
+}
+
+struct Target
+{
+    QScreen *screen;
+    QRect area; // screen-local; invalid for the whole screen
+    QString name;
+};
+
+// What a mode captures, screen by screen
+QList<Target> targets(ScreenCapture::Mode mode)
+{
+    QList<Target> result;
+    if (mode == ScreenCapture::ActiveWindow) {
+        const QRect window = ScreenCapture::activeWindowGeometry();
+        QScreen *screen = window.isValid() ? QGuiApplication::screenAt(window.center()) : nullptr;
+        if (screen) {
+            const QRect area = window.intersected(screen->geometry()).translated(-screen->geometry().topLeft());
+            result.append({ screen, area, "window" });
+        } else if (QScreen *pointed = QGuiApplication::screenAt(QCursor::pos())) {
+            // No window information on this platform: take the screen the
+            // user is working on
+            result.append({ pointed, QRect(), pointed->name() });
+        }
+    } else if (mode == ScreenCapture::PrimaryScreen) {
+        if (QScreen *screen = QGuiApplication::primaryScreen())
+            result.append({ screen, QRect(), screen->name() });
+    } else {
+        const QList<QScreen *> screens = QGuiApplication::screens();
+        for (QScreen *screen : screens)
+            result.append({ screen, QRect(), screen->name() });
+    }
+    return result;
+}
+
+// Native window managers report device pixels; map them onto the screen
+// that holds the rect. Windows keeps screen origins unscaled, X11 scales
+// them along with everything else.
+QRect toLogical(const QRect &native)
+{
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (QScreen *screen : screens) {
+        const qreal ratio = screen->devicePixelRatio();
+        const QRect geometry = screen->geometry();
+#ifdef Q_OS_WIN
+        const QPoint nativeOrigin = geometry.topLeft();
+#else
+        const QPoint nativeOrigin = geometry.topLeft() * ratio;
+#endif
+        if (QRect(nativeOrigin, geometry.size() * ratio).contains(native.center()))
+            return QRect(geometry.topLeft() + (native.topLeft() - nativeOrigin) / ratio, native.size() / ratio);
+    }
+    return QRect();
+}
+
+}
+
+ScreenCapture::Mode ScreenCapture::modeFromString(const QString &name)
+{
+    const QString lower = name.toLower();
+    if (lower == "primary")
+        return PrimaryScreen;
+    if (lower == "stitched" || lower == "desktop")
+        return Stitched;
+    if (lower == "window" || lower == "activewindow")
+        return ActiveWindow;
+    return PerScreen;
+}
+
+QList<CapturedScreen> ScreenCapture::grab(Mode mode)
+{
+    QList<CapturedScreen> captured;
+    const QList<Target> selected = targets(mode);
+    for (const Target &target : selected)
+        captured.append(grabScreen(target.screen, target.area, target.name));
+    captured.removeIf([](const CapturedScreen &screen) { return screen.image.isNull(); });
+    return captured;
+}
+
+QList<CapturedScreen> ScreenCapture::grabStrips(Mode mode, int rows)
+{
+    QList<CapturedScreen> captured;
+    const QList<Target> selected = targets(mode);
+    for (const Target &target : selected)
+        captured.append(grabScreenStrips(target.screen, target.area, target.name, rows));
+    captured.removeIf([](const CapturedScreen &screen) { return screen.image.isNull(); });
+    return captured;
+}
+
+QImage ScreenCapture::stitch(const QList<CapturedScreen> &screens, const QSize &maxSize)
+{
+    QRect desktop;
+    qreal density = 1.0;
+    for (const CapturedScreen &screen : screens) {
+        desktop |= screen.geometry;
+        if (screen.geometry.width() > 0)
+            density = qMax(density, qreal(screen.image.width()) / screen.geometry.width());
+    }
+    if (desktop.isEmpty())
+        return QImage();
+
+    // Keep the sharpest screen's pixel density unless that exceeds maxSize
+    const QSizeF full = QSizeF(desktop.size()) * density;
+    qreal scale = 1.0;
+    if (maxSize.width() > 0)
+        scale = qMin(scale, maxSize.width() / full.width());
+    if (maxSize.height() > 0)
+        scale = qMin(scale, maxSize.height() / full.height());
+    const qreal factor = density * scale;
+
+    QImage result((QSizeF(desktop.size()) * factor).toSize(), QImage::Format_RGB32);
+    result.fill(Qt::black);
+    QPainter painter(&result);
+    for (const CapturedScreen &screen : screens) {
+        const QRect target = QRectF(QPointF(screen.geometry.topLeft() - desktop.topLeft()) * factor,
+                                    QSizeF(screen.geometry.size()) * factor).toRect();
+        if (screen.image.size() == target.size())
+            painter.drawImage(target.topLeft(), screen.image);
+        else
+            painter.drawImage(target.topLeft(), screen.image.scaled(target.size(), Qt::IgnoreAspectRatio,
+                                                                    Qt::SmoothTransformation));
+    }
+    return result;
+}
+
+QRect ScreenCapture::activeWindowGeometry()
+{
+    const QRect native = nativeActiveWindow();
+    return native.isValid() ? toLogical(native) : QRect();
+}
+
+QList<QRect> ScreenCapture::windowsMatching(const WindowFilter &accept)
+{
+    QList<QRect> windows;
+    const QList<QRect> native = nativeWindowsMatching(accept);
+    for (const QRect &rect : native) {
+        const QRect logical = toLogical(rect);
+        if (logical.isValid())
+            windows.append(logical);
+    }
+    return windows;
+}
+
+#ifdef TIMETRACKER_HAVE_X11
+// Xlib macros (None, Bool, Status...) clash with Qt, keep them last
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#endif
+
+namespace {
+
+QRect nativeActiveWindow()
+{
+#if defined(Q_OS_WIN)
+    HWND window = GetForegroundWindow();
+    RECT rect;
+    if (!window || !GetWindowRect(window, &rect))
+        return QRect();
+    return QRect(QPoint(rect.left, rect.top), QPoint(rect.right - 1, rect.bottom - 1));
+#elif defined(TIMETRACKER_HAVE_X11)
+    if (QGuiApplication::platformName() != "xcb")
+        return QRect();
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+        return QRect();
+
+    // The window manager publishes the focused top-level on the root window
+    QRect geometry;
+    const Window root = DefaultRootWindow(display);
+    const Atom activeAtom = XInternAtom(display, "_NET_ACTIVE_WINDOW", True);
+    Atom type = 0;
+    int format = 0;
+    unsigned long count = 0;
+    unsigned long remaining = 0;
+    unsigned char *data = nullptr;
+    if (activeAtom && XGetWindowProperty(display, root, activeAtom, 0, 1, False, XA_WINDOW, &type, &format,
+                                         &count, &remaining, &data) == Success && data && count == 1) {
+        const Window window = *reinterpret_cast<Window *>(data);
+        XWindowAttributes attributes;
+        Window child = 0;
+        int x = 0;
+        int y = 0;
+        if (window && XGetWindowAttributes(display, window, &attributes)
+                && XTranslateCoordinates(display, window, root, 0, 0, &x, &y, &child))
+            geometry = QRect(x, y, attributes.width, attributes.height);
+    }
+    if (data)
+        XFree(data);
+    XCloseDisplay(display);
+    return geometry;
+#else
+    return QRect();
+#endif
+}
+
+#if defined(Q_OS_WIN)
+struct EnumContext
+{
+    const ScreenCapture::WindowFilter *accept;
+    QList<QRect> windows;
+};
+
+BOOL CALLBACK enumWindow(HWND window, LPARAM param)
+{
+    EnumContext *context = reinterpret_cast<EnumContext *>(param);
+    if (!IsWindowVisible(window) || IsIconic(window))
+        return TRUE;
+
+    wchar_t title[512];
+    wchar_t className[256];
+    const int titleLength = GetWindowTextW(window, title, 512);
+    const int classLength = GetClassNameW(window, className, 256);
+    RECT rect;
+    if ((*context->accept)(QString::fromWCharArray(title, titleLength),
+                           { QString::fromWCharArray(className, classLength) })
+            && GetWindowRect(window, &rect))
+        context->windows.append(QRect(QPoint(rect.left, rect.top), QPoint(rect.right - 1, rect.bottom - 1)));
+    return TRUE;
+}
+#elif defined(TIMETRACKER_HAVE_X11)
+// Reads a property of up to `length` 32-bit items; caller frees with XFree
+unsigned char *windowProperty(Display *display, Window window, const char *name, Atom type,
+                              long length, unsigned long *count)
+{
+    const Atom atom = XInternAtom(display, name, True);
+    Atom actualType = 0;
+    int format = 0;
+    unsigned long remaining = 0;
+    unsigned char *data = nullptr;
+    *count = 0;
+    if (!atom || XGetWindowProperty(display, window, atom, 0, length, False, type, &actualType, &format,
+                                    count, &remaining, &data) != Success)
+        return nullptr;
+    if (data && actualType != type) {
+        XFree(data);
+        return nullptr;
+    }
+    return data;
+}
+
+QString windowTitle(Display *display, Window window)
+{
+    unsigned long count = 0;
+    const Atom utf8 = XInternAtom(display, "UTF8_STRING", False);
+    if (unsigned char *data = windowProperty(display, window, "_NET_WM_NAME", utf8, 1024, &count)) {
+        const QString title = QString::fromUtf8(reinterpret_cast<const char *>(data), int(count));
+        XFree(data);
+        return title;
+    }
+    char *name = nullptr;
+    if (!XFetchName(display, window, &name) || !name)
+        return QString();
+    const QString title = QString::fromLocal8Bit(name);
+    XFree(name);
+    return title;
+}
+#endif
+
+QList<QRect> nativeWindowsMatching(const ScreenCapture::WindowFilter &accept)
+{
+#if defined(Q_OS_WIN)
+    EnumContext context { &accept, {} };
+    EnumWindows(enumWindow, reinterpret_cast<LPARAM>(&context));
+    return context.windows;
+#elif defined(TIMETRACKER_HAVE_X11)
+    if (QGuiApplication::platformName() != "xcb")
+        return {};
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+        return {};
+
+    // The window manager lists the managed top-levels on the root window
+    QList<QRect> windows;
+    const Window root = DefaultRootWindow(display);
+    unsigned long count = 0;
+    unsigned char *list = windowProperty(display, root, "_NET_CLIENT_LIST", XA_WINDOW, 4096, &count);
+    const Window *clients = reinterpret_cast<const Window *>(list);
+    for (unsigned long i = 0; i < count; ++i) {
+        XWindowAttributes attributes;
+        if (!XGetWindowAttributes(display, clients[i], &attributes) || attributes.map_state != IsViewable)
+            continue;
+
+        QStringList classes;
+        XClassHint hint;
+        if (XGetClassHint(display, clients[i], &hint)) {
+            classes << QString::fromLocal8Bit(hint.res_name) << QString::fromLocal8Bit(hint.res_class);
+            XFree(hint.res_name);
+            XFree(hint.res_class);
+        }
+        if (!accept(windowTitle(display, clients[i]), classes))
+            continue;
+
+        Window child = 0;
+        int x = 0;
+        int y = 0;
+        if (!XTranslateCoordinates(display, clients[i], root, 0, 0, &x, &y, &child))
+            continue;
+        QRect frame(x, y, attributes.width, attributes.height);
+        // The decoration shows the title too
+        unsigned long extentCount = 0;
+        if (unsigned char *data = windowProperty(display, clients[i], "_NET_FRAME_EXTENTS", XA_CARDINAL, 4, &extentCount)) {
+            const long *extents = reinterpret_cast<const long *>(data);
+            if (extentCount == 4)
+                frame.adjust(-int(extents[0]), -int(extents[2]), int(extents[1]), int(extents[3]));
+            XFree(data);
+        }
+        windows.append(frame);
+    }
+    if (list)
+        XFree(list);
+    XCloseDisplay(display);
+    return windows;
+#else
+    Q_UNUSED(accept);
+    return {};
+#endif
+}
+
+}
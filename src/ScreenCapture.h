@@ -0,0 +1,62 @@
+#ifndef SCREENCAPTURE_H
+#define SCREENCAPTURE_H
+
+#include <QImage>
+#include <QList>
+#include <QRect>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+struct CapturedScreen
+{
+    QImage image;
+    QString name;   // QScreen::name(), or "window" for active-window grabs
+    QRect geometry; // logical virtual-desktop coordinates
+    QList<QRect> redactions; // logical areas to mask before encoding
+};
+
+// Screenshot capture across every attached monitor. QScreen grabs are bound
+// to the GUI thread, so grab() only collects raw per-screen images; scaling,
+// stitching and encoding belong on the pipeline's workers, where each
+// screen is processed as its own job.
+namespace ScreenCapture {
+
+enum Mode {
+    PrimaryScreen,  // primary monitor only
+    PerScreen,      // one image per monitor
+    Stitched,       // all monitors composed at their desktop positions
+    ActiveWindow    // the focused top-level window of any application
+};
+
+Mode modeFromString(const QString &name);
+
+// GUI thread only. Stitched returns the individual screens; compose them
+// with stitch() off the GUI thread.
+QList<CapturedScreen> grab(Mode mode);
+
+// GUI thread only. The same screens as grab(), each as `rows` one-pixel
+// strips through the centres of equal horizontal bands, stacked into a
+// rows-high image. Cheap input for change detection.
+QList<CapturedScreen> grabStrips(Mode mode, int rows);
+
+// Places the screens at their desktop positions. Every screen is scaled on
+// its own before composing so the result fits maxSize (empty = unbounded)
+// and the cost follows the output size rather than the desktop area.
+QImage stitch(const QList<CapturedScreen> &screens, const QSize &maxSize);
+
+// Logical geometry of the system's active window, or an invalid rect where
+// the platform can't tell
+QRect activeWindowGeometry();
+
+// Title and class names of a top-level window: WM_CLASS instance and class
+// on X11, the window class on Windows
+using WindowFilter = std::function<bool(const QString &title, const QStringList &classes)>;
+
+// Logical frames, title bar included, of the visible top-level windows the
+// filter accepts; empty where the platform can't enumerate windows
+QList<QRect> windowsMatching(const WindowFilter &accept);
+
+}
+
+#endif // SCREENCAPTURE_H
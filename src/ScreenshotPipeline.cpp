@@ -0,0 +1,264 @@
+#include "ScreenshotPipeline.h"
+#include "BlobStore.h"
+#include "FrameHash.h"
+#include "PerfMonitor.h"
+#include <QBuffer>
+#include <QImageWriter>
+#include <QDebug>
+
+EncoderSettings::Format EncoderSettings::formatFromString(const QString &name)
+{
+    const QString lower = name.toLower();
+    if (lower == "jpeg" || lower == "jpg")
+        return Jpeg;
+    if (lower == "webp")
+        return WebP;
+    if (lower == "tiledelta" || lower == "delta")
+        return TileDelta;
+    return Png;
+}
+
+ScreenshotPipeline::ScreenshotPipeline(QObject *parent)
+    : QObject(parent),
+      mode(ScreenCapture::PerScreen),
+      blobStore(nullptr)
+{
+    qRegisterMetaType<EncodedScreenshot>();
+
+    // Two workers are enough to keep up with a 30 s cadence even at 4K,
+    // and leave the rest of the machine alone
+    pool.setMaxThreadCount(2);
+    pool.setObjectName("ScreenshotEncoder");
+}
+
+ScreenshotPipeline::~ScreenshotPipeline()
+{
+    pool.clear();
+    pool.waitForDone();
+    qDeleteAll(deltaEncoders);
+}
+
+void ScreenshotPipeline::setEncoderSettings(const EncoderSettings &newSettings)
+{
+    settings = newSettings;
+
+    if (settings.format == EncoderSettings::WebP
+            && !QImageWriter::supportedImageFormats().contains("webp")) {
+        qWarning() << "WebP encoder plugin not available, falling back to PNG";
+        settings.format = EncoderSettings::Png;
+    }
+
+    QMutexLocker locker(&deltaMutex);
+    for (TileDeltaEncoder *encoder : std::as_const(deltaEncoders))
+        encoder->setKeyframeInterval(settings.keyframeInterval);
+}
+
+void ScreenshotPipeline::requestKeyframe()
+{
+    QMutexLocker locker(&deltaMutex);
+    for (TileDeltaEncoder *encoder : std::as_const(deltaEncoders))
+        encoder->requestKeyframe();
+}
+
+TileDeltaEncoder *ScreenshotPipeline::deltaEncoderFor(const QString &screenName)
+{
+    QMutexLocker locker(&deltaMutex);
+    TileDeltaEncoder *&encoder = deltaEncoders[screenName];
+    if (!encoder)
+        encoder = new TileDeltaEncoder(64, settings.keyframeInterval);
+    return encoder;
+}
+
+void ScreenshotPipeline::setMaxWorkers(int count)
+{
+    pool.setMaxThreadCount(qMax(1, count));
+}
+
+void ScreenshotPipeline::markRedactions(QList<CapturedScreen> &screens) const
+{
+    if (redaction.isEmpty() || screens.isEmpty())
+        return;
+
+    const QList<QRect> regions = Redaction::regions(redaction);
+    for (CapturedScreen &screen : screens) {
+        for (const QRect &region : regions) {
+            if (region.intersects(screen.geometry))
+                screen.redactions.append(region);
+        }
+    }
+}
+
+bool ScreenshotPipeline::capture(const QString &sessionId, const QString &clientSessionId)
+{
+    QList<CapturedScreen> screens = ScreenCapture::grab(mode);
+    markRedactions(screens);
+    return submit(screens, sessionId, clientSessionId);
+}
+
+bool ScreenshotPipeline::submit(const QList<CapturedScreen> &screens, const QString &sessionId,
+                                const QString &clientSessionId)
+{
+    if (screens.isEmpty())
+        return false;
+
+    const bool stitch = mode == ScreenCapture::Stitched && screens.size() > 1;
+    const int jobs = stitch ? 1 : int(screens.size());
+
+    // Keep at most one queued frame per worker so a slow encoder can't pile
+    // up full-resolution frames in memory; an idle pool always takes a set
+    const int queued = inFlight.fetchAndAddOrdered(jobs);
+    if (queued > 0 && queued + jobs > pool.maxThreadCount() * 2) {
+        inFlight.fetchAndSubOrdered(jobs);
+        qWarning() << "Screenshot encoder busy, dropping frame";
+        return false;
+    }
+
+    PerfMonitor::instance()->setQueueDepth(PerfMonitor::Encode, inFlight.loadRelaxed());
+
+    const EncoderSettings jobSettings = settings;
+    const RedactionRules::Style redactStyle = redaction.style;
+    const int redactBlock = redaction.blockSize;
+    auto run = [this, sessionId, clientSessionId, jobSettings, redactStyle, redactBlock](QList<CapturedScreen> input) {
+        EncodedScreenshot shot;
+        {
+            PerfScope scope(PerfMonitor::Encode);
+            // Each screen before stitching, at capture resolution
+            for (CapturedScreen &screen : input)
+                Redaction::apply(screen.image, screen.geometry, screen.redactions, redactStyle, redactBlock);
+            if (input.size() == 1) {
+                shot = encode(input.first().image, input.first().name, jobSettings);
+                shot.screenName = input.first().name;
+                shot.screenGeometry = input.first().geometry;
+            } else {
+                const QImage desktop = ScreenCapture::stitch(input, QSize(jobSettings.maxWidth, jobSettings.maxHeight));
+                shot = encode(desktop, "desktop", jobSettings);
+                shot.screenName = "desktop";
+                for (const CapturedScreen &screen : input)
+                    shot.screenGeometry |= screen.geometry;
+            }
+        }
+        PerfMonitor::instance()->addBytes(PerfMonitor::Encode, shot.data.size());
+        shot.sessionId = sessionId;
+        shot.clientSessionId = clientSessionId;
+        PerfMonitor::instance()->setQueueDepth(PerfMonitor::Encode, inFlight.fetchAndSubOrdered(1) - 1);
+
+        QMetaObject::invokeMethod(this, [this, shot]() {
+            if (shot.data.isEmpty() && !shot.duplicate)
+                emit screenshotFailed("Could not encode screenshot");
+            else
+                emit screenshotEncoded(shot);
+        }, Qt::QueuedConnection);
+    };
+
+    // Jobs take their frames over, so redaction can write into the
+    // buffers without copying them
+    if (stitch) {
+        pool.start([run, screens]() mutable { run(std::move(screens)); });
+    } else {
+        for (const CapturedScreen &screen : screens) {
+            pool.start([run, screen]() mutable {
+                QList<CapturedScreen> input;
+                input.append(std::move(screen));
+                run(std::move(input));
+            });
+        }
+    }
+    return true;
+}
+
+EncodedScreenshot ScreenshotPipeline::encode(const QImage &frame, const QString &screenName,
+                                             const EncoderSettings &settings)
+{
+    if (settings.format != EncoderSettings::TileDelta && !blobStore)
+        return encodeStill(frame, settings);
+
+    EncodedScreenshot shot;
+    const QImage image = prepare(frame, settings);
+
+    if (settings.format != EncoderSettings::TileDelta) {
+        // The encoder settings seed the hash, so a blob never stands in for
+        // a frame encoded differently
+        const quint64 seed = (quint64(settings.format) << 32) | quint32(settings.quality);
+        const quint64 frameHash = FrameHash::hashRows(image.constBits(), image.width() * 4,
+                                                      image.bytesPerLine(), image.height(), seed);
+        const QString key = BlobStore::key(frameHash);
+        if (blobStore->touch(key)) {
+            shot.size = image.size();
+            describeStill(settings.format, &shot);
+            shot.duplicate = true;
+        } else {
+            shot = encodePrepared(image, settings);
+            if (!shot.data.isEmpty())
+                blobStore->insert(key, shot.data);
+        }
+        shot.blobKey = key;
+        return shot;
+    }
+
+    shot.size = image.size();
+    shot.data = deltaEncoderFor(screenName)->encode(image);
+    shot.mimeType = "application/x-tile-delta";
+    shot.fileName = "screenshot.ttd";
+    return shot;
+}
+
+QImage ScreenshotPipeline::prepare(const QImage &frame, const EncoderSettings &settings)
+{
+    QImage image = frame;
+
+    if (settings.maxWidth > 0 || settings.maxHeight > 0) {
+        QSize bound(settings.maxWidth > 0 ? settings.maxWidth : image.width(),
+                    settings.maxHeight > 0 ? settings.maxHeight : image.height());
+        if (image.width() > bound.width() || image.height() > bound.height())
+            image = image.scaled(bound, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+
+    // Screens have no meaningful alpha; dropping it keeps every encoder on
+    // its fast path
+    if (image.format() != QImage::Format_RGB32)
+        image = image.convertToFormat(QImage::Format_RGB32);
+
+    return image;
+}
+
+EncodedScreenshot ScreenshotPipeline::encodeStill(const QImage &frame, const EncoderSettings &settings)
+{
+    return encodePrepared(prepare(frame, settings), settings);
+}
+
+QByteArray ScreenshotPipeline::describeStill(EncoderSettings::Format format, EncodedScreenshot *shot)
+{
+    switch (format) {
+        case EncoderSettings::Jpeg:
+            shot->mimeType = "image/jpeg";
+            shot->fileName = "screenshot.jpg";
+            return "jpeg";
+        case EncoderSettings::WebP:
+            shot->mimeType = "image/webp";
+            shot->fileName = "screenshot.webp";
+            return "webp";
+        default:
+            shot->mimeType = "image/png";
+            shot->fileName = "screenshot.png";
+            return "png";
+    }
+}
+
+EncodedScreenshot ScreenshotPipeline::encodePrepared(const QImage &image, const EncoderSettings &settings)
+{
+    EncodedScreenshot shot;
+    shot.size = image.size();
+    const QByteArray writerFormat = describeStill(settings.format, &shot);
+
+    QBuffer buffer(&shot.data);
+    buffer.open(QIODevice::WriteOnly);
+    QImageWriter writer(&buffer, writerFormat);
+    if (settings.quality >= 0)
+        writer.setQuality(settings.quality);
+    if (!writer.write(image)) {
+        qWarning() << "Screenshot encode failed:" << writer.errorString();
+        shot.data.clear();
+    }
+
+    return shot;
+}
@@ -0,0 +1,115 @@
+#ifndef SCREENSHOTPIPELINE_H
+#define SCREENSHOTPIPELINE_H
+
+#include <QObject>
+#include <QImage>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QHash>
+#include "TileDeltaEncoder.h"
+#include "ScreenCapture.h"
+#include "Redaction.h"
+
+struct EncoderSettings
+{
+    enum Format { Png, Jpeg, WebP, TileDelta };
+
+    Format format = Png;
+    int quality = -1;   // 0-100, -1 keeps the encoder default
+    int maxWidth = 0;   // 0 keeps the captured size
+    int maxHeight = 0;
+    int keyframeInterval = 20; // TileDelta only
+
+    static Format formatFromString(const QString &name);
+};
+
+struct EncodedScreenshot
+{
+    QByteArray data;
+    QByteArray mimeType;
+    QString fileName;
+    QSize size;
+    QString sessionId;
+    QString clientSessionId;
+    QString screenName;
+    QRect screenGeometry;
+    QString blobKey;        // still formats with a blob store only
+    bool duplicate = false; // data is empty; the blob store has it under blobKey
+};
+Q_DECLARE_METATYPE(EncodedScreenshot)
+
+class BlobStore;
+
+// Grabs on the GUI thread and hands conversion, downscaling and encoding to
+// a bounded worker pool. Every screen is its own job, so monitors are
+// scaled and encoded in parallel. Results come back through a queued signal.
+// Redaction runs on the workers ahead of encoding, so nothing masked ever
+// reaches an encoder, the blob store or the network. With a blob store, a
+// frame that is already stored is not encoded again.
+class ScreenshotPipeline : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScreenshotPipeline(QObject *parent = nullptr);
+    ~ScreenshotPipeline();
+
+    void setEncoderSettings(const EncoderSettings &settings);
+    EncoderSettings encoderSettings() const { return settings; }
+
+    void setMaxWorkers(int count);
+    int maxWorkers() const { return pool.maxThreadCount(); }
+
+    // Not owned; must outlive the pipeline. TileDelta frames bypass it,
+    // their chain already makes unchanged frames cheap.
+    void setBlobStore(BlobStore *store) { blobStore = store; }
+
+    void setCaptureMode(ScreenCapture::Mode captureMode) { mode = captureMode; }
+    ScreenCapture::Mode captureMode() const { return mode; }
+
+    void setRedactionRules(const RedactionRules &rules) { redaction = rules; }
+    RedactionRules redactionRules() const { return redaction; }
+
+    // Restarts the tile delta chains, e.g. after the server missed a frame
+    void requestKeyframe();
+
+    // GUI thread only, right after the grab: marks the areas the redaction
+    // rules cover at this moment
+    void markRedactions(QList<CapturedScreen> &screens) const;
+    // Must be called on the GUI thread
+    bool capture(const QString &sessionId, const QString &clientSessionId = QString());
+    // Safe from any thread. Screens are encoded one per job, or composed
+    // into one image in Stitched mode; sets that don't fit under the
+    // in-flight limit are dropped whole.
+    bool submit(const QList<CapturedScreen> &screens, const QString &sessionId,
+                const QString &clientSessionId = QString());
+
+    // Downscale and encode with a still-image format; used by the workers
+    // and the benchmarks. TileDelta needs the pipeline's chain state and is
+    // handled by encode() instead.
+    static EncodedScreenshot encodeStill(const QImage &frame, const EncoderSettings &settings);
+
+signals:
+    void screenshotEncoded(const EncodedScreenshot &shot);
+    void screenshotFailed(const QString &reason);
+
+private:
+    EncodedScreenshot encode(const QImage &frame, const QString &screenName, const EncoderSettings &settings);
+    static QImage prepare(const QImage &frame, const EncoderSettings &settings);
+    static EncodedScreenshot encodePrepared(const QImage &image, const EncoderSettings &settings);
+    // Writer format for a still format; fills in the shot's type and name
+    static QByteArray describeStill(EncoderSettings::Format format, EncodedScreenshot *shot);
+    // One delta chain per screen, since they change independently
+    TileDeltaEncoder *deltaEncoderFor(const QString &screenName);
+
+    QThreadPool pool;
+    EncoderSettings settings;
+    RedactionRules redaction;
+    ScreenCapture::Mode mode;
+    BlobStore *blobStore;
+    QAtomicInt inFlight;
+    QMutex deltaMutex;
+    QHash<QString, TileDeltaEncoder *> deltaEncoders;
+};
+
+#endif // SCREENSHOTPIPELINE_H
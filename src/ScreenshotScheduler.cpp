@@ -0,0 +1,202 @@
+#include "ScreenshotScheduler.h"
+#include "TimeAccount.h"
+#include <QJsonObject>
+#include <QTimer>
+#include <QtAlgorithms>
+
+namespace {
+
+constexpr qint64 HourMsecs = 60 * 60 * 1000;
+constexpr qint64 MinProbeMsecs = 1000;
+constexpr qint64 MaxProbeMsecs = 5000;
+// Credits saved up during quiet periods, spent on bursts of change
+constexpr double MaxCredits = 4.0;
+// Hash distances below this are encoder noise, blinking cursors and clocks
+constexpr int ChangeThreshold = 4;
+// Distance at which a change counts as a full screen switch
+constexpr int FullChangeDistance = 24;
+
+}
+
+ScreenshotPolicy ScreenshotPolicy::fromJson(const QJsonObject &json, const ScreenshotPolicy &base)
+{
+    ScreenshotPolicy policy = base;
+    if (json.contains("minIntervalSecs"))
+        policy.minIntervalMsecs = qint64(json["minIntervalSecs"].toDouble() * 1000);
+    if (json.contains("maxIntervalSecs"))
+        policy.maxIntervalMsecs = qint64(json["maxIntervalSecs"].toDouble() * 1000);
+    if (json.contains("maxPerHour"))
+        policy.maxPerHour = json["maxPerHour"].toInt();
+    return policy;
+}
+
+ScreenshotScheduler::ScreenshotScheduler(QObject *parent)
+    : QObject(parent),
+      grabber([]() { return ScreenCapture::grab(ScreenCapture::PerScreen); }),
+      probeGrabber([]() { return ScreenCapture::grabStrips(ScreenCapture::PerScreen, ProbeRows); }),
+      clock(&TimeAccount::steadyNowMsecs),
+      lastShotAt(0),
+      lastProbeAt(0),
+      activity(0),
+      credits(1),
+      active(false)
+{
+    probeTimer = new QTimer(this);
+    probeTimer->setSingleShot(true);
+    connect(probeTimer, &QTimer::timeout, this, &ScreenshotScheduler::probe);
+}
+
+void ScreenshotScheduler::setPolicy(const ScreenshotPolicy &policy)
+{
+    currentPolicy = policy;
+    currentPolicy.minIntervalMsecs = qMax<qint64>(1000, currentPolicy.minIntervalMsecs);
+    currentPolicy.maxIntervalMsecs = qMax(currentPolicy.minIntervalMsecs, currentPolicy.maxIntervalMsecs);
+    currentPolicy.averageIntervalMsecs = qBound(currentPolicy.minIntervalMsecs, currentPolicy.averageIntervalMsecs,
+                                                currentPolicy.maxIntervalMsecs);
+    currentPolicy.maxPerHour = qMax(1, currentPolicy.maxPerHour);
+}
+
+void ScreenshotScheduler::start()
+{
+    if (active)
+        return;
+    active = true;
+    lastShotAt = lastProbeAt = clock();
+    lastHashes.clear();
+    activity = 0;
+    credits = 1;
+    scheduleProbe();
+}
+
+void ScreenshotScheduler::stop()
+{
+    active = false;
+    probeTimer->stop();
+}
+
+void ScreenshotScheduler::scheduleProbe()
+{
+    if (active)
+        probeTimer->start(int(qBound(MinProbeMsecs, currentPolicy.minIntervalMsecs / 2, MaxProbeMsecs)));
+}
+
+void ScreenshotScheduler::probe()
+{
+    if (!active)
+        return;
+
+    const qint64 now = clock();
+    const qint64 sinceProbe = now - lastProbeAt;
+    lastProbeAt = now;
+    credits = qMin(MaxCredits, credits + double(sinceProbe) / currentPolicy.averageIntervalMsecs);
+
+    // Unknown idle time counts as activity so the scheduler degrades to
+    // change detection alone
+    const qint64 idle = idleSource ? idleSource() : -1;
+    const bool busy = idle < 0 || idle < sinceProbe;
+    activity = activity * 0.75 + (busy ? 0.25 : 0.0);
+
+    while (!recentShots.isEmpty() && now - recentShots.head() >= HourMsecs)
+        recentShots.dequeue();
+
+    const qint64 sinceShot = now - lastShotAt;
+    if (sinceShot < currentPolicy.minIntervalMsecs || recentShots.size() >= currentPolicy.maxPerHour) {
+        scheduleProbe();
+        return;
+    }
+
+    // Without input the screen rarely changes; don't pay for a grab on
+    // every probe
+    const bool overdue = sinceShot >= currentPolicy.maxIntervalMsecs;
+    if (!busy && !overdue && sinceShot < currentPolicy.averageIntervalMsecs) {
+        scheduleProbe();
+        return;
+    }
+
+    // Strips, not the screens: a busy user can mean a probe every second
+    const QList<CapturedScreen> probes = probeGrabber();
+    if (probes.isEmpty()) {
+        scheduleProbe();
+        return;
+    }
+
+    // The most changed screen decides; a new monitor layout is a full change
+    QVector<quint64> hashes;
+    int distance = probes.size() == lastHashes.size() ? 0 : 64;
+    for (const CapturedScreen &probe : probes) {
+        hashes.append(differenceHash(probe.image));
+        if (hashes.size() <= lastHashes.size())
+            distance = qMax(distance, qPopulationCount(hashes.last() ^ lastHashes[hashes.size() - 1]));
+    }
+
+    if (overdue) {
+        take(hashes, now);
+    } else if (distance >= ChangeThreshold) {
+        // Big changes under active use shorten the wait down to a quarter
+        // of the average; the token bucket pays for it later
+        const double change = qMin(1.0, double(distance) / FullChangeDistance);
+        const double urgency = 0.6 * change + 0.4 * activity;
+        const qint64 target = qBound(currentPolicy.minIntervalMsecs,
+                                     qint64(currentPolicy.averageIntervalMsecs * (1.0 - 0.75 * urgency)),
+                                     currentPolicy.maxIntervalMsecs);
+        if (sinceShot >= target && credits >= 1.0)
+            take(hashes, now);
+    }
+
+    scheduleProbe();
+}
+
+void ScreenshotScheduler::take(const QVector<quint64> &hashes, qint64 now)
+{
+    // The only full grab
+    const QList<CapturedScreen> screens = grabber();
+    if (screens.isEmpty())
+        return;
+
+    lastShotAt = now;
+    lastHashes = hashes;
+    credits = qMax(-MaxCredits, credits - 1.0);
+    recentShots.enqueue(now);
+    emit screenshotDue(screens);
+}
+
+quint64 ScreenshotScheduler::differenceHash(const QImage &frame)
+{
+    constexpr int Columns = 9;
+    constexpr int Rows = 8;
+    constexpr int Samples = 4; // per cell and axis
+    static_assert(Rows * Samples == ProbeRows, "probe strips must be the rows sampled here");
+
+    QImage image = frame;
+    if (image.format() != QImage::Format_RGB32 && image.format() != QImage::Format_ARGB32
+            && image.format() != QImage::Format_ARGB32_Premultiplied)
+        image = image.convertToFormat(QImage::Format_RGB32);
+    if (image.width() < Columns || image.height() < Rows)
+        return 0;
+
+    // Sparse box average per cell; reading a few hundred pixels is enough
+    // to tell a screen switch from a static desktop
+    int luma[Rows][Columns];
+    for (int row = 0; row < Rows; ++row) {
+        for (int column = 0; column < Columns; ++column) {
+            int sum = 0;
+            for (int sy = 0; sy < Samples; ++sy) {
+                const int y = ((row * Samples + sy) * 2 + 1) * image.height() / (2 * Rows * Samples);
+                const QRgb *line = reinterpret_cast<const QRgb *>(image.constScanLine(y));
+                for (int sx = 0; sx < Samples; ++sx) {
+                    const int x = ((column * Samples + sx) * 2 + 1) * image.width() / (2 * Columns * Samples);
+                    const QRgb pixel = line[x];
+                    sum += (qRed(pixel) * 77 + qGreen(pixel) * 150 + qBlue(pixel) * 29) >> 8;
+                }
+            }
+            luma[row][column] = sum;
+        }
+    }
+
+    quint64 hash = 0;
+    for (int row = 0; row < Rows; ++row) {
+        for (int column = 0; column < Columns - 1; ++column)
+            hash = (hash << 1) | (luma[row][column] < luma[row][column + 1] ? 1 : 0);
+    }
+    return hash;
+}
@@ -0,0 +1,86 @@
+#ifndef SCREENSHOTSCHEDULER_H
+#define SCREENSHOTSCHEDULER_H
+
+#include <QObject>
+#include <QImage>
+#include <QQueue>
+#include <QVector>
+#include <functional>
+#include "ScreenCapture.h"
+
+class QTimer;
+class QJsonObject;
+
+struct ScreenshotPolicy
+{
+    qint64 averageIntervalMsecs = 30000;
+    qint64 minIntervalMsecs = 10000;
+    qint64 maxIntervalMsecs = 120000;
+    int maxPerHour = 240;
+
+    // Server limits override the matching fields of base; the average rate
+    // is a local preference and is kept
+    static ScreenshotPolicy fromJson(const QJsonObject &json, const ScreenshotPolicy &base);
+};
+
+// Decides when to take a screenshot instead of firing at a fixed cadence.
+// Cheap probes combine input activity with a perceptual hash of the screen,
+// taken from a few pixel rows rather than a full grab:
+// changing screens under active use are sampled faster, unchanged screens
+// are skipped, and a token bucket keeps the long-run rate at the configured
+// average. The policy's min/max interval and hourly budget are hard limits.
+class ScreenshotScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ScreenshotScheduler(QObject *parent = nullptr);
+
+    void setPolicy(const ScreenshotPolicy &policy);
+    ScreenshotPolicy policy() const { return currentPolicy; }
+
+    // Milliseconds since the last user input, -1 if unknown
+    void setIdleSource(std::function<qint64()> source) { idleSource = std::move(source); }
+    // Full grab for the shot itself, only called when one is taken.
+    // Defaults to grabbing every screen; replaceable for tests
+    void setGrabber(std::function<QList<CapturedScreen>()> grab) { grabber = std::move(grab); }
+    // Cheap grab the probes hash, e.g. ScreenCapture::grabStrips() with
+    // ProbeRows; defaults to strips of every screen
+    void setProbeGrabber(std::function<QList<CapturedScreen>()> grab) { probeGrabber = std::move(grab); }
+    // Monotonic milliseconds; defaults to the steady clock
+    void setClock(std::function<qint64()> source) { clock = std::move(source); }
+
+    void start();
+    void stop();
+    bool isActive() const { return active; }
+
+    // 64-bit difference hash of a 9x8 luma thumbnail; visually similar
+    // frames differ in few bits
+    static quint64 differenceHash(const QImage &frame);
+    // Rows differenceHash() reads: an image of just these band centres
+    // hashes like the full frame
+    static constexpr int ProbeRows = 32;
+
+signals:
+    void screenshotDue(const QList<CapturedScreen> &screens);
+
+private:
+    void probe();
+    void scheduleProbe();
+    void take(const QVector<quint64> &hashes, qint64 now);
+
+    ScreenshotPolicy currentPolicy;
+    std::function<qint64()> idleSource;
+    std::function<QList<CapturedScreen>()> grabber;
+    std::function<QList<CapturedScreen>()> probeGrabber;
+    std::function<qint64()> clock;
+    QTimer *probeTimer;
+    QQueue<qint64> recentShots; // within the last hour
+    qint64 lastShotAt;
+    qint64 lastProbeAt;
+    QVector<quint64> lastHashes; // one per screen of the last shot
+    double activity; // decaying fraction of probes that saw input
+    double credits;
+    bool active;
+};
+
+#endif // SCREENSHOTSCHEDULER_H
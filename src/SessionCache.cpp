@@ -0,0 +1,136 @@
+#include "SessionCache.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDebug>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <dpapi.h>
+#endif
+
+namespace {
+
+constexpr quint32 CacheMagic = 0x544b5331; // "TKS1"
+// Tokens are checked this long before they actually run out, so a request
+// made right after startup doesn't race the expiry
+constexpr qint64 ExpirySkewMsecs = 60 * 1000;
+
+#ifdef Q_OS_WIN
+QByteArray protect(const QByteArray &data)
+{
+    DATA_BLOB in { DWORD(data.size()), reinterpret_cast<BYTE *>(const_cast<char *>(data.constData())) };
+    DATA_BLOB out {};
+    if (!CryptProtectData(&in, L"TimeTrackerApp session", nullptr, nullptr, nullptr, CRYPTPROTECT_UI_FORBIDDEN, &out))
+        return QByteArray();
+    const QByteArray result(reinterpret_cast<const char *>(out.pbData), int(out.cbData));
+    LocalFree(out.pbData);
+    return result;
+}
+
+QByteArray unprotect(const QByteArray &data)
+{
+    DATA_BLOB in { DWORD(data.size()), reinterpret_cast<BYTE *>(const_cast<char *>(data.constData())) };
+    DATA_BLOB out {};
+    if (!CryptUnprotectData(&in, nullptr, nullptr, nullptr, nullptr, CRYPTPROTECT_UI_FORBIDDEN, &out))
+        return QByteArray();
+    const QByteArray result(reinterpret_cast<const char *>(out.pbData), int(out.cbData));
+    SecureZeroMemory(out.pbData, out.cbData);
+    LocalFree(out.pbData);
+    return result;
+}
+#else
+// Owner-only file permissions are the protection elsewhere
+QByteArray protect(const QByteArray &data) { return data; }
+QByteArray unprotect(const QByteArray &data) { return data; }
+#endif
+
+}
+
+SessionCache::SessionCache(const QString &directory)
+    : path(QDir(directory).filePath("session.dat"))
+{
+}
+
+bool SessionCache::load(CachedSession *session) const
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    QByteArray sealed;
+    in >> magic >> sealed;
+    if (magic != CacheMagic || in.status() != QDataStream::Ok)
+        return false;
+
+    const QByteArray data = unprotect(sealed);
+    QDataStream fields(data);
+    fields.setVersion(QDataStream::Qt_6_0);
+    CachedSession cached;
+    qint32 userId = -1;
+    QByteArray policy;
+    fields >> cached.token >> userId >> cached.userName >> policy >> cached.expiresAt >> cached.savedAt;
+    if (fields.status() != QDataStream::Ok)
+        return false;
+    cached.userId = userId;
+    cached.screenshotPolicy = QJsonDocument::fromJson(policy).object();
+
+    if (!cached.isValid(QDateTime::currentMSecsSinceEpoch() + ExpirySkewMsecs)) {
+        clear();
+        return false;
+    }
+    *session = cached;
+    return true;
+}
+
+bool SessionCache::save(const CachedSession &session) const
+{
+    QByteArray data;
+    QDataStream fields(&data, QIODevice::WriteOnly);
+    fields.setVersion(QDataStream::Qt_6_0);
+    fields << session.token << qint32(session.userId) << session.userName
+           << QJsonDocument(session.screenshotPolicy).toJson(QJsonDocument::Compact)
+           << session.expiresAt << session.savedAt;
+
+    const QByteArray sealed = protect(data);
+    if (sealed.isEmpty())
+        return false;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    // Restrict before the token is written, not after the rename
+    file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CacheMagic << sealed;
+    if (!file.commit()) {
+        qWarning() << "Could not write session cache" << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void SessionCache::clear() const
+{
+    QFile::remove(path);
+}
+
+qint64 SessionCache::tokenExpiry(const QString &token)
+{
+    const QStringList parts = token.split(QLatin1Char('.'));
+    if (parts.size() != 3)
+        return 0;
+    const QByteArray payload = QByteArray::fromBase64(parts.at(1).toLatin1(),
+                                                      QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
+    const qint64 exp = QJsonDocument::fromJson(payload).object().value("exp").toInteger();
+    return exp > 0 ? exp * 1000 : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef SESSIONCACHE_H
+#define SESSIONCACHE_H
+
+#include <QJsonObject>
+#include <QString>
+
+struct CachedSession
+{
+    QString token;
+    int userId = -1;
+    QString userName;
+    QJsonObject screenshotPolicy;
+    qint64 expiresAt = 0; // wall clock, msecs since epoch
+    qint64 savedAt = 0;
+
+    bool isValid(qint64 nowMsecs) const { return !token.isEmpty() && userId >= 0 && nowMsecs < expiresAt; }
+};
+
+// Last successful login, kept so the app can open straight into the main
+// UI and revalidate the session in the background instead of waiting on
+// /api/v1/login. The file is readable by the owner only and, on Windows,
+// additionally encrypted for the user account with DPAPI. A session past
+// its expiry is never handed out; the expiry is the token's own (JWT exp)
+// when it has one, capped by a maximum age.
+class SessionCache
+{
+public:
+    explicit SessionCache(const QString &directory);
+
+    // False when there is no cached session or it has expired
+    bool load(CachedSession *session) const;
+    bool save(const CachedSession &session) const;
+    void clear() const;
+
+    // Expiry claim of a JWT in msecs since epoch, 0 if the token isn't one
+    static qint64 tokenExpiry(const QString &token);
+
+private:
+    QString path;
+};
+
+#endif // SESSIONCACHE_H
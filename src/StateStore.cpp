@@ -0,0 +1,189 @@
+#include "StateStore.h"
+#include "PerfMonitor.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QtEndian>
+#include <QDebug>
+#include <array>
+#include <cstring>
+
+namespace {
+
+// A full record is a few hundred bytes and a checkpoint 25, so this holds
+// days of checkpoints before a rewrite
+constexpr qint64 CompactThreshold = 64 * 1024;
+constexpr quint32 MaxPayloadSize = 64 * 1024;
+// Records: [u32 payload length][u8 op][payload][u32 crc32 of op + payload]
+constexpr int HeaderSize = 5;
+constexpr int TrailerSize = 4;
+
+quint32 crc32(const char *data, qsizetype size, quint32 crc = 0)
+{
+    static const auto table = [] {
+        std::array<quint32, 256> entries{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            entries[i] = value;
+        }
+        return entries;
+    }();
+
+    crc = ~crc;
+    for (qsizetype i = 0; i < size; ++i)
+        crc = table[(crc ^ quint8(data[i])) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+QByteArray record(quint8 op, const QByteArray &payload)
+{
+    QByteArray bytes(HeaderSize + payload.size() + TrailerSize, Qt::Uninitialized);
+    qToLittleEndian<quint32>(quint32(payload.size()), bytes.data());
+    bytes[4] = char(op);
+    memcpy(bytes.data() + HeaderSize, payload.constData(), payload.size());
+    const quint32 crc = crc32(bytes.constData() + 4, 1 + payload.size());
+    qToLittleEndian<quint32>(crc, bytes.data() + HeaderSize + payload.size());
+    return bytes;
+}
+
+}
+
+StateStore::StateStore(const QString &directory)
+    : stored(false)
+{
+    QDir().mkpath(directory);
+    log.setFileName(QDir(directory).filePath("timer-state.log"));
+    replay();
+}
+
+StateStore::~StateStore()
+{
+    log.flush();
+}
+
+void StateStore::save(const TimerState &state)
+{
+    current = state;
+    current.savedAt = QDateTime::currentMSecsSinceEpoch();
+    stored = true;
+    if (log.size() >= CompactThreshold)
+        compact();
+    else
+        append(Full, serialize(current));
+}
+
+void StateStore::checkpoint(qint64 elapsedMsecs)
+{
+    PerfScope scope(PerfMonitor::StateCheckpoint);
+    current.elapsedMsecs = elapsedMsecs;
+    current.savedAt = QDateTime::currentMSecsSinceEpoch();
+
+    QByteArray payload(16, Qt::Uninitialized);
+    qToLittleEndian<qint64>(current.elapsedMsecs, payload.data());
+    qToLittleEndian<qint64>(current.savedAt, payload.data() + 8);
+    // Checkpoints only make sense on top of a full record
+    if (!stored || log.size() >= CompactThreshold) {
+        stored = true;
+        compact();
+    } else {
+        append(Checkpoint, payload);
+    }
+}
+
+void StateStore::replay()
+{
+    if (!log.open(QIODevice::ReadWrite)) {
+        qWarning() << "Could not open timer state log" << log.errorString();
+        return;
+    }
+
+    qint64 validEnd = 0;
+    const QByteArray data = log.readAll();
+    while (validEnd + HeaderSize + TrailerSize <= data.size()) {
+        const char *at = data.constData() + validEnd;
+        const quint32 length = qFromLittleEndian<quint32>(at);
+        if (length > MaxPayloadSize || validEnd + HeaderSize + length + TrailerSize > data.size())
+            break;
+        const quint32 crc = qFromLittleEndian<quint32>(at + HeaderSize + length);
+        if (crc != crc32(at + 4, 1 + length))
+            break;
+
+        const QByteArray payload = QByteArray::fromRawData(at + HeaderSize, length);
+        const quint8 op = quint8(at[4]);
+        if (op == Full) {
+            TimerState state;
+            if (!deserialize(payload, state))
+                break;
+            current = state;
+            stored = true;
+        } else if (op == Checkpoint && length == 16) {
+            current.elapsedMsecs = qFromLittleEndian<qint64>(at + HeaderSize);
+            current.savedAt = qFromLittleEndian<qint64>(at + HeaderSize + 8);
+        } else {
+            break;
+        }
+        validEnd += HeaderSize + length + TrailerSize;
+    }
+
+    // Everything after the first bad record is a torn write from a crash
+    if (validEnd < data.size()) {
+        qWarning() << "Timer state log damaged after" << validEnd << "bytes, truncating";
+        log.resize(validEnd);
+    }
+    if (log.size() >= CompactThreshold)
+        compact();
+}
+
+void StateStore::append(Op op, const QByteArray &payload)
+{
+    if (!log.isOpen())
+        return;
+
+    // One write per record; flushing hands it to the OS, which keeps it
+    // when the process dies
+    log.seek(log.size());
+    log.write(record(op, payload));
+    log.flush();
+}
+
+void StateStore::compact()
+{
+    // The rewrite holds a single full record and replaces the log
+    // atomically, so a crash leaves either the old or the new file
+    QSaveFile out(log.fileName());
+    if (!out.open(QIODevice::WriteOnly)) {
+        append(Full, serialize(current));
+        return;
+    }
+    out.write(record(Full, serialize(current)));
+
+    log.close();
+    if (!out.commit())
+        qWarning() << "Timer state log compaction failed" << out.errorString();
+    if (!log.open(QIODevice::ReadWrite))
+        qWarning() << "Could not reopen timer state log" << log.errorString();
+}
+
+QByteArray StateStore::serialize(const TimerState &state)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << state.elapsedMsecs << state.running << state.paused << qint32(state.selectedTaskId)
+        << state.currentSessionId << state.clientSessionId << state.savedAt;
+    return data;
+}
+
+bool StateStore::deserialize(const QByteArray &data, TimerState &state)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    qint32 taskId = -1;
+    in >> state.elapsedMsecs >> state.running >> state.paused >> taskId
+       >> state.currentSessionId >> state.clientSessionId >> state.savedAt;
+    state.selectedTaskId = taskId;
+    return in.status() == QDataStream::Ok;
+}
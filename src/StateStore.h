@@ -0,0 +1,51 @@
+#ifndef STATESTORE_H
+#define STATESTORE_H
+
+#include <QFile>
+#include <QString>
+
+struct TimerState
+{
+    qint64 elapsedMsecs = 0;
+    bool running = false;
+    bool paused = false;
+    int selectedTaskId = -1;
+    QString currentSessionId;
+    QString clientSessionId;
+    qint64 savedAt = 0; // wall clock, msecs since epoch
+};
+
+// Crash-safe local store for the timer and session state. Changes are
+// appended to a small log of CRC-checked records: a full record whenever
+// the session changes and a fixed-size checkpoint of the elapsed time in
+// between, cheap enough to write every few seconds. Replay keeps the last
+// intact state, so a crash or a torn write at the tail loses at most one
+// checkpoint interval. The log is rewritten atomically once it grows.
+class StateStore
+{
+public:
+    explicit StateStore(const QString &directory);
+    ~StateStore();
+
+    bool hasState() const { return stored; }
+    TimerState state() const { return current; }
+
+    void save(const TimerState &state);
+    void checkpoint(qint64 elapsedMsecs);
+
+private:
+    enum Op : quint8 { Full = 1, Checkpoint = 2 };
+
+    void replay();
+    void append(Op op, const QByteArray &payload);
+    void compact();
+
+    static QByteArray serialize(const TimerState &state);
+    static bool deserialize(const QByteArray &data, TimerState &state);
+
+    QFile log;
+    TimerState current;
+    bool stored;
+};
+
+#endif // STATESTORE_H
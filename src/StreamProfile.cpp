@@ -0,0 +1,153 @@
+#include "StreamProfile.h"
+
+namespace {
+
+// A line longer than this isn't progress output; drop it rather than grow
+constexpr int MaxLineLength = 1024;
+
+}
+
+StreamProfile StreamProfile::named(const QString &name)
+{
+    StreamProfile profile;
+    if (name == "low-bandwidth") {
+        profile.name = name;
+        profile.maxSize = QSize(1280, 720);
+        profile.fps = 10;
+        profile.crf = 30;
+        profile.maxBitrateKbps = 800;
+        profile.threads = 2;
+        profile.preset = "ultrafast";
+    } else if (name == "high-quality") {
+        profile.name = name;
+        profile.maxSize = QSize(2560, 1440);
+        profile.fps = 30;
+        profile.crf = 22;
+        profile.maxBitrateKbps = 6000;
+        profile.threads = 0;
+        profile.preset = "veryfast";
+    } else {
+        profile.name = "balanced";
+        profile.maxSize = QSize(1920, 1080);
+        profile.fps = 15;
+        profile.crf = 26;
+        profile.maxBitrateKbps = 2500;
+        profile.threads = 4;
+        profile.preset = "superfast";
+    }
+    return profile;
+}
+
+QStringList StreamProfile::names()
+{
+    return { "low-bandwidth", "balanced", "high-quality" };
+}
+
+StreamProfile StreamProfile::downgraded(const StreamProfile &profile)
+{
+    const int index = names().indexOf(profile.name);
+    if (index <= 0)
+        return StreamProfile();
+    return named(names().at(index - 1));
+}
+
+QSize StreamProfile::outputSize(const QSize &input) const
+{
+    QSize output = input;
+    if (maxSize.isValid() && (input.width() > maxSize.width() || input.height() > maxSize.height()))
+        output = input.scaled(maxSize, Qt::KeepAspectRatio);
+    // yuv420p needs even dimensions
+    return QSize(qMax(2, output.width() & ~1), qMax(2, output.height() & ~1));
+}
+
+QStringList StreamProfile::ffmpegArguments(const QSize &input, const QString &url) const
+{
+    const QSize output = outputSize(input);
+    const int gop = qMax(1, fps * gopSecs);
+
+    return {
+        "-hide_banner",
+        "-loglevel", "warning", // stderr only carries problems
+        "-nostats",
+        "-progress", "pipe:1",
+        "-f", "rawvideo",
+        "-pix_fmt", "bgr0", // QImage::Format_RGB32 byte order
+        "-video_size", QString("%1x%2").arg(input.width()).arg(input.height()),
+        "-framerate", QString::number(fps),
+        "-i", "pipe:0",
+        "-vf", QString("scale=%1:%2:flags=fast_bilinear").arg(output.width()).arg(output.height()),
+        "-c:v", "libx264",
+        "-preset", preset,
+        "-tune", "zerolatency",
+        "-crf", QString::number(crf),
+        // Capped CRF: quality-driven, but never above the uplink budget
+        "-maxrate", QString("%1k").arg(maxBitrateKbps),
+        "-bufsize", QString("%1k").arg(maxBitrateKbps * 2),
+        // Fixed GOP so viewers can join within gopSecs
+        "-g", QString::number(gop),
+        "-keyint_min", QString::number(gop),
+        "-sc_threshold", "0",
+        "-threads", QString::number(threads),
+        "-pix_fmt", "yuv420p",
+        "-f", "flv",
+        url
+    };
+}
+
+bool StreamProgress::feed(const QByteArray &data, qint64 nowMsecs)
+{
+    bool completed = false;
+    qsizetype start = 0;
+    while (start < data.size()) {
+        const qsizetype newline = data.indexOf('\n', start);
+        if (newline < 0) {
+            pendingLine += data.mid(start);
+            if (pendingLine.size() > MaxLineLength)
+                pendingLine.clear();
+            break;
+        }
+        pendingLine += data.mid(start, newline - start);
+        start = newline + 1;
+
+        const QByteArray line = pendingLine.trimmed();
+        pendingLine.clear();
+        const qsizetype equals = line.indexOf('=');
+        if (equals <= 0)
+            continue;
+        const QByteArray key = line.left(equals);
+        const QByteArray value = line.mid(equals + 1).trimmed();
+
+        if (key == "speed") {
+            // "1.02x", or "N/A" before the first frame
+            current.speed = value.endsWith('x') ? value.chopped(1).toDouble() : 0;
+        } else if (key == "fps") {
+            current.fps = value.toDouble();
+        } else if (key == "bitrate") {
+            // "2489.3kbits/s"
+            current.bitrateKbps = qint64(value.left(value.indexOf("kbits")).toDouble());
+        } else if (key == "out_time_us") {
+            current.outTimeUs = value.toLongLong();
+        } else if (key == "drop_frames") {
+            current.droppedFrames = value.toLongLong();
+        } else if (key == "progress") {
+            current.finished = value == "end";
+            // Windows start at the first encoded frame, so startup doesn't
+            // count as falling behind
+            if (current.outTimeUs > 0) {
+                if (windowStartMsecs < 0) {
+                    windowStartMsecs = nowMsecs;
+                    windowStartOutUs = current.outTimeUs;
+                } else if (nowMsecs - windowStartMsecs >= WindowMsecs) {
+                    current.windowSpeed = double(current.outTimeUs - windowStartOutUs) / 1000.0
+                                          / double(nowMsecs - windowStartMsecs);
+                    windowStartMsecs = nowMsecs;
+                    windowStartOutUs = current.outTimeUs;
+                }
+            }
+            last = current;
+            current = Report();
+            completed = true;
+        }
+    }
+    return completed;
+}
@@ -0,0 +1,70 @@
+#ifndef STREAMPROFILE_H
+#define STREAMPROFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QSize>
+#include <QByteArray>
+
+// Encoder settings for the live screen share. Everything ffmpeg needs is
+// derived from the profile, so switching profiles is a restart with new
+// arguments.
+struct StreamProfile
+{
+    QString name;
+    QSize maxSize;          // output bound, the capture is scaled down to fit
+    int fps = 15;
+    int crf = 26;
+    int maxBitrateKbps = 2500;
+    int gopSecs = 2;
+    int threads = 0;        // 0 lets x264 decide
+    QString preset = "veryfast";
+
+    bool isValid() const { return !name.isEmpty(); }
+
+    // "low-bandwidth", "balanced" or "high-quality"; anything else is balanced
+    static StreamProfile named(const QString &name);
+    static QStringList names();
+    // Next cheaper profile, or an invalid one at the bottom
+    static StreamProfile downgraded(const StreamProfile &profile);
+
+    // Even-sized output for an input of the given size
+    QSize outputSize(const QSize &input) const;
+    // Raw BGRx frames on stdin, progress reports on stdout
+    QStringList ffmpegArguments(const QSize &input, const QString &url) const;
+};
+
+// Incremental parser for ffmpeg's -progress output: key=value lines,
+// each report closed by progress=continue or progress=end. ffmpeg's own
+// speed figure is a whole-run average, so the parser also measures speed
+// over fixed windows from the encoded timestamps.
+class StreamProgress
+{
+public:
+    struct Report
+    {
+        double speed = 0;       // ffmpeg's run average, media s per wall s
+        double windowSpeed = 0; // set only on reports that close a window
+        double fps = 0;
+        qint64 bitrateKbps = 0;
+        qint64 outTimeUs = 0;
+        qint64 droppedFrames = 0;
+        bool finished = false;
+    };
+
+    static constexpr qint64 WindowMsecs = 5000;
+
+    // nowMsecs is any monotonic clock. Returns true when data completed at
+    // least one report.
+    bool feed(const QByteArray &data, qint64 nowMsecs);
+    Report lastReport() const { return last; }
+
+private:
+    QByteArray pendingLine;
+    Report current;
+    Report last;
+    qint64 windowStartMsecs = -1;
+    qint64 windowStartOutUs = 0;
+};
+
+#endif // STREAMPROFILE_H
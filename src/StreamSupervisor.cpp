@@ -0,0 +1,225 @@
+#include "StreamSupervisor.h"
+#include <QTimer>
+#include <QDebug>
+
+namespace {
+
+// ffmpeg's log lines are short; anything longer is cut rather than buffered
+constexpr int MaxLineLength = 1024;
+
+}
+
+StreamSupervisor::StreamSupervisor(QObject *parent)
+    : QObject(parent),
+      process(new QProcess(this)),
+      escalationTimer(new QTimer(this)),
+      backoffTimer(new QTimer(this)),
+      currentState(Stopped),
+      escalationStage(0),
+      attempts(0),
+      restartPending(false)
+{
+    escalationTimer->setSingleShot(true);
+    backoffTimer->setSingleShot(true);
+    connect(escalationTimer, &QTimer::timeout, this, &StreamSupervisor::escalate);
+    connect(backoffTimer, &QTimer::timeout, this, &StreamSupervisor::launch);
+
+    connect(process, &QProcess::started, this, &StreamSupervisor::handleStarted);
+    connect(process, &QProcess::finished, this, &StreamSupervisor::handleFinished);
+    connect(process, &QProcess::errorOccurred, this, &StreamSupervisor::handleError);
+    connect(process, &QProcess::readyReadStandardOutput, this, &StreamSupervisor::readProgress);
+    connect(process, &QProcess::readyReadStandardError, this, &StreamSupervisor::readErrors);
+}
+
+StreamSupervisor::~StreamSupervisor()
+{
+    // No time left for a graceful stop. SIGKILL is immediate, so the wait in
+    // ~QProcess only reaps the child.
+    disconnect(process, nullptr, this, nullptr);
+    if (process->state() != QProcess::NotRunning)
+        process->kill();
+}
+
+void StreamSupervisor::start(const QString &newProgram, const QStringList &newArguments)
+{
+    program = newProgram;
+    arguments = newArguments;
+    attempts = 0;
+    if (currentState == Stopped || currentState == Waiting) {
+        backoffTimer->stop();
+        launch();
+    } else {
+        restart(newArguments);
+    }
+}
+
+void StreamSupervisor::stop()
+{
+    restartPending = false;
+    backoffTimer->stop();
+
+    switch (currentState) {
+    case Stopped:
+    case Stopping:
+        return;
+    case Waiting:
+        setState(Stopped);
+        return;
+    case Starting:
+        // Nothing encoded yet, so there's nothing to flush
+        setState(Stopping);
+        process->kill();
+        return;
+    case Running:
+        // The raw frames arrive on stdin, which disables ffmpeg's interactive
+        // 'q'; EOF is the equivalent and lets it flush and close the stream
+        setState(Stopping);
+        process->closeWriteChannel();
+        escalationStage = 0;
+        escalationTimer->start(StopGraceMsecs);
+        return;
+    }
+}
+
+void StreamSupervisor::restart(const QStringList &newArguments)
+{
+    arguments = newArguments;
+    attempts = 0;
+    if (currentState == Stopped || currentState == Waiting) {
+        backoffTimer->stop();
+        launch();
+        return;
+    }
+    stop();
+    restartPending = true;
+}
+
+bool StreamSupervisor::write(const char *data, qint64 size)
+{
+    if (currentState != Running)
+        return false;
+    return process->write(data, size) == size;
+}
+
+void StreamSupervisor::launch()
+{
+    restartPending = false;
+    progressParser = StreamProgress();
+    pendingError.clear();
+    setState(Starting);
+    process->start(program, arguments);
+}
+
+void StreamSupervisor::setState(State state)
+{
+    if (state == currentState)
+        return;
+    currentState = state;
+    emit stateChanged(state);
+}
+
+void StreamSupervisor::escalate()
+{
+    if (process->state() == QProcess::NotRunning)
+        return;
+    if (escalationStage++ == 0) {
+        qWarning() << "ffmpeg did not exit after EOF, terminating";
+        process->terminate();
+        escalationTimer->start(TerminateMsecs);
+    } else {
+        qWarning() << "ffmpeg ignored SIGTERM, killing";
+        process->kill();
+    }
+}
+
+void StreamSupervisor::handleStarted()
+{
+    runClock.start();
+    if (currentState == Starting)
+        setState(Running);
+}
+
+void StreamSupervisor::handleFinished(int exitCode, QProcess::ExitStatus exitStatus)
+{
+    escalationTimer->stop();
+    readErrors();
+
+    if (currentState == Stopping) {
+        if (restartPending)
+            launch();
+        else
+            setState(Stopped);
+        return;
+    }
+
+    QString reason = exitStatus == QProcess::CrashExit ? QString("ffmpeg crashed")
+                                                       : QString("ffmpeg exited with code %1").arg(exitCode);
+    if (!errorLines.isEmpty())
+        reason += ": " + errorLines.last();
+    handleExit(reason);
+}
+
+void StreamSupervisor::handleError(QProcess::ProcessError error)
+{
+    // Every other error is followed by finished()
+    if (error != QProcess::FailedToStart)
+        return;
+    if (currentState == Stopping) {
+        handleFinished(-1, QProcess::CrashExit);
+        return;
+    }
+    handleExit("ffmpeg failed to start: " + process->errorString());
+}
+
+void StreamSupervisor::handleExit(const QString &reason)
+{
+    qWarning() << reason;
+
+    // A run that held up for a while starts the backoff over
+    if (runClock.isValid() && runClock.elapsed() >= StableRunMsecs)
+        attempts = 0;
+    runClock.invalidate();
+
+    if (++attempts > MaxRestarts) {
+        setState(Stopped);
+        emit failed(reason);
+        return;
+    }
+
+    const qint64 delay = qMin(MaxBackoffMsecs, qint64(1000) << (attempts - 1));
+    setState(Waiting);
+    emit restarting(attempts, delay, reason);
+    backoffTimer->start(delay);
+}
+
+void StreamSupervisor::readProgress()
+{
+    // stdout carries -progress reports
+    if (progressParser.feed(process->readAllStandardOutput(), runClock.isValid() ? runClock.elapsed() : 0))
+        emit progress(progressParser.lastReport());
+}
+
+void StreamSupervisor::readErrors()
+{
+    const QByteArray data = process->readAllStandardError();
+    qsizetype start = 0;
+    while (start < data.size()) {
+        qsizetype end = start;
+        while (end < data.size() && data.at(end) != '\n' && data.at(end) != '\r')
+            ++end;
+        if (pendingError.size() < MaxLineLength)
+            pendingError += data.mid(start, qMin(end - start, qsizetype(MaxLineLength - pendingError.size())));
+        if (end == data.size())
+            break;
+        start = end + 1;
+
+        const QString line = QString::fromUtf8(pendingError).trimmed();
+        pendingError.clear();
+        if (line.isEmpty())
+            continue;
+        qWarning().noquote() << "ffmpeg:" << line;
+        errorLines.append(line);
+        if (errorLines.size() > ErrorLines)
+            errorLines.removeFirst();
+    }
+}
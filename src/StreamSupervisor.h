@@ -0,0 +1,89 @@
+#ifndef STREAMSUPERVISOR_H
+#define STREAMSUPERVISOR_H
+
+#include <QObject>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QStringList>
+#include "StreamProfile.h"
+
+class QTimer;
+
+// Owns the ffmpeg process of the live screen share. Everything is driven by
+// QProcess signals and timers, so nothing here blocks the GUI thread:
+// start() returns at once, stop() asks ffmpeg to finish and escalates on a
+// timer, and an encoder that exits on its own is restarted with capped
+// exponential backoff.
+class StreamSupervisor : public QObject
+{
+    Q_OBJECT
+public:
+    enum State {
+        Stopped,
+        Starting,
+        Running,
+        Stopping,
+        Waiting     // between a crash and the next restart
+    };
+
+    static constexpr qint64 StopGraceMsecs = 3000;  // EOF until SIGTERM
+    static constexpr qint64 TerminateMsecs = 2000;  // SIGTERM until SIGKILL
+    static constexpr qint64 MaxBackoffMsecs = 30000;
+    static constexpr qint64 StableRunMsecs = 60000; // resets the backoff
+    static constexpr int MaxRestarts = 6;
+    static constexpr int ErrorLines = 20;
+
+    explicit StreamSupervisor(QObject *parent = nullptr);
+    ~StreamSupervisor();
+
+    void start(const QString &program, const QStringList &arguments);
+    // Graceful: stateChanged(Stopped) follows once the process is gone
+    void stop();
+    // Stops the current encoder and starts the program again with new
+    // arguments as soon as it has exited
+    void restart(const QStringList &arguments);
+
+    State state() const { return currentState; }
+    bool isRunning() const { return currentState == Running; }
+
+    // Feeds ffmpeg's stdin; refused unless running
+    bool write(const char *data, qint64 size);
+    qint64 pendingBytes() const { return process->bytesToWrite(); }
+
+    // Last lines ffmpeg wrote to stderr, oldest first
+    QStringList recentErrors() const { return errorLines; }
+
+signals:
+    void stateChanged(StreamSupervisor::State state);
+    void progress(const StreamProgress::Report &report);
+    void restarting(int attempt, qint64 delayMsecs, const QString &reason);
+    // Gave up after MaxRestarts consecutive failures; the supervisor is stopped
+    void failed(const QString &reason);
+
+private:
+    void launch();
+    void setState(State state);
+    void escalate();
+    void handleStarted();
+    void handleFinished(int exitCode, QProcess::ExitStatus exitStatus);
+    void handleError(QProcess::ProcessError error);
+    void handleExit(const QString &reason);
+    void readProgress();
+    void readErrors();
+
+    QProcess *process;
+    QTimer *escalationTimer;
+    QTimer *backoffTimer;
+    QString program;
+    QStringList arguments;
+    StreamProgress progressParser;
+    QElapsedTimer runClock;
+    QByteArray pendingError;
+    QStringList errorLines;
+    State currentState;
+    int escalationStage;
+    int attempts;
+    bool restartPending;
+};
+
+#endif // STREAMSUPERVISOR_H
@@ -0,0 +1,352 @@
+#include "TaskCatalog.h"
+#include "ApiClient.h"
+#include <QDataStream>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QSaveFile>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+constexpr quint32 CacheMagic = 0x544b4331; // "TKC1"
+// A catalog that pages on forever is a server bug, not a big catalog
+constexpr int MaxFetchPages = 1000;
+
+enum GramKind : quint64 { WordStart1 = 1, WordStart2 = 2, Trigram = 3 };
+
+quint64 gramKey(GramKind kind, const QChar *chars)
+{
+    quint64 key = quint64(kind) << 48 | quint64(chars[0].unicode()) << 32;
+    if (kind >= WordStart2)
+        key |= quint64(chars[1].unicode()) << 16;
+    if (kind == Trigram)
+        key |= chars[2].unicode();
+    return key;
+}
+
+QVector<int> intersect(const QVector<int> &a, const QVector<int> &b)
+{
+    QVector<int> result;
+    result.reserve(qMin(a.size(), b.size()));
+    std::set_intersection(a.cbegin(), a.cend(), b.cbegin(), b.cend(), std::back_inserter(result));
+    return result;
+}
+
+}
+
+void TaskSearchIndex::build(const QVector<TaskInfo> &tasks)
+{
+    folded.resize(tasks.size());
+    postings.clear();
+
+    auto add = [this](quint64 key, int position) {
+        QVector<int> &list = postings[key];
+        // Positions arrive in order, so repeats within a name are adjacent
+        if (list.isEmpty() || list.constLast() != position)
+            list.append(position);
+    };
+
+    for (int i = 0; i < tasks.size(); ++i) {
+        folded[i] = tasks.at(i).name.toCaseFolded();
+        const QString &name = folded.at(i);
+        const QChar *chars = name.constData();
+        for (qsizetype p = 0; p < name.size(); ++p) {
+            if (p + 3 <= name.size())
+                add(gramKey(Trigram, chars + p), i);
+            if (chars[p].isLetterOrNumber() && (p == 0 || !chars[p - 1].isLetterOrNumber())) {
+                add(gramKey(WordStart1, chars + p), i);
+                if (p + 2 <= name.size())
+                    add(gramKey(WordStart2, chars + p), i);
+            }
+        }
+    }
+}
+
+QVector<int> TaskSearchIndex::search(const QString &query) const
+{
+    const QStringList terms = query.toCaseFolded().split(QLatin1Char(' '), Qt::SkipEmptyParts);
+    QVector<int> result;
+    for (qsizetype i = 0; i < terms.size(); ++i) {
+        const QVector<int> matches = candidates(terms.at(i));
+        result = i == 0 ? matches : intersect(result, matches);
+        if (result.isEmpty())
+            break;
+    }
+    return result;
+}
+
+QVector<int> TaskSearchIndex::candidates(const QString &term) const
+{
+    if (term.size() < 3)
+        return postings.value(gramKey(term.size() == 1 ? WordStart1 : WordStart2, term.constData()));
+
+    // Rarest trigrams first keeps the intermediate lists short
+    QVector<const QVector<int> *> lists;
+    for (qsizetype p = 0; p + 3 <= term.size(); ++p) {
+        const auto it = postings.constFind(gramKey(Trigram, term.constData() + p));
+        if (it == postings.cend())
+            return {};
+        lists.append(&it.value());
+    }
+    std::sort(lists.begin(), lists.end(), [](const QVector<int> *a, const QVector<int> *b) {
+        return a->size() < b->size();
+    });
+
+    QVector<int> found = *lists.constFirst();
+    for (qsizetype i = 1; i < lists.size() && !found.isEmpty(); ++i)
+        found = intersect(found, *lists.at(i));
+
+    // Trigrams only say the pieces occur, not that they are contiguous
+    if (term.size() > 3)
+        found.removeIf([this, &term](int position) { return !folded.at(position).contains(term); });
+    return found;
+}
+
+TaskCatalog::TaskCatalog(ApiClient *client, const QString &directory, QObject *parent)
+    : QAbstractListModel(parent),
+      apiClient(client),
+      cacheDirectory(directory),
+      userId(-1),
+      generation(0),
+      pinnedId(-1),
+      filtered(false),
+      loadedRows(0)
+{
+}
+
+void TaskCatalog::setTasks(const QVector<TaskInfo> &newTasks)
+{
+    // The cached ETag described another list
+    etag.clear();
+    replaceTasks(newTasks);
+    writeCache();
+}
+
+void TaskCatalog::load(int user)
+{
+    if (user != userId) {
+        userId = user;
+        etag.clear();
+        if (readCache())
+            emit loaded(tasks.size(), true);
+    }
+    ++generation;
+    incoming.clear();
+    fetchPage(0);
+}
+
+void TaskCatalog::clear()
+{
+    ++generation;
+    userId = -1;
+    etag.clear();
+    incoming.clear();
+    replaceTasks({});
+}
+
+void TaskCatalog::setFilter(const QString &text, int pinned)
+{
+    beginResetModel();
+    filterText = text;
+    pinnedId = pinned;
+    applyFilter();
+    endResetModel();
+}
+
+int TaskCatalog::rowOfId(int id)
+{
+    const int position = positions.value(id, -1);
+    if (position < 0)
+        return -1;
+    const int listed = filtered ? int(rows.indexOf(position)) : position;
+    if (listed < 0)
+        return -1;
+
+    if (listed >= loadedRows) {
+        beginInsertRows(QModelIndex(), loadedRows + 1, listed + 1);
+        loadedRows = listed + 1;
+        endInsertRows();
+    }
+    return listed + 1;
+}
+
+int TaskCatalog::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 1 + loadedRows;
+}
+
+QVariant TaskCatalog::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() > loadedRows)
+        return QVariant();
+
+    if (index.row() == 0) {
+        if (role == Qt::DisplayRole)
+            return QStringLiteral("Select Task");
+        return role == IdRole ? QVariant(-1) : QVariant();
+    }
+
+    const TaskInfo &task = tasks.at(positionOfRow(index.row()));
+    if (role == Qt::DisplayRole || role == Qt::ToolTipRole)
+        return task.name;
+    return role == IdRole ? QVariant(task.id) : QVariant();
+}
+
+bool TaskCatalog::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && loadedRows < listedCount();
+}
+
+void TaskCatalog::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid())
+        return;
+    const int count = qMin(ViewPageSize, listedCount() - loadedRows);
+    if (count <= 0)
+        return;
+    beginInsertRows(QModelIndex(), loadedRows + 1, loadedRows + count);
+    loadedRows += count;
+    endInsertRows();
+}
+
+void TaskCatalog::replaceTasks(const QVector<TaskInfo> &newTasks)
+{
+    beginResetModel();
+    tasks = newTasks;
+    positions.clear();
+    positions.reserve(tasks.size());
+    for (int i = 0; i < tasks.size(); ++i)
+        positions.insert(tasks.at(i).id, i);
+    index.build(tasks);
+    applyFilter();
+    endResetModel();
+}
+
+void TaskCatalog::applyFilter()
+{
+    filtered = !filterText.trimmed().isEmpty();
+    rows = filtered ? index.search(filterText) : QVector<int>();
+
+    const int pinned = positions.value(pinnedId, -1);
+    if (filtered && pinned >= 0 && !std::binary_search(rows.cbegin(), rows.cend(), pinned))
+        rows.prepend(pinned);
+
+    loadedRows = qMin(ViewPageSize, listedCount());
+}
+
+void TaskCatalog::fetchPage(int page)
+{
+    QNetworkRequest request = apiClient->request(QString("/api/v1/tasks?page=%1&pageSize=%2")
+                                                     .arg(page).arg(FetchPageSize));
+    if (page == 0 && !etag.isEmpty())
+        request.setRawHeader("If-None-Match", etag.toUtf8());
+
+    QNetworkReply *reply = apiClient->get(request);
+    connect(reply, &QNetworkReply::finished, this, [this, reply, page, load = generation]() {
+        handlePage(reply, page, load);
+    });
+}
+
+void TaskCatalog::handlePage(QNetworkReply *reply, int page, quint64 load)
+{
+    reply->deleteLater();
+    if (load != generation)
+        return;
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 304) {
+        emit loaded(tasks.size(), true);
+        return;
+    }
+    if (reply->error() != QNetworkReply::NoError) {
+        // Servers without the endpoint keep the login payload's tasks
+        if (status != 404)
+            qWarning() << "Task catalog refresh failed:" << reply->errorString();
+        incoming.clear();
+        return;
+    }
+
+    const QJsonObject json = QJsonDocument::fromJson(reply->readAll()).object();
+    if (page == 0) {
+        incoming.clear();
+        incomingEtag = QString::fromUtf8(reply->rawHeader("ETag"));
+    }
+    const QJsonArray taskArray = json["tasks"].toArray();
+    incoming.reserve(incoming.size() + taskArray.size());
+    for (const QJsonValue &value : taskArray) {
+        const QJsonObject taskObj = value.toObject();
+        incoming.append({ taskObj["id"].toInt(), taskObj["name"].toString() });
+    }
+
+    if (json["hasMore"].toBool() && !taskArray.isEmpty() && page + 1 < MaxFetchPages) {
+        // Nothing to show yet: the first page is better than an empty list
+        if (page == 0 && tasks.isEmpty())
+            replaceTasks(incoming);
+        fetchPage(page + 1);
+        return;
+    }
+
+    etag = incomingEtag;
+    replaceTasks(incoming);
+    incoming.clear();
+    writeCache();
+    emit loaded(tasks.size(), false);
+}
+
+QString TaskCatalog::cachePath() const
+{
+    return QDir(cacheDirectory).filePath(QString("tasks-%1.cache").arg(userId));
+}
+
+bool TaskCatalog::readCache()
+{
+    QFile file(cachePath());
+    if (userId < 0 || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    QString cachedEtag;
+    qint32 count = 0;
+    in >> magic >> cachedEtag >> count;
+    if (magic != CacheMagic || count < 0 || in.status() != QDataStream::Ok)
+        return false;
+
+    QVector<TaskInfo> cached;
+    cached.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        qint32 id = -1;
+        QString name;
+        in >> id >> name;
+        cached.append({ id, name });
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    etag = cachedEtag;
+    replaceTasks(cached);
+    return true;
+}
+
+void TaskCatalog::writeCache() const
+{
+    if (userId < 0)
+        return;
+    QDir().mkpath(cacheDirectory);
+    QSaveFile file(cachePath());
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << CacheMagic << etag << qint32(tasks.size());
+    for (const TaskInfo &task : tasks)
+        out << qint32(task.id) << task.name;
+    if (!file.commit())
+        qWarning() << "Could not write task cache" << file.errorString();
+}
@@ -0,0 +1,106 @@
+#ifndef TASKCATALOG_H
+#define TASKCATALOG_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class ApiClient;
+class QNetworkReply;
+
+struct TaskInfo
+{
+    int id = -1;
+    QString name;
+};
+
+// In-memory search over task names. Query terms of three or more
+// characters match anywhere in a name through a trigram index, shorter
+// terms match the start of a word; every term of the query must match.
+// Candidates come from intersecting posting lists, so a query touches a few
+// hundred names rather than the whole catalog.
+class TaskSearchIndex
+{
+public:
+    void build(const QVector<TaskInfo> &tasks);
+    // Positions in the catalog of matching tasks, in catalog order
+    QVector<int> search(const QString &query) const;
+
+private:
+    QVector<int> candidates(const QString &term) const;
+
+    QVector<QString> folded; // case-folded names
+    QHash<quint64, QVector<int>> postings;
+};
+
+// Task list behind the task picker. Views get rows in pages through
+// fetchMore(), so a catalog of tens of thousands of tasks doesn't create
+// them all up front. The catalog is cached per user and revalidated with
+// the ETag of /api/v1/tasks, which is read page by page when it changed.
+// Row 0 is always the "Select Task" placeholder with id -1.
+class TaskCatalog : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    enum Roles { IdRole = Qt::UserRole };
+
+    static constexpr int ViewPageSize = 500;
+    static constexpr int FetchPageSize = 1000;
+
+    TaskCatalog(ApiClient *client, const QString &cacheDirectory, QObject *parent = nullptr);
+
+    // Tasks that came with the login payload, shown and cached until the
+    // endpoint answers
+    void setTasks(const QVector<TaskInfo> &tasks);
+    // Shows the user's cached catalog and revalidates it
+    void load(int userId);
+    void clear();
+
+    // The pinned task stays listed even when it doesn't match
+    void setFilter(const QString &text, int pinnedId = -1);
+    QString filter() const { return filterText; }
+
+    int taskCount() const { return tasks.size(); }
+    // Row of the task, loading rows up to it; -1 if it isn't listed
+    int rowOfId(int id);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
+
+signals:
+    void loaded(int taskCount, bool fromCache);
+
+private:
+    void replaceTasks(const QVector<TaskInfo> &newTasks);
+    void applyFilter();
+    int listedCount() const { return filtered ? rows.size() : tasks.size(); }
+    int positionOfRow(int row) const { return filtered ? rows.at(row - 1) : row - 1; }
+
+    void fetchPage(int page);
+    void handlePage(QNetworkReply *reply, int page, quint64 load);
+    bool readCache();
+    void writeCache() const;
+    QString cachePath() const;
+
+    ApiClient *apiClient;
+    QString cacheDirectory;
+    int userId;
+    QVector<TaskInfo> tasks;
+    QHash<int, int> positions; // task id -> position in tasks
+    TaskSearchIndex index;
+    QString etag;
+    QVector<TaskInfo> incoming; // pages of a reload in progress
+    QString incomingEtag;
+    quint64 generation;         // replies of superseded loads are dropped
+
+    QString filterText;
+    int pinnedId;
+    bool filtered;
+    QVector<int> rows;          // positions listed while filtered
+    int loadedRows;             // rows handed to views, placeholder excluded
+};
+
+#endif // TASKCATALOG_H
@@ -0,0 +1,108 @@
+#include "TileDeltaEncoder.h"
+#include "FrameHash.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QBuffer>
+
+TileDeltaEncoder::TileDeltaEncoder(int tileSize, int keyframeInterval)
+    : tileSize(tileSize),
+      keyframeInterval(qMax(1, keyframeInterval)),
+      framesSinceKeyframe(0),
+      keyframeRequested(true),
+      sequence(0),
+      keyframeSequence(0)
+{
+}
+
+void TileDeltaEncoder::requestKeyframe()
+{
+    QMutexLocker locker(&mutex);
+    keyframeRequested = true;
+}
+
+void TileDeltaEncoder::setKeyframeInterval(int frames)
+{
+    QMutexLocker locker(&mutex);
+    keyframeInterval = qMax(1, frames);
+}
+
+QByteArray TileDeltaEncoder::encode(const QImage &input)
+{
+    const QImage frame = input.format() == QImage::Format_RGB32
+        ? input : input.convertToFormat(QImage::Format_RGB32);
+    const int width = frame.width();
+    const int height = frame.height();
+    const int columns = (width + tileSize - 1) / tileSize;
+    const int rows = (height + tileSize - 1) / tileSize;
+    const uchar *bits = frame.constBits();
+    const qsizetype stride = frame.bytesPerLine();
+
+    // Hashing is the only full-frame pass and needs no shared state
+    QVector<quint64> hashes(columns * rows);
+    for (int row = 0; row < rows; ++row) {
+        const int tileHeight = qMin(tileSize, height - row * tileSize);
+        for (int column = 0; column < columns; ++column) {
+            const int tileWidth = qMin(tileSize, width - column * tileSize);
+            const uchar *origin = bits + row * tileSize * stride + column * tileSize * 4;
+            hashes[row * columns + column] = FrameHash::hashRows(origin, tileWidth * 4, stride, tileHeight);
+        }
+    }
+
+    QCryptographicHash digest(QCryptographicHash::Sha1);
+    for (int y = 0; y < height; ++y)
+        digest.addData(QByteArrayView(reinterpret_cast<const char *>(bits + y * stride), width * 4));
+
+    QMutexLocker locker(&mutex);
+
+    const bool keyframe = keyframeRequested
+        || frame.size() != frameSize
+        || framesSinceKeyframe + 1 >= keyframeInterval;
+
+    QVector<int> changed;
+    for (int i = 0; i < hashes.size(); ++i) {
+        if (keyframe || hashes[i] != tileHashes[i])
+            changed.append(i);
+    }
+
+    ++sequence;
+    if (keyframe) {
+        keyframeSequence = sequence;
+        framesSinceKeyframe = 0;
+        keyframeRequested = false;
+    } else {
+        ++framesSinceKeyframe;
+    }
+    frameSize = frame.size();
+    tileHashes = hashes;
+    const quint32 frameSequence = sequence;
+    const quint32 baseSequence = keyframeSequence;
+    locker.unlock();
+
+    QByteArray payload;
+    QBuffer buffer(&payload);
+    buffer.open(QIODevice::WriteOnly);
+    QDataStream out(&buffer);
+    out.setByteOrder(QDataStream::LittleEndian);
+
+    out.writeRawData("TTDF", 4);
+    out << quint8(1) << quint8(keyframe ? 1 : 0) << quint16(tileSize);
+    out << quint32(width) << quint32(height) << frameSequence << baseSequence;
+    out << quint32(changed.size());
+    const QByteArray sha1 = digest.result();
+    out.writeRawData(sha1.constData(), sha1.size());
+
+    for (int index : changed) {
+        const int column = index % columns;
+        const int row = index / columns;
+        const int tileWidth = qMin(tileSize, width - column * tileSize);
+        const int tileHeight = qMin(tileSize, height - row * tileSize);
+        out << quint16(column) << quint16(row);
+
+        const uchar *origin = bits + row * tileSize * stride + column * tileSize * 4;
+        for (int y = 0; y < tileHeight; ++y)
+            out.writeRawData(reinterpret_cast<const char *>(origin + y * stride), tileWidth * 4);
+    }
+    buffer.close();
+
+    return qCompress(payload, 6);
+}
@@ -0,0 +1,44 @@
+#ifndef TILEDELTAENCODER_H
+#define TILEDELTAENCODER_H
+
+#include <QImage>
+#include <QMutex>
+#include <QVector>
+
+// Splits frames into fixed tiles and emits only the tiles that changed
+// since the previous frame, with a full keyframe every keyframeInterval
+// frames. Payload layout (little-endian, whole blob passed through
+// qCompress):
+//
+//   "TTDF" u8 version, u8 flags (1 = keyframe), u16 tileSize
+//   u32 width, u32 height, u32 sequence, u32 keyframeSequence
+//   u32 tileCount, 20-byte SHA-1 of the full reconstructed frame
+//   per tile: u16 column, u16 row, raw RGB32 rows clipped to the frame
+//
+// server/tile-reassembler.js is the reference decoder.
+class TileDeltaEncoder
+{
+public:
+    explicit TileDeltaEncoder(int tileSize = 64, int keyframeInterval = 20);
+
+    // Thread-safe; frames are chained in the order they take the lock
+    QByteArray encode(const QImage &frame);
+
+    // Forces the next frame to be a keyframe, e.g. after a failed upload
+    void requestKeyframe();
+
+    void setKeyframeInterval(int frames);
+
+private:
+    QMutex mutex;
+    int tileSize;
+    int keyframeInterval;
+    int framesSinceKeyframe;
+    bool keyframeRequested;
+    quint32 sequence;
+    quint32 keyframeSequence;
+    QSize frameSize;
+    QVector<quint64> tileHashes;
+};
+
+#endif // TILEDELTAENCODER_H
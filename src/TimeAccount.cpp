@@ -0,0 +1,83 @@
+#include "TimeAccount.h"
+#include <chrono>
+
+TimeAccount::TimeAccount(Clock clock)
+    : clock(clock ? std::move(clock) : Clock(&TimeAccount::steadyNowMsecs)),
+      carried(0),
+      closedTotal(0),
+      runningSince(0),
+      running(false)
+{
+}
+
+qint64 TimeAccount::steadyNowMsecs()
+{
+    using namespace std::chrono;
+    return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void TimeAccount::start()
+{
+    if (running)
+        return;
+    runningSince = clock();
+    running = true;
+}
+
+void TimeAccount::pause()
+{
+    if (!running)
+        return;
+    const qint64 now = clock();
+    closedIntervals.append({ runningSince, now });
+    closedTotal += now - runningSince;
+    running = false;
+}
+
+void TimeAccount::reset(qint64 carriedMsecs)
+{
+    closedIntervals.clear();
+    closedTotal = 0;
+    carried = carriedMsecs;
+    running = false;
+}
+
+qint64 TimeAccount::elapsedMsecs() const
+{
+    qint64 total = carried + closedTotal;
+    if (running)
+        total += clock() - runningSince;
+    return total;
+}
+
+int TimeAccount::msecsToNextSecond() const
+{
+    return int(1000 - elapsedMsecs() % 1000);
+}
+
+QString TimeAccount::format(qint64 secs)
+{
+    // Hand-rolled to avoid building three intermediate strings per refresh
+    char buffer[32];
+    char *end = buffer + sizeof(buffer);
+    char *p = end;
+
+    const int seconds = int(secs % 60);
+    const int minutes = int((secs / 60) % 60);
+    qint64 hours = secs / 3600;
+
+    *--p = char('0' + seconds % 10);
+    *--p = char('0' + seconds / 10);
+    *--p = ':';
+    *--p = char('0' + minutes % 10);
+    *--p = char('0' + minutes / 10);
+    *--p = ':';
+    int digits = 0;
+    do {
+        *--p = char('0' + hours % 10);
+        hours /= 10;
+        ++digits;
+    } while (hours > 0 || digits < 2);
+
+    return QString::fromLatin1(p, int(end - p));
+}
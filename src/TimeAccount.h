@@ -0,0 +1,56 @@
+#ifndef TIMEACCOUNT_H
+#define TIMEACCOUNT_H
+
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// Tracked time as monotonic start/pause intervals. Nothing accumulates per
+// tick, so a delayed or coalesced UI timer can't make the total drift; the
+// duration is computed from the clock whenever it is asked for.
+//
+// The default clock is std::chrono::steady_clock, which does not advance
+// while the machine is suspended. Tests and simulations can inject their
+// own millisecond clock.
+class TimeAccount
+{
+public:
+    using Clock = std::function<qint64()>;
+
+    struct Interval
+    {
+        qint64 start;
+        qint64 end;
+    };
+
+    explicit TimeAccount(Clock clock = Clock());
+
+    void start();
+    void pause();
+    // Ends the open interval and clears all history
+    void reset(qint64 carriedMsecs = 0);
+
+    bool isRunning() const { return running; }
+    qint64 elapsedMsecs() const;
+    qint64 elapsedSecs() const { return elapsedMsecs() / 1000; }
+
+    // Delay until the displayed seconds value next changes
+    int msecsToNextSecond() const;
+
+    // Closed intervals in clock time; the open one is not included
+    const QVector<Interval> &intervals() const { return closedIntervals; }
+
+    static qint64 steadyNowMsecs();
+    // "hh:mm:ss", hours grow past two digits for multi-day sessions
+    static QString format(qint64 secs);
+
+private:
+    Clock clock;
+    QVector<Interval> closedIntervals;
+    qint64 carried;
+    qint64 closedTotal;
+    qint64 runningSince;
+    bool running;
+};
+
+#endif // TIMEACCOUNT_H
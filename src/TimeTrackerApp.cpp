@@ -1,30 +1,26 @@
 #include "TimeTrackerApp.h"
 #include <QtWidgets>
-#include <QNetworkRequest>
-#include <QNetworkReply>
-#include <QJsonDocument>
-#include <QJsonObject>
-#include <QJsonArray>
-#include <QHttpMultiPart>
-#include <QBuffer>
-#include <QCloseEvent>
-#include <QDateTime>
 #include <QSettings>
+#include <QStandardPaths>
+#include "ApiClient.h"
+#include "DesktopAgent.h"
+#include "PerfMonitor.h"
 
-TimeTrackerApp::TimeTrackerApp(QWidget *parent)
+TimeTrackerApp::TimeTrackerApp(TrackerEngine *trackerEngine, DesktopAgent *agent, QWidget *parent)
     : QMainWindow(parent),
-      isRunning(false),
-      isPaused(false),
-      timeElapsed(0),
-      lastActivity(QDateTime::currentMSecsSinceEpoch()),
+      engine(trackerEngine),
+      desktopAgent(agent),
+      displayedSecs(0),
       isAfkDialogShown(false),
-      selectedTaskId(-1),
-      isSharingScreen(false)
+      isSharingScreen(false),
+      lastStreamedSequence(0),
+      userId(-1),
+      selectedTaskId(-1)
 {
-    // Set your actual API URL here
-    API_URL = "http://127.0.0.1:3000"; // Replace with your API URL
-
+    // The task list is read on this thread, so it has its own client
     networkManager = new QNetworkAccessManager(this);
+    apiClient = new ApiClient(networkManager, this);
+    apiClient->loadSettings();
 
     setupLoginUI();
     setupMainUI();
@@ -32,25 +28,31 @@ TimeTrackerApp::TimeTrackerApp(QWidget *parent)
     showLoginUI();
 
     timer = new QTimer(this);
+    timer->setSingleShot(true);
     connect(timer, &QTimer::timeout, this, &TimeTrackerApp::updateTimer);
 
-    afkTimer = new QTimer(this);
-    afkTimer->setInterval(1000); // Check every second
-    connect(afkTimer, &QTimer::timeout, this, &TimeTrackerApp::checkAfk);
-
-    screenshotTimer = new QTimer(this);
-    connect(screenshotTimer, &QTimer::timeout, this, &TimeTrackerApp::takeScreenshot);
-
-    // Restore timer state if exists
-    restoreTimerState();
-}
+    // Non-modal sync indicator
+    uploadStatusLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(uploadStatusLabel);
+    updateUploadStatus(0, QString(), 0);
 
-TimeTrackerApp::~TimeTrackerApp()
-{
-    if (ffmpegProcess->state() == QProcess::Running) {
-        ffmpegProcess->terminate();
-        ffmpegProcess->waitForFinished();
-    }
+    connect(engine, &TrackerEngine::statusChanged, this, &TimeTrackerApp::handleStatus);
+    connect(engine, &TrackerEngine::sessionStarted, this, &TimeTrackerApp::handleSessionStarted);
+    connect(engine, &TrackerEngine::tasksReceived, taskCatalog, &TaskCatalog::setTasks);
+    connect(engine, &TrackerEngine::loginFailed, this, [this](const QString &title, const QString &message) {
+        QMessageBox::warning(this, title, message);
+    });
+    connect(engine, &TrackerEngine::sessionExpired, this, [this]() {
+        QMessageBox::information(this, "Session Expired", "Your session has expired. Please log in again.");
+    });
+    connect(engine, &TrackerEngine::uploadDropped, this, [this](const UploadItem &item, const QString &reason) {
+        // A blob reference the server can't resolve is resent in full
+        if (item.kind == UploadItem::ScreenshotRef)
+            return;
+        statusBar()->showMessage("Upload rejected: " + reason, 10000);
+    });
+    if (desktopAgent)
+        connect(desktopAgent, &DesktopAgent::idleDetected, this, &TimeTrackerApp::handleIdle);
 }
 
 void TimeTrackerApp::setupLoginUI()
@@ -80,7 +82,14 @@ void TimeTrackerApp::setupMainUI()
     userInfoLabel = new QLabel(this);
     logoutButton = new QPushButton("Logout", this);
 
+    // Large catalogs are filtered through the model's index rather than
+    // scrolled through
+    taskCatalog = new TaskCatalog(apiClient, QStandardPaths::writableLocation(QStandardPaths::CacheLocation), this);
+    taskFilterEdit = new QLineEdit(this);
+    taskFilterEdit->setPlaceholderText("Search tasks");
+    taskFilterEdit->setClearButtonEnabled(true);
     taskComboBox = new QComboBox(this);
+    taskComboBox->setModel(taskCatalog);
 
     timerLabel = new QLabel("00:00:00", this);
     timerLabel->setAlignment(Qt::AlignCenter);
@@ -97,6 +106,11 @@ void TimeTrackerApp::setupMainUI()
     stopScreenShareButton = new QPushButton("Stop Screen Sharing", this);
     stopScreenShareButton->setEnabled(false); // Initially disabled
 
+    streamProfileComboBox = new QComboBox(this);
+    streamProfileComboBox->addItems(StreamProfile::names());
+    streamProfile = StreamProfile::named(QSettings("YourCompany", "TimeTrackerApp").value("stream/profile", "balanced").toString());
+    streamProfileComboBox->setCurrentText(streamProfile.name);
+
     screenPreview = new QLabel(this);
     screenPreview->setMinimumSize(640, 360);
     screenPreview->setScaledContents(true);
@@ -108,6 +122,7 @@ void TimeTrackerApp::setupMainUI()
     topLayout->addWidget(logoutButton);
 
     layout->addLayout(topLayout);
+    layout->addWidget(taskFilterEdit);
     layout->addWidget(taskComboBox);
     layout->addWidget(timerLabel);
 
@@ -124,23 +139,37 @@ void TimeTrackerApp::setupMainUI()
     QHBoxLayout *screenShareLayout = new QHBoxLayout();
     screenShareLayout->addWidget(startScreenShareButton);
     screenShareLayout->addWidget(stopScreenShareButton);
+    screenShareLayout->addWidget(streamProfileComboBox);
 
     layout->addLayout(screenShareLayout);
 
-    connect(logoutButton, &QPushButton::clicked, this, &TimeTrackerApp::showLoginUI);
+    connect(logoutButton, &QPushButton::clicked, this, &TimeTrackerApp::logout);
     connect(startButton, &QPushButton::clicked, this, &TimeTrackerApp::startTimer);
+    // Only a user's pick changes the task; model resets just move the row
+    connect(taskComboBox, QOverload<int>::of(&QComboBox::activated), this, [this](int index) {
+        const int taskId = taskComboBox->itemData(index, TaskCatalog::IdRole).toInt();
+        selectedTaskId = taskId;
+        QMetaObject::invokeMethod(engine, [engine = engine, taskId]() {
+            engine->setTask(taskId);
+        });
+    });
+    connect(taskCatalog, &QAbstractItemModel::modelReset, this, &TimeTrackerApp::showSelectedTask);
+    connect(taskFilterEdit, &QLineEdit::textChanged, this, [this](const QString &text) {
+        taskCatalog->setFilter(text, selectedTaskId);
+    });
     connect(pauseButton, &QPushButton::clicked, this, &TimeTrackerApp::pauseTimer);
     connect(resumeButton, &QPushButton::clicked, this, &TimeTrackerApp::resumeTimer);
     connect(stopButton, &QPushButton::clicked, this, &TimeTrackerApp::stopTimer);
 
     connect(startScreenShareButton, &QPushButton::clicked, this, &TimeTrackerApp::startScreenShare);
     connect(stopScreenShareButton, &QPushButton::clicked, this, &TimeTrackerApp::stopScreenShare);
+    connect(streamProfileComboBox, &QComboBox::currentTextChanged, this, &TimeTrackerApp::selectStreamProfile);
 
     // AFK dialog
     afkDialog = new QDialog(this);
     afkDialog->setModal(true);
     afkDialog->setWindowTitle("No Activity Detected");
-    QLabel *afkLabel = new QLabel("You have been inactive for 3 minutes. Would you like to pause the timer or continue?", afkDialog);
+    afkLabel = new QLabel(afkDialog);
     QPushButton *afkPauseButton = new QPushButton("Pause", afkDialog);
     QPushButton *afkContinueButton = new QPushButton("Continue", afkDialog);
     QHBoxLayout *afkButtonLayout = new QHBoxLayout();
@@ -157,340 +186,214 @@ void TimeTrackerApp::setupMainUI()
     });
     connect(afkContinueButton, &QPushButton::clicked, this, [this]() {
         afkDialog->hide();
-        lastActivity = QDateTime::currentMSecsSinceEpoch();
         isAfkDialogShown = false;
+        resumeTimer();
     });
 
     // Screen sharing setup
-    captureTimer = new QTimer(this);
-    ffmpegProcess = new QProcess(this);
+    captureSource = CaptureSource::create(this);
+    captureSource->setScreenName(QSettings("YourCompany", "TimeTrackerApp").value("stream/screen").toString());
+    streamSupervisor = new StreamSupervisor(this);
+
+    connect(captureSource, &CaptureSource::frameReady, this, &TimeTrackerApp::captureScreen);
+    connect(captureSource, &CaptureSource::error, this, [](const QString &message) {
+        qWarning() << message;
+    });
 
-    connect(captureTimer, &QTimer::timeout, this, &TimeTrackerApp::captureScreen);
-    connect(ffmpegProcess, &QProcess::readyReadStandardOutput, this, &TimeTrackerApp::handleFFmpegOutput);
-    connect(ffmpegProcess, QOverload<QProcess::ProcessError>::of(&QProcess::errorOccurred), this, &TimeTrackerApp::handleFFmpegError);
+    previewRenderer = new PreviewRenderer(this);
+    previewRenderer->setCpuBudget(QSettings("YourCompany", "TimeTrackerApp").value("preview/cpuBudget", 0.05).toDouble());
+    connect(previewRenderer, &PreviewRenderer::frameCost, this, [this](qint64, bool rendered) {
+        if (rendered) {
+            screenPreview->setToolTip(QString("Preview: %1 ms/frame, every %2 ms")
+                .arg(previewRenderer->averageCostNsecs() / 1e6, 0, 'f', 2)
+                .arg(previewRenderer->currentIntervalMsecs()));
+        }
+    });
+    connect(streamSupervisor, &StreamSupervisor::progress, this, &TimeTrackerApp::handleStreamProgress);
+    connect(streamSupervisor, &StreamSupervisor::restarting, this, &TimeTrackerApp::handleStreamRestarting);
+    connect(streamSupervisor, &StreamSupervisor::failed, this, &TimeTrackerApp::handleStreamFailed);
 }
 
 void TimeTrackerApp::showLoginUI()
 {
-    // Save timer state before logout
-    if (isRunning || isPaused) {
-        saveTimerState();
-    }
-
-    setCentralWidget(loginWidget);
+    showPage(loginWidget);
 }
 
 void TimeTrackerApp::showMainUI()
 {
-    setCentralWidget(mainWidget);
+    showPage(mainWidget);
 }
 
-void TimeTrackerApp::handleLogin()
+void TimeTrackerApp::showPage(QWidget *page)
 {
-    // Send login request
-
-    QString email = emailEdit->text();
-    QString password = passwordEdit->text();
+    if (centralWidget() == page)
+        return;
+    // setCentralWidget() deletes the widget it replaces; both pages live as
+    // long as the window
+    if (QWidget *previous = takeCentralWidget()) {
+        previous->setParent(this);
+        previous->hide();
+    }
+    setCentralWidget(page);
+}
 
-    QUrl url(API_URL + "/api/v1/login");
-    QNetworkRequest request(url);
+void TimeTrackerApp::handleLogin()
+{
+    // Send login request; the engine answers with sessionStarted or
+    // loginFailed
+    const QString email = emailEdit->text();
+    const QString password = passwordEdit->text();
+    QMetaObject::invokeMethod(engine, [engine = engine, email, password]() {
+        engine->login(email, password);
+    });
+}
 
-    request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
+void TimeTrackerApp::handleSessionStarted(const QString &token, int sessionUserId, const QString &userName)
+{
+    apiClient->setToken(token);
+    // A revalidated session keeps the catalog it already has
+    if (sessionUserId != userId) {
+        userId = sessionUserId;
+        taskCatalog->load(userId);
+    }
 
-    QJsonObject json;
-    json["email"] = email;
-    json["password"] = password;
-    QByteArray data = QJsonDocument(json).toJson();
+    // Update UI
+    userInfoLabel->setText("Welcome, " + userName);
+}
 
-    QNetworkReply *reply = networkManager->post(request, data);
-    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-        handleLoginResponse(reply);
-    });
+void TimeTrackerApp::logout()
+{
+    QMetaObject::invokeMethod(engine, &TrackerEngine::logout);
 }
 
-void TimeTrackerApp::handleLoginResponse(QNetworkReply* reply)
-{
-    if (reply->error() == QNetworkReply::NoError) {
-        QByteArray responseData = reply->readAll();
-        QJsonDocument jsonDoc(QJsonDocument::fromJson(responseData));
-        QJsonObject jsonObj = jsonDoc.object();
-        bool success = jsonObj["success"].toBool();
-        if (success) {
-            // Parse user data
-            QJsonObject dataObj = jsonObj["data"].toObject();
-            token = dataObj["token"].toString();
-            QJsonObject userObj = dataObj["user"].toObject();
-            userName = userObj["name"].toString();
-            userId = userObj["id"].toInt();
-
-            tasks.clear();
-            QJsonArray taskArray = userObj["task"].toArray();
-            for (const QJsonValue &value : taskArray) {
-                QJsonObject taskObj = value.toObject();
-                QString taskName = taskObj["name"].toString();
-                int taskId = taskObj["id"].toInt();
-                tasks.append(qMakePair(taskName, taskId));
-            }
-            // Update UI
-            userInfoLabel->setText("Welcome, " + userName);
-            taskComboBox->clear();
-            taskComboBox->addItem("Select Task", -1);
-            for (const auto &task : tasks) {
-                taskComboBox->addItem(task.first, task.second);
-            }
-
-            connect(taskComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [this](int index){
-                selectedTaskId = taskComboBox->itemData(index).toInt();
-            });
+void TimeTrackerApp::handleStatus(const EngineStatus &newStatus)
+{
+    const bool loginChanged = newStatus.loggedIn != status.loggedIn;
+    status = newStatus;
 
+    if (status.taskId != selectedTaskId) {
+        selectedTaskId = status.taskId;
+        showSelectedTask();
+    }
+    if (loginChanged) {
+        if (status.loggedIn) {
             showMainUI();
         } else {
-            QMessageBox::warning(this, "Login Failed", jsonObj["message"].toString());
+            userId = -1;
+            apiClient->setToken(QString());
+            taskCatalog->clear();
+            showLoginUI();
         }
-    } else {
-        QMessageBox::warning(this, "Network Error", reply->errorString());
     }
-    reply->deleteLater();
+
+    updateUploadStatus(status.pendingUploads, status.uploadError, status.retryInSecs);
+    updateTimer();
 }
 
 void TimeTrackerApp::startTimer()
 {
-    if (!isRunning && selectedTaskId != -1) {
-        // Start the timer
-        isRunning = true;
-        isPaused = false;
-        timer->start(1000); // Update every second
-        lastActivity = QDateTime::currentMSecsSinceEpoch();
-        afkTimer->start();
-
-        // Prepare request to start session
-        QUrl url(API_URL + "/api/v1/track-time");
-        QNetworkRequest request(url);
-        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-        QString authHeader = "Bearer " + token;
-        request.setRawHeader("Authorization", authHeader.toUtf8());
-
-        QJsonObject json;
-        json["duration"] = 0;
-        json["taskId"] = selectedTaskId;
-        json["userId"] = userId;
-
-        QByteArray data = QJsonDocument(json).toJson();
-
-        QNetworkReply *reply = networkManager->post(request, data);
-        connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-            if (reply->error() == QNetworkReply::NoError) {
-                QByteArray responseData = reply->readAll();
-                QJsonDocument jsonDoc(QJsonDocument::fromJson(responseData));
-                QJsonObject jsonObj = jsonDoc.object();
-                currentSessionId = QString::number(jsonObj["id"].toInt()); // Assuming id is an integer
-            } else {
-                QMessageBox::warning(this, "Network Error", reply->errorString());
-            }
-            reply->deleteLater();
-        });
-
-        // Start screenshot timer
-        screenshotTimer->start(30000); // Every 30 seconds
-
-        // Connect activity signals
-        qApp->installEventFilter(this);
-    }
+    QMetaObject::invokeMethod(engine, &TrackerEngine::start);
 }
 
 void TimeTrackerApp::pauseTimer()
 {
-    if (isRunning && !isPaused) {
-        timer->stop();
-        isPaused = true;
-        isRunning = false;
-        afkTimer->stop();
-        screenshotTimer->stop();
-
-        qApp->removeEventFilter(this);
-    }
+    QMetaObject::invokeMethod(engine, &TrackerEngine::pause);
 }
 
 void TimeTrackerApp::resumeTimer()
 {
-    if (isPaused) {
-        timer->start(1000);
-        isPaused = false;
-        isRunning = true;
-        lastActivity = QDateTime::currentMSecsSinceEpoch();
-        afkTimer->start();
-        screenshotTimer->start(30000);
-
-        qApp->installEventFilter(this);
-    }
+    QMetaObject::invokeMethod(engine, &TrackerEngine::resume);
 }
 
 void TimeTrackerApp::stopTimer()
 {
-    if (isRunning || isPaused) {
-        timer->stop();
-        isRunning = false;
-        isPaused = false;
-        afkTimer->stop();
-        screenshotTimer->stop();
-
-        qApp->removeEventFilter(this);
-
-        // Send the stop time to server
-
-        QUrl url(API_URL + "/api/v1/track-time");
-        QNetworkRequest request(url);
-        request.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
-        QString authHeader = "Bearer " + token;
-        request.setRawHeader("Authorization", authHeader.toUtf8());
-
-        QJsonObject json;
-        json["id"] = currentSessionId.toInt();
-        json["duration"] = timeElapsed;
-        json["taskId"] = selectedTaskId;
-        json["userId"] = userId;
-
-        QByteArray data = QJsonDocument(json).toJson();
-
-        QNetworkReply *reply = networkManager->post(request, data);
-        connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-            if (reply->error() != QNetworkReply::NoError) {
-                QMessageBox::warning(this, "Network Error", reply->errorString());
-            }
-            reply->deleteLater();
-        });
-
-        // Take final screenshot
-        takeScreenshot();
-
-        // Reset timer
-        timeElapsed = 0;
-        timerLabel->setText("00:00:00");
-
-        // Reset other state variables
-        currentSessionId = QString();
-    }
+    QMetaObject::invokeMethod(engine, &TrackerEngine::stop);
 }
 
 void TimeTrackerApp::updateTimer()
 {
-    timeElapsed++;
-    int hours = timeElapsed / 3600;
-    int minutes = (timeElapsed % 3600) / 60;
-    int seconds = timeElapsed % 60;
-    QString timeString = QString("%1:%2:%3")
-        .arg(hours, 2, 10, QChar('0'))
-        .arg(minutes, 2, 10, QChar('0'))
-        .arg(seconds, 2, 10, QChar('0'));
-    timerLabel->setText(timeString);
+    PerfScope scope(PerfMonitor::TimerTick);
+
+    // The engine's monotonic intervals are the truth; the label only
+    // extrapolates from its last status, so a late refresh loses nothing
+    const qint64 secs = status.elapsedAt(TimeAccount::steadyNowMsecs()) / 1000;
+    if (secs != displayedSecs) {
+        displayedSecs = secs;
+        timerLabel->setText(TimeAccount::format(secs));
+    }
+    scheduleTimerRefresh();
 }
 
-void TimeTrackerApp::resetLastActivity()
+void TimeTrackerApp::scheduleTimerRefresh()
 {
-    if (isRunning && !isPaused) {
-        lastActivity = QDateTime::currentMSecsSinceEpoch();
-
-        // Dismiss AFK dialog if shown
-        if (isAfkDialogShown) {
-            afkDialog->hide();
-            isAfkDialogShown = false;
-        }
-    }
+    // Nobody can see the label while hidden or minimized, so don't wake up
+    if (status.running && isVisible() && !isMinimized())
+        timer->start(int(1000 - status.elapsedAt(TimeAccount::steadyNowMsecs()) % 1000) + 1);
+    else
+        timer->stop();
 }
 
-
-void TimeTrackerApp::checkAfk()
+void TimeTrackerApp::showSelectedTask()
 {
-    if (isRunning && !isPaused) {
-        qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
-        if (currentTime - lastActivity >= 3 * 60 * 1000 && !isAfkDialogShown) {
-            // User has been inactive for 3 minutes
-            afkDialog->show();
-            isAfkDialogShown = true;
-            pauseTimer();
-        }
-    }
+    const QSignalBlocker blocker(taskComboBox);
+    const int row = taskCatalog->rowOfId(selectedTaskId);
+    taskComboBox->setCurrentIndex(row < 0 ? 0 : row);
 }
 
-void TimeTrackerApp::takeScreenshot()
+void TimeTrackerApp::showEvent(QShowEvent *event)
 {
-    // Capture screenshot and upload
-
-    QScreen *screen = QGuiApplication::primaryScreen();
-    if (screen) {
-        QPixmap screenshot = screen->grabWindow(0);
-        QByteArray ba;
-        QBuffer buffer(&ba);
-        buffer.open(QIODevice::WriteOnly);
-        screenshot.save(&buffer, "PNG");
-
-        // Prepare request
-        QUrl url(API_URL + "/api/v1/upload-screenshot");
-        QNetworkRequest request(url);
-        QString authHeader = "Bearer " + token;
-        request.setRawHeader("Authorization", authHeader.toUtf8());
-
-        // Use QHttpMultiPart for file upload
-        QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
-
-        QHttpPart imagePart;
-        imagePart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"screenshot\"; filename=\"screenshot.png\""));
-        imagePart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant("image/png"));
-        imagePart.setBody(ba);
-
-        QHttpPart sessionIdPart;
-        sessionIdPart.setHeader(QNetworkRequest::ContentDispositionHeader, QVariant("form-data; name=\"sessionId\""));
-        sessionIdPart.setBody(currentSessionId.toUtf8());
-
-        multiPart->append(imagePart);
-        multiPart->append(sessionIdPart);
-
-        QNetworkReply *reply = networkManager->post(request, multiPart);
-        multiPart->setParent(reply); // so that it will be deleted when reply is deleted
-
-        connect(reply, &QNetworkReply::finished, this, [this, reply]() {
-            handleScreenshotUpload(reply);
-        });
-    }
+    QMainWindow::showEvent(event);
+    previewRenderer->setActive(!isMinimized());
+    updateTimer();
+
+    // Cold start ends with the first window on screen
+    const bool restored = centralWidget() == mainWidget;
+    const double msecs = PerfMonitor::instance()->markStartup(restored ? "mainUiShown" : "loginUiShown");
+    if (msecs >= 0)
+        qInfo().noquote() << QString("Startup: %1 shown after %2 ms")
+                                 .arg(restored ? "main UI (cached session)" : "login", QString::number(msecs, 'f', 0));
 }
 
-void TimeTrackerApp::handleScreenshotUpload(QNetworkReply *reply)
+void TimeTrackerApp::hideEvent(QHideEvent *event)
 {
-    if (reply->error() != QNetworkReply::NoError) {
-        // Handle error
-        QMessageBox::warning(this, "Screenshot Upload Error", reply->errorString());
-    }
-    reply->deleteLater();
+    QMainWindow::hideEvent(event);
+    previewRenderer->setActive(false);
+    timer->stop();
 }
 
-void TimeTrackerApp::saveTimerState()
+void TimeTrackerApp::changeEvent(QEvent *event)
 {
-    QSettings settings("YourCompany", "TimeTrackerApp");
-    settings.setValue("timeElapsed", timeElapsed);
-    settings.setValue("isRunning", isRunning);
-    settings.setValue("isPaused", isPaused);
-    settings.setValue("selectedTaskId", selectedTaskId);
-    settings.setValue("currentSessionId", currentSessionId);
+    QMainWindow::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange) {
+        previewRenderer->setActive(isVisible() && !isMinimized());
+        updateTimer();
+    }
 }
 
-void TimeTrackerApp::restoreTimerState()
+void TimeTrackerApp::handleIdle(qint64 idleMsecs)
 {
-    QSettings settings("YourCompany", "TimeTrackerApp");
-    timeElapsed = settings.value("timeElapsed", 0).toInt();
-    isRunning = false; // Always start paused
-    isPaused = settings.value("isPaused", false).toBool();
-    selectedTaskId = settings.value("selectedTaskId", -1).toInt();
-    currentSessionId = settings.value("currentSessionId", "").toString();
+    if (status.running && !isAfkDialogShown) {
+        pauseTimer();
+        afkLabel->setText(
+            QString("You have been inactive for %1 minutes. Would you like to pause the timer or continue?")
+                .arg(idleMsecs / 60000));
+        afkDialog->show();
+        isAfkDialogShown = true;
+    }
 }
 
-void TimeTrackerApp::closeEvent(QCloseEvent *event)
+void TimeTrackerApp::updateUploadStatus(int pending, const QString &lastError, int retryInSecs)
 {
-    if (isRunning || isPaused) {
-        // Save timer state
-        saveTimerState();
+    if (pending == 0) {
+        uploadStatusLabel->setText("All data synced");
+        uploadStatusLabel->setToolTip(QString());
+    } else if (lastError.isEmpty()) {
+        uploadStatusLabel->setText(QString("Uploading %1 item(s)...").arg(pending));
+        uploadStatusLabel->setToolTip(QString());
+    } else {
+        uploadStatusLabel->setText(QString("Offline: %1 item(s) pending, retrying in %2 s").arg(pending).arg(retryInSecs));
+        uploadStatusLabel->setToolTip(lastError);
     }
-
-    QMainWindow::closeEvent(event);
 }
 
 void TimeTrackerApp::startScreenShare()
@@ -499,57 +402,53 @@ void TimeTrackerApp::startScreenShare()
         isSharingScreen = true;
         startScreenShareButton->setEnabled(false);
         stopScreenShareButton->setEnabled(true);
+        launchStream();
+    }
+}
 
-         // Convert userId to QString
-        QString userIdStr = QString::number(userId);
-        // Start FFmpeg process for RTMP streaming
-
-#ifdef Q_OS_WIN
-        QStringList ffmpegArgs = {
-            "-f", "gdigrab",  // Windows screen capture
-            "-framerate", "30",
-            "-i", "desktop",
-            "-c:v", "libx264",
-            "-preset", "ultrafast",
-            "-tune", "zerolatency",
-            "-f", "flv",
-            "rtmp://localhost:1935/live/" + userIdStr + "/stream"
-        };
-#elif defined(Q_OS_LINUX)
-        QStringList ffmpegArgs = {
-            "-f", "x11grab", // Linux screen capture
-            "-framerate", "30",
-            "-i", ":0.0",
-            "-c:v", "libx264",
-            "-preset", "ultrafast",
-            "-tune", "zerolatency",
-            "-f", "flv",
-            "rtmp://localhost:1935/live/stream"
-        };
-#else
-        // MacOS or others
-        QStringList ffmpegArgs = {
-            "-f", "avfoundation",
-            "-framerate", "30",
-            "-i", "1",
-            "-c:v", "libx264",
-            "-preset", "ultrafast",
-            "-tune", "zerolatency",
-            "-f", "flv",
-            "rtmp://localhost:1935/live/stream"
-        };
-#endif
-
-        ffmpegProcess->start("ffmpeg", ffmpegArgs);
-
-        if (!ffmpegProcess->waitForStarted()) {
-            QMessageBox::critical(this, "Error", "Could not start FFmpeg");
-            stopScreenShare();
-            return;
-        }
+void TimeTrackerApp::launchStream()
+{
+    // One capture feeds both the preview and ffmpeg's stdin, at the
+    // profile's frame rate
+    if (!captureSource->start(streamProfile.fps)) {
+        QMessageBox::critical(this, "Error", "Could not start screen capture");
+        stopScreenShare();
+        return;
+    }
+    lastStreamedSequence = 0;
+    streamSupervisor->start("ffmpeg", streamArguments());
+}
+
+QStringList TimeTrackerApp::streamArguments() const
+{
+    // Every user publishes under their own key, so viewers can subscribe
+    // to a single stream
+    QString streamUrl = "rtmp://localhost:1935/live/" + QString::number(userId) + "/stream";
 
-        captureTimer->start(100);
+    return streamProfile.ffmpegArguments(captureSource->frameSize(), streamUrl);
+}
+
+void TimeTrackerApp::selectStreamProfile(const QString &name)
+{
+    QSettings("YourCompany", "TimeTrackerApp").setValue("stream/profile", name);
+    applyStreamProfile(StreamProfile::named(name));
+}
+
+void TimeTrackerApp::applyStreamProfile(const StreamProfile &profile)
+{
+    streamProfile = profile;
+    if (!isSharingScreen)
+        return;
+
+    // The capture rate follows the profile; frames are refused while the
+    // supervisor swaps encoders
+    captureSource->stop();
+    if (!captureSource->start(streamProfile.fps)) {
+        stopScreenShare();
+        return;
     }
+    lastStreamedSequence = 0;
+    streamSupervisor->restart(streamArguments());
 }
 
 void TimeTrackerApp::stopScreenShare()
@@ -559,47 +458,73 @@ void TimeTrackerApp::stopScreenShare()
         startScreenShareButton->setEnabled(true);
         stopScreenShareButton->setEnabled(false);
 
-        captureTimer->stop();
+        captureSource->stop();
         screenPreview->clear();
 
-        if (ffmpegProcess->state() == QProcess::Running) {
-            ffmpegProcess->terminate();
-            ffmpegProcess->waitForFinished();
-        }
+        // Returns at once; the supervisor lets ffmpeg finish in the background
+        streamSupervisor->stop();
     }
 }
 
 void TimeTrackerApp::captureScreen()
 {
-    QScreen *screen = QGuiApplication::primaryScreen();
-    QPixmap screenShot = screen->grabWindow(0);
-    QPixmap scaledShot = screenShot.scaled(
-        screenPreview->size(),
-        Qt::KeepAspectRatio,
-        Qt::SmoothTransformation
-    );
-    screenPreview->setPixmap(scaledShot);
+    FrameRing *ring = captureSource->ring();
+    FrameRing::Frame frame;
+    if (!ring->acquireLatest(frame, lastStreamedSequence))
+        return;
+    lastStreamedSequence = frame.sequence;
+
+    // Raw frames go to ffmpeg straight from the ring slot. If ffmpeg falls
+    // more than a couple of frames behind, drop instead of buffering.
+    const qint64 rowBytes = qint64(frame.width) * 4;
+    const qint64 frameBytes = rowBytes * frame.height;
+    if (streamSupervisor->isRunning() && streamSupervisor->pendingBytes() < 2 * frameBytes) {
+        if (frame.bytesPerLine == rowBytes) {
+            streamSupervisor->write(reinterpret_cast<const char *>(frame.bits), frameBytes);
+        } else {
+            for (int y = 0; y < frame.height; ++y)
+                streamSupervisor->write(reinterpret_cast<const char *>(frame.bits + y * frame.bytesPerLine), rowBytes);
+        }
+    }
+
+    // The preview reads the slot in place and only redraws when due and
+    // the content changed
+    previewRenderer->setTargetSize(screenPreview->size());
+    if (previewRenderer->offer(frame))
+        screenPreview->setPixmap(QPixmap::fromImage(previewRenderer->image()));
+
+    ring->release(frame);
+}
+
+void TimeTrackerApp::handleStreamProgress(const StreamProgress::Report &report)
+{
+    stopScreenShareButton->setToolTip(QString("%1: %2 fps, %3 kbit/s, %4x")
+        .arg(streamProfile.name).arg(report.fps, 0, 'f', 1).arg(report.bitrateKbps).arg(report.speed, 0, 'f', 2));
+
+    // Below realtime the encoder falls further behind every second and we
+    // start dropping frames; a small margin absorbs capture pacing jitter
+    if (report.windowSpeed > 0 && report.windowSpeed < 0.95) {
+        const StreamProfile cheaper = StreamProfile::downgraded(streamProfile);
+        if (!cheaper.isValid())
+            return;
+        qWarning() << "Stream encoding at" << report.windowSpeed << "x, switching to" << cheaper.name;
+        statusBar()->showMessage("Screen share too slow, switched to " + cheaper.name, 10000);
+        // Not saved: the next share starts from the user's choice again
+        QSignalBlocker blocker(streamProfileComboBox);
+        streamProfileComboBox->setCurrentText(cheaper.name);
+        applyStreamProfile(cheaper);
+    }
 }
 
-void TimeTrackerApp::handleFFmpegOutput()
+void TimeTrackerApp::handleStreamRestarting(int attempt, qint64 delayMsecs, const QString &reason)
 {
-    QByteArray output = ffmpegProcess->readAllStandardOutput();
-    qDebug() << "FFmpeg Output:" << output;
+    statusBar()->showMessage(QString("Screen share interrupted (%1), retrying in %2 s, attempt %3")
+        .arg(reason).arg(delayMsecs / 1000).arg(attempt), int(delayMsecs));
 }
 
-void TimeTrackerApp::handleFFmpegError(QProcess::ProcessError error)
+void TimeTrackerApp::handleStreamFailed(const QString &reason)
 {
-    QString errorMessage;
-    switch (error) {
-        case QProcess::FailedToStart:
-            errorMessage = "FFmpeg failed to start";
-            break;
-        case QProcess::Crashed:
-            errorMessage = "FFmpeg crashed";
-            break;
-        default:
-            errorMessage = "Unknown FFmpeg error";
-    }
-    QMessageBox::critical(this, "FFmpeg Error", errorMessage);
+    stopScreenShare();
+    statusBar()->showMessage("Screen share stopped: " + reason);
 }
 
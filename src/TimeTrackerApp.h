@@ -3,7 +3,12 @@
 
 #include <QMainWindow>
 #include <QNetworkAccessManager>
-#include <QProcess>
+#include "CaptureSource.h"
+#include "PreviewRenderer.h"
+#include "StreamProfile.h"
+#include "StreamSupervisor.h"
+#include "TaskCatalog.h"
+#include "TrackerEngine.h"
 
 class QLabel;
 class QLineEdit;
@@ -11,22 +16,27 @@ class QPushButton;
 class QTimer;
 class QComboBox;
 class QDialog;
-class QNetworkReply;
+class ApiClient;
+class DesktopAgent;
 
 class TimeTrackerApp : public QMainWindow
 {
     Q_OBJECT
 public:
-    explicit TimeTrackerApp(QWidget *parent = nullptr);
-    ~TimeTrackerApp();
+    // The engine usually lives in another thread; the UI only reaches it
+    // through queued calls and its signals
+    TimeTrackerApp(TrackerEngine *engine, DesktopAgent *agent, QWidget *parent = nullptr);
 
 protected:
-    void closeEvent(QCloseEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void changeEvent(QEvent *event) override;
 
 private slots:
     // Login slots
     void handleLogin();
-    void handleLoginResponse(QNetworkReply* reply);
+    void handleSessionStarted(const QString &token, int sessionUserId, const QString &userName);
+    void logout();
 
     // Timer control slots
     void startTimer();
@@ -34,21 +44,22 @@ private slots:
     void resumeTimer();
     void stopTimer();
     void updateTimer();
+    void handleStatus(const EngineStatus &newStatus);
 
     // AFK detection
-    void resetLastActivity();
-    void checkAfk();
+    void handleIdle(qint64 idleMsecs);
 
-    // Screenshot
-    void takeScreenshot();
-    void handleScreenshotUpload(QNetworkReply* reply);
+    // Upload queue
+    void updateUploadStatus(int pending, const QString &lastError, int retryInSecs);
 
     // Screen sharing
     void startScreenShare();
     void stopScreenShare();
     void captureScreen();
-    void handleFFmpegOutput();
-    void handleFFmpegError(QProcess::ProcessError error);
+    void handleStreamProgress(const StreamProgress::Report &report);
+    void handleStreamRestarting(int attempt, qint64 delayMsecs, const QString &reason);
+    void handleStreamFailed(const QString &reason);
+    void selectStreamProfile(const QString &name);
 
 private:
     // UI components
@@ -62,6 +73,7 @@ private:
     QWidget *mainWidget;
     QLabel *userInfoLabel;
     QPushButton *logoutButton;
+    QLineEdit *taskFilterEdit;
     QComboBox *taskComboBox;
     QLabel *timerLabel;
     QPushButton *startButton;
@@ -71,51 +83,55 @@ private:
 
     QPushButton *startScreenShareButton;
     QPushButton *stopScreenShareButton;
+    QComboBox *streamProfileComboBox;
     QLabel *screenPreview;
+    QLabel *uploadStatusLabel;
 
     QDialog *afkDialog;
+    QLabel *afkLabel;
 
-    // Network
+    // Tracking core
+    TrackerEngine *engine;
+    DesktopAgent *desktopAgent;
+    EngineStatus status; // last status the engine published
+
+    // Network, for the task list only; tracking traffic is the engine's
     QNetworkAccessManager *networkManager;
-    QString token;
+    ApiClient *apiClient;
 
     // Timer
-    int timeElapsed; // seconds
-    QTimer *timer;
-    bool isRunning;
-    bool isPaused;
+    qint64 displayedSecs;
+    QTimer *timer; // label refresh only, never used for accounting
 
     // AFK detection
-    QTimer *afkTimer;
-    qint64 lastActivity;
     bool isAfkDialogShown;
 
-    // Screenshot
-    QTimer *screenshotTimer;
-
     // Screen sharing
-    QProcess *ffmpegProcess;
+    StreamSupervisor *streamSupervisor;
     bool isSharingScreen;
-    QTimer *captureTimer;
+    CaptureSource *captureSource; // single capture for preview and ffmpeg
+    quint64 lastStreamedSequence;
+    PreviewRenderer *previewRenderer;
+    StreamProfile streamProfile;
 
     // Other
     void setupLoginUI();
     void setupMainUI();
     void showLoginUI();
     void showMainUI();
-
-    QString API_URL;
+    void showPage(QWidget *page);
 
     // User data
-    QString userName;
     int userId;
-    QList<QPair<QString, int>> tasks; // Task name and ID
+    TaskCatalog *taskCatalog;
     int selectedTaskId;
-    QString currentSessionId;
 
     // Helper methods
-    void saveTimerState();
-    void restoreTimerState();
+    void scheduleTimerRefresh();
+    void showSelectedTask();
+    void launchStream();
+    QStringList streamArguments() const;
+    void applyStreamProfile(const StreamProfile &profile);
 };
 
 #endif // TIMETRACKERAPP_H
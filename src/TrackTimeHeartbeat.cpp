@@ -0,0 +1,91 @@
+#include "TrackTimeHeartbeat.h"
+#include "TimeAccount.h"
+#include <QDateTime>
+#include <QTimer>
+
+TrackTimeHeartbeat::TrackTimeHeartbeat(QObject *parent)
+    : QObject(parent),
+      wallClock(&QDateTime::currentMSecsSinceEpoch),
+      steadyClock(&TimeAccount::steadyNowMsecs),
+      steadyStart(0),
+      open(false)
+{
+    heartbeatTimer = new QTimer(this);
+    heartbeatTimer->setTimerType(Qt::CoarseTimer);
+    heartbeatTimer->setInterval(30000);
+    connect(heartbeatTimer, &QTimer::timeout, this, &TrackTimeHeartbeat::flush);
+}
+
+void TrackTimeHeartbeat::setInterval(qint64 msecs)
+{
+    heartbeatTimer->setInterval(int(qMax<qint64>(0, msecs)));
+    if (msecs <= 0)
+        heartbeatTimer->stop();
+    else if (open)
+        heartbeatTimer->start();
+}
+
+void TrackTimeHeartbeat::setClocks(std::function<qint64()> wall, std::function<qint64()> steady)
+{
+    wallClock = std::move(wall);
+    steadyClock = std::move(steady);
+}
+
+void TrackTimeHeartbeat::begin(const QString &clientSessionId, int taskId)
+{
+    if (open)
+        end();
+    if (clientSessionId != sessionId) {
+        flush();
+        sessionId = clientSessionId;
+    }
+
+    current = IntervalDelta();
+    current.start = wallClock();
+    current.end = current.start;
+    current.taskId = taskId;
+    steadyStart = steadyClock();
+    open = true;
+
+    flush();
+    if (heartbeatTimer->interval() > 0)
+        heartbeatTimer->start();
+}
+
+void TrackTimeHeartbeat::end()
+{
+    if (!open)
+        return;
+    heartbeatTimer->stop();
+    closed.append(openDelta());
+    open = false;
+    flush();
+}
+
+void TrackTimeHeartbeat::flush()
+{
+    QVector<IntervalDelta> deltas;
+    deltas.swap(closed);
+    if (open)
+        deltas.append(openDelta());
+    if (!deltas.isEmpty() && !sessionId.isEmpty())
+        emit batchReady(sessionId, deltas);
+}
+
+IntervalDelta TrackTimeHeartbeat::openInterval() const
+{
+    if (!open)
+        return IntervalDelta();
+    IntervalDelta interval = current;
+    interval.end = current.start + (steadyClock() - steadyStart);
+    return interval;
+}
+
+IntervalDelta TrackTimeHeartbeat::openDelta()
+{
+    // The end is derived from the monotonic clock, so wall-clock
+    // adjustments while running can't stretch or shrink the interval
+    current.end = current.start + (steadyClock() - steadyStart);
+    ++current.seq;
+    return current;
+}
@@ -0,0 +1,56 @@
+#ifndef TRACKTIMEHEARTBEAT_H
+#define TRACKTIMEHEARTBEAT_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <functional>
+#include "TrackTimePayload.h"
+
+class QTimer;
+
+// Reports tracked time while it accrues instead of only at session stop.
+// Each run of the timer is one interval, keyed by its wall-clock start. A
+// heartbeat every few seconds, and every start or stop, emits the latest
+// end of the open interval plus any intervals closed since the last batch.
+// Deltas carry a per-interval sequence number, so a server merging them
+// can ignore repeats and stale ones; server/heartbeat-aggregator.js is the
+// reference implementation.
+class TrackTimeHeartbeat : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrackTimeHeartbeat(QObject *parent = nullptr);
+
+    // 0 reports on start and stop only
+    void setInterval(qint64 msecs);
+    // Wall-clock and monotonic milliseconds; replaceable for tests
+    void setClocks(std::function<qint64()> wall, std::function<qint64()> steady);
+
+    void begin(const QString &clientSessionId, int taskId);
+    // Closes the open interval and reports it immediately
+    void end();
+    void flush();
+
+    bool isActive() const { return open; }
+    // The open interval as of now, without reporting it; taskId is -1 when
+    // nothing is open
+    IntervalDelta openInterval() const;
+
+signals:
+    void batchReady(const QString &clientSessionId, const QVector<IntervalDelta> &deltas);
+
+private:
+    IntervalDelta openDelta();
+
+    std::function<qint64()> wallClock;
+    std::function<qint64()> steadyClock;
+    QTimer *heartbeatTimer;
+    QString sessionId;
+    QVector<IntervalDelta> closed; // not yet reported
+    IntervalDelta current;
+    qint64 steadyStart;
+    bool open;
+};
+
+#endif // TRACKTIMEHEARTBEAT_H
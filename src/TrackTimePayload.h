@@ -0,0 +1,137 @@
+#ifndef TRACKTIMEPAYLOAD_H
+#define TRACKTIMEPAYLOAD_H
+
+#include <QDate>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QString>
+#include <QVector>
+
+// Body of POST /api/v1/track-time. The start of a session has no server id
+// yet; pass sessionId < 0 to leave it out.
+inline QJsonObject trackTimePayload(int sessionId, qint64 durationSecs, int taskId, int userId,
+                                    const QString &clientSessionId)
+{
+    QJsonObject json;
+    if (sessionId >= 0)
+        json["id"] = sessionId;
+    json["duration"] = durationSecs;
+    json["taskId"] = taskId;
+    json["userId"] = userId;
+    json["clientSessionId"] = clientSessionId;
+    return json;
+}
+
+// One run of the timer in wall-clock msecs since epoch. An interval is
+// identified by its start; a higher seq supersedes earlier reports of it.
+struct IntervalDelta
+{
+    qint64 start = 0;
+    qint64 end = 0;
+    int taskId = -1;
+    quint32 seq = 0;
+};
+
+// Input activity of one wall-clock minute, or of the part of it sampled
+// before tracking paused: event counts, and how many of its seconds fell
+// into each rate band. Counts only, never what was typed or where.
+struct ActivityMinute
+{
+    // Events per second: 0, 1-2, 3-5, 6-10, 11-20, more
+    static constexpr int RateBins = 6;
+
+    qint64 start = 0;   // msecs since epoch, on a minute boundary
+    quint8 offset = 0;  // first sampled second within the minute
+    quint8 seconds[RateBins] = {};
+    quint16 keys = 0;   // key presses, repeats included
+    quint16 clicks = 0; // button presses, wheel steps included
+    quint16 moves = 0;  // tenths of a second with pointer motion
+
+    static int rateBin(quint32 events)
+    {
+        static constexpr quint32 upper[RateBins - 1] = { 0, 2, 5, 10, 20 };
+        int bin = 0;
+        while (bin < RateBins - 1 && events > upper[bin])
+            ++bin;
+        return bin;
+    }
+};
+
+// Body of POST /api/v1/track-time/heartbeat. Activity minutes ride along
+// with the intervals; a batch may carry only activity.
+inline QJsonObject heartbeatPayload(int sessionId, int userId, const QString &clientSessionId,
+                                    const QVector<IntervalDelta> &deltas,
+                                    const QVector<ActivityMinute> &activity = {})
+{
+    QJsonArray intervals;
+    for (const IntervalDelta &delta : deltas) {
+        QJsonObject interval;
+        interval["start"] = delta.start;
+        interval["end"] = delta.end;
+        interval["taskId"] = delta.taskId;
+        interval["seq"] = qint64(delta.seq);
+        intervals.append(interval);
+    }
+
+    QJsonObject json;
+    if (sessionId >= 0)
+        json["id"] = sessionId;
+    json["userId"] = userId;
+    json["clientSessionId"] = clientSessionId;
+    json["intervals"] = intervals;
+
+    if (!activity.isEmpty()) {
+        QJsonArray minutes;
+        for (const ActivityMinute &minute : activity) {
+            QJsonArray seconds;
+            for (quint8 count : minute.seconds)
+                seconds.append(count);
+            QJsonObject entry;
+            entry["start"] = minute.start;
+            entry["offset"] = minute.offset;
+            entry["keys"] = minute.keys;
+            entry["clicks"] = minute.clicks;
+            entry["moves"] = minute.moves;
+            entry["rates"] = seconds;
+            minutes.append(entry);
+        }
+        json["activity"] = minutes;
+    }
+    return json;
+}
+
+// Tracked time of one local calendar day, per task
+struct DayRollup
+{
+    QDate date;
+    QHash<int, qint64> msecs;
+};
+
+// Body of POST /api/v1/activity/rollups. Each day carries its full totals,
+// so a later rollup simply replaces an earlier one.
+inline QJsonObject rollupPayload(int userId, const QVector<DayRollup> &days, qint64 generatedAt)
+{
+    QJsonArray dayArray;
+    for (const DayRollup &day : days) {
+        QJsonArray tasks;
+        for (auto it = day.msecs.cbegin(); it != day.msecs.cend(); ++it) {
+            QJsonObject task;
+            task["taskId"] = it.key();
+            task["secs"] = it.value() / 1000;
+            tasks.append(task);
+        }
+        QJsonObject json;
+        json["date"] = day.date.toString(Qt::ISODate);
+        json["tasks"] = tasks;
+        dayArray.append(json);
+    }
+
+    QJsonObject json;
+    json["userId"] = userId;
+    json["generatedAt"] = generatedAt;
+    json["days"] = dayArray;
+    return json;
+}
+
+#endif // TRACKTIMEPAYLOAD_H
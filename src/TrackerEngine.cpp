@@ -0,0 +1,572 @@
+#include "TrackerEngine.h"
+#include "ApiClient.h"
+#include "EngineServer.h"
+#include "PerfMonitor.h"
+#include "TrackTimeHeartbeat.h"
+#include "TrackTimePayload.h"
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDateTime>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTimer>
+#include <QUuid>
+#include <QDebug>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// Activity waiting for a heartbeat goes out on its own past an hour's worth
+constexpr int MaxPendingActivityMinutes = 60;
+
+// When a session from the login or revalidation payload stops being
+// trusted: the token's own expiry or the server's expiresIn, capped by
+// session/maxAgeHours
+qint64 sessionExpiry(const QString &token, const QJsonObject &data)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const qint64 maxAgeHours = QSettings("YourCompany", "TimeTrackerApp").value("session/maxAgeHours", 72).toLongLong();
+    qint64 expiresAt = now + qMax<qint64>(0, maxAgeHours) * 3600 * 1000;
+    if (data.contains("expiresIn"))
+        expiresAt = qMin(expiresAt, now + data["expiresIn"].toInteger() * 1000);
+    if (const qint64 tokenExpiresAt = SessionCache::tokenExpiry(token))
+        expiresAt = qMin(expiresAt, tokenExpiresAt);
+    return expiresAt;
+}
+
+}
+
+QJsonObject EngineStatus::toJson() const
+{
+    QJsonObject json;
+    json["loggedIn"] = loggedIn;
+    json["userId"] = userId;
+    json["userName"] = userName;
+    json["running"] = running;
+    json["paused"] = paused;
+    // A reader in another process has its own steady clock origin
+    json["elapsedMsecs"] = elapsedAt(TimeAccount::steadyNowMsecs());
+    json["taskId"] = taskId;
+    json["sessionId"] = sessionId;
+    json["clientSessionId"] = clientSessionId;
+    json["pendingUploads"] = pendingUploads;
+    json["uploadError"] = uploadError;
+    json["retryInSecs"] = retryInSecs;
+    return json;
+}
+
+EngineStatus EngineStatus::fromJson(const QJsonObject &json)
+{
+    EngineStatus status;
+    status.loggedIn = json["loggedIn"].toBool();
+    status.userId = json["userId"].toInt(-1);
+    status.userName = json["userName"].toString();
+    status.running = json["running"].toBool();
+    status.paused = json["paused"].toBool();
+    status.elapsedMsecs = json["elapsedMsecs"].toInteger();
+    status.steadyAt = TimeAccount::steadyNowMsecs();
+    status.taskId = json["taskId"].toInt(-1);
+    status.sessionId = json["sessionId"].toString();
+    status.clientSessionId = json["clientSessionId"].toString();
+    status.pendingUploads = json["pendingUploads"].toInt();
+    status.uploadError = json["uploadError"].toString();
+    status.retryInSecs = json["retryInSecs"].toInt();
+    return status;
+}
+
+TrackerEngine::TrackerEngine(QObject *parent)
+    : QObject(parent),
+      networkManager(nullptr),
+      apiClient(nullptr),
+      uploadQueue(nullptr),
+      server(nullptr),
+      rollupTimer(nullptr),
+      checkpointTimer(nullptr),
+      heartbeat(nullptr),
+      userId(-1),
+      selectedTaskId(-1),
+      isRunning(false),
+      isPaused(false),
+      pendingUploads(0),
+      retryInSecs(0)
+{
+}
+
+TrackerEngine::~TrackerEngine() = default;
+
+QString TrackerEngine::socketName()
+{
+    QString user = qEnvironmentVariable("USER");
+    if (user.isEmpty())
+        user = qEnvironmentVariable("USERNAME");
+    return "TimeTrackerApp-" + user;
+}
+
+EngineStatus TrackerEngine::status() const
+{
+    EngineStatus status;
+    status.loggedIn = !token.isEmpty();
+    status.userId = userId;
+    status.userName = userName;
+    status.running = isRunning;
+    status.paused = isPaused;
+    status.elapsedMsecs = timeAccount.elapsedMsecs();
+    status.steadyAt = TimeAccount::steadyNowMsecs();
+    status.taskId = selectedTaskId;
+    status.sessionId = currentSessionId;
+    status.clientSessionId = clientSessionId;
+    status.pendingUploads = pendingUploads;
+    status.uploadError = uploadError;
+    status.retryInSecs = retryInSecs;
+    return status;
+}
+
+void TrackerEngine::initialize()
+{
+    QSettings settings("YourCompany", "TimeTrackerApp");
+    const QString dataDirectory = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+
+    // Every API call goes through one client, sharing its connections
+    networkManager = new QNetworkAccessManager(this);
+    apiClient = new ApiClient(networkManager, this);
+    apiClient->loadSettings();
+
+    sessionCache.reset(new SessionCache(dataDirectory));
+
+    uploadQueue = new UploadQueue(apiClient, dataDirectory, this);
+    uploadQueue->setMaxInFlightBytes(settings.value("upload/maxInFlightMB", 32).toLongLong() * 1024 * 1024);
+    connect(uploadQueue, &UploadQueue::delivered, this, &TrackerEngine::handleUploadDelivered);
+    connect(uploadQueue, &UploadQueue::dropped, this, &TrackerEngine::uploadDropped);
+    connect(uploadQueue, &UploadQueue::statusChanged, this, [this](int pending, const QString &lastError, int retryIn) {
+        pendingUploads = pending;
+        uploadError = lastError;
+        retryInSecs = retryIn;
+        publishStatus();
+    });
+    pendingUploads = uploadQueue->pendingCount();
+
+    // Elapsed time is checkpointed while running so a crash loses seconds,
+    // not the session
+    stateStore.reset(new StateStore(dataDirectory));
+    checkpointTimer = new QTimer(this);
+    checkpointTimer->setTimerType(Qt::CoarseTimer);
+    checkpointTimer->setInterval(qMax(1, settings.value("state/checkpointSecs", 5).toInt()) * 1000);
+    connect(checkpointTimer, &QTimer::timeout, this, &TrackerEngine::checkpointTimerState);
+
+    // Time reaches the server while it accrues, not only at stop
+    heartbeat = new TrackTimeHeartbeat(this);
+    heartbeat->setInterval(settings.value("trackTime/heartbeatSecs", 30).toLongLong() * 1000);
+    // Every interval the server hears about is kept locally too, so day and
+    // week totals are answered here; the server gets compact rollups
+    activityLog.reset(new ActivityLog(dataDirectory, settings.value("activity/retentionDays", 90).toInt()));
+    rollupTimer = new QTimer(this);
+    rollupTimer->setTimerType(Qt::CoarseTimer);
+    rollupTimer->setInterval(qMax(1, settings.value("activity/rollupMins", 15).toInt()) * 60 * 1000);
+    connect(rollupTimer, &QTimer::timeout, this, &TrackerEngine::sendRollups);
+    rollupTimer->start();
+
+    connect(heartbeat, &TrackTimeHeartbeat::batchReady, this,
+            [this](const QString &sessionClientId, const QVector<IntervalDelta> &deltas) {
+        for (const IntervalDelta &delta : deltas)
+            activityLog->record(delta);
+        enqueueTrackTime(heartbeatPayload(serverSessionId(sessionClientId), userId, sessionClientId, deltas,
+                                          pendingActivity.take(sessionClientId)),
+                         "heartbeat:" + sessionClientId, "/api/v1/track-time/heartbeat");
+    });
+
+    // Restore timer state if exists
+    restoreTimerState();
+
+    // A cached session starts tracking without waiting on the network
+    restoreSession();
+
+    if (settings.value("ipc/enabled", true).toBool()) {
+        server = new EngineServer(this, this);
+        if (!server->listen(socketName()))
+            qWarning() << "Engine control socket unavailable:" << server->errorString();
+    }
+
+    publishStatus();
+}
+
+void TrackerEngine::shutdown()
+{
+    if (isRunning || isPaused)
+        saveTimerState();
+    // Journaled, so they go out on the next run
+    sendRollups();
+    const QStringList activitySessions = pendingActivity.keys();
+    for (const QString &sessionClientId : activitySessions)
+        sendInputActivity(sessionClientId);
+    if (server)
+        server->close();
+}
+
+void TrackerEngine::login(const QString &email, const QString &password)
+{
+    QJsonObject json;
+    json["email"] = email;
+    json["password"] = password;
+
+    QNetworkReply *reply = apiClient->post("/api/v1/login", json);
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        handleLoginResponse(reply);
+    });
+}
+
+void TrackerEngine::handleLoginResponse(QNetworkReply *reply)
+{
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+        emit loginFailed("Network Error", reply->errorString());
+        return;
+    }
+
+    const QJsonObject jsonObj = QJsonDocument::fromJson(reply->readAll()).object();
+    if (!jsonObj["success"].toBool()) {
+        emit loginFailed("Login Failed", jsonObj["message"].toString());
+        return;
+    }
+
+    // Parse user data
+    const QJsonObject dataObj = jsonObj["data"].toObject();
+    const QJsonObject userObj = dataObj["user"].toObject();
+    CachedSession session;
+    session.token = dataObj["token"].toString();
+    session.userId = userObj["id"].toInt();
+    session.userName = userObj["name"].toString();
+    session.screenshotPolicy = dataObj["screenshotPolicy"].toObject();
+    session.expiresAt = sessionExpiry(session.token, dataObj);
+    session.savedAt = QDateTime::currentMSecsSinceEpoch();
+    if (QSettings("YourCompany", "TimeTrackerApp").value("session/remember", true).toBool())
+        sessionCache->save(session);
+    startSession(session, false);
+
+    if (userObj.contains("task")) {
+        QVector<TaskInfo> loginTasks;
+        const QJsonArray taskArray = userObj["task"].toArray();
+        loginTasks.reserve(taskArray.size());
+        for (const QJsonValue &value : taskArray) {
+            const QJsonObject taskObj = value.toObject();
+            loginTasks.append({ taskObj["id"].toInt(), taskObj["name"].toString() });
+        }
+        emit tasksReceived(loginTasks);
+    }
+}
+
+void TrackerEngine::startSession(const CachedSession &session, bool fromCache)
+{
+    token = session.token;
+    userName = session.userName;
+    userId = session.userId;
+    apiClient->setToken(token);
+    uploadQueue->drain();
+
+    emit sessionStarted(token, userId, userName, session.screenshotPolicy, fromCache);
+    publishStatus();
+}
+
+void TrackerEngine::restoreSession()
+{
+    CachedSession session;
+    if (!sessionCache->load(&session))
+        return;
+
+    startSession(session, true);
+    PerfMonitor::instance()->markStartup("sessionRestored");
+
+    // The token may have been revoked since; the server has the last word
+    const QString checkedToken = token;
+    QNetworkReply *reply = apiClient->get(apiClient->request("/api/v1/me"));
+    connect(reply, &QNetworkReply::finished, this, [this, reply, checkedToken]() {
+        reply->deleteLater();
+        // Logged out or in again while the check was running
+        if (checkedToken == token)
+            handleSessionCheck(reply);
+    });
+}
+
+void TrackerEngine::handleSessionCheck(QNetworkReply *reply)
+{
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 401 || status == 403) {
+        logout();
+        emit sessionExpired();
+        return;
+    }
+    // Offline or an older server: keep working with the cached session
+    if (reply->error() != QNetworkReply::NoError) {
+        if (status != 404)
+            qWarning() << "Session check failed:" << reply->errorString();
+        return;
+    }
+
+    const QJsonObject jsonObj = QJsonDocument::fromJson(reply->readAll()).object();
+    const QJsonObject dataObj = jsonObj["data"].toObject();
+    const QJsonObject userObj = dataObj["user"].toObject();
+    CachedSession session;
+    if (!sessionCache->load(&session) || userObj["id"].toInt(userId) != userId)
+        return;
+
+    // The server may rotate the token on the way
+    if (dataObj.contains("token")) {
+        session.token = dataObj["token"].toString();
+        token = session.token;
+        apiClient->setToken(token);
+    }
+    if (userObj.contains("name")) {
+        session.userName = userObj["name"].toString();
+        userName = session.userName;
+    }
+    if (dataObj.contains("screenshotPolicy"))
+        session.screenshotPolicy = dataObj["screenshotPolicy"].toObject();
+    session.expiresAt = sessionExpiry(session.token, dataObj);
+    session.savedAt = QDateTime::currentMSecsSinceEpoch();
+    sessionCache->save(session);
+    emit sessionStarted(token, userId, userName, session.screenshotPolicy, true);
+    publishStatus();
+
+    const double msecs = PerfMonitor::instance()->markStartup("sessionRevalidated");
+    if (msecs >= 0)
+        qInfo().noquote() << QString("Startup: session revalidated after %1 ms").arg(msecs, 0, 'f', 0);
+}
+
+void TrackerEngine::logout()
+{
+    // An explicit logout forgets the cached session; queued uploads wait
+    // on disk for the next login
+    if (isRunning || isPaused)
+        saveTimerState();
+    sessionCache->clear();
+    token.clear();
+    apiClient->setToken(QString());
+    publishStatus();
+}
+
+void TrackerEngine::setTask(int taskId)
+{
+    if (taskId == selectedTaskId)
+        return;
+    selectedTaskId = taskId;
+    publishStatus();
+}
+
+void TrackerEngine::start()
+{
+    // Tracked time belongs to a user and a task
+    if (!isRunning && !isPaused && selectedTaskId != -1 && !token.isEmpty()) {
+        // Start the timer
+        isRunning = true;
+        isPaused = false;
+        timeAccount.start();
+
+        // Queue the session start; the server id arrives on delivery
+        clientSessionId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+
+        enqueueTrackTime(trackTimePayload(-1, 0, selectedTaskId, userId, clientSessionId),
+                         "start:" + clientSessionId);
+        heartbeat->begin(clientSessionId, selectedTaskId);
+
+        saveTimerState();
+        checkpointTimer->start();
+        publishStatus();
+    }
+}
+
+void TrackerEngine::pause()
+{
+    if (isRunning && !isPaused) {
+        timeAccount.pause();
+        isPaused = true;
+        isRunning = false;
+        heartbeat->end();
+        checkpointTimer->stop();
+        saveTimerState();
+        publishStatus();
+    }
+}
+
+void TrackerEngine::resume()
+{
+    if (isPaused) {
+        isPaused = false;
+        isRunning = true;
+        timeAccount.start();
+        heartbeat->begin(clientSessionId, selectedTaskId);
+        saveTimerState();
+        checkpointTimer->start();
+        publishStatus();
+    }
+}
+
+void TrackerEngine::stop()
+{
+    if (isRunning || isPaused) {
+        timeAccount.pause();
+        isRunning = false;
+        isPaused = false;
+        heartbeat->end();
+
+        // Send the stop time to server; until the start's reply names the
+        // session, the server matches it by clientSessionId
+        enqueueTrackTime(trackTimePayload(serverSessionId(clientSessionId), timeAccount.elapsedSecs(),
+                                          selectedTaskId, userId, clientSessionId),
+                         "stop:" + clientSessionId);
+
+        // The final screenshot is the desktop side's
+        emit trackingStopped(currentSessionId, clientSessionId);
+        sendRollups();
+
+        // Reset timer
+        timeAccount.reset();
+
+        // Reset other state variables
+        currentSessionId = QString();
+        clientSessionId = QString();
+        checkpointTimer->stop();
+        saveTimerState();
+        publishStatus();
+    }
+}
+
+void TrackerEngine::enqueueUpload(const UploadItem &item)
+{
+    uploadQueue->enqueue(item);
+}
+
+void TrackerEngine::recordInputActivity(const QString &sessionClientId, const ActivityMinute &minute)
+{
+    if (sessionClientId.isEmpty())
+        return;
+    QVector<ActivityMinute> &minutes = pendingActivity[sessionClientId];
+    minutes.append(minute);
+    // No heartbeat coming to carry it: the session paused or stopped, or
+    // heartbeats are off
+    if (sessionClientId != clientSessionId || !isRunning || minutes.size() >= MaxPendingActivityMinutes)
+        sendInputActivity(sessionClientId);
+}
+
+void TrackerEngine::sendInputActivity(const QString &sessionClientId)
+{
+    const QVector<ActivityMinute> minutes = pendingActivity.take(sessionClientId);
+    if (!minutes.isEmpty())
+        enqueueTrackTime(heartbeatPayload(serverSessionId(sessionClientId), userId, sessionClientId, {}, minutes),
+                         "heartbeat:" + sessionClientId, "/api/v1/track-time/heartbeat");
+}
+
+int TrackerEngine::serverSessionId(const QString &sessionClientId) const
+{
+    return sessionClientId == clientSessionId && !currentSessionId.isEmpty() ? currentSessionId.toInt() : -1;
+}
+
+void TrackerEngine::sendRollups()
+{
+    // Rollups belong to a user; changed days keep until one logs in
+    if (token.isEmpty() || userId < 0)
+        return;
+    const QVector<DayRollup> days = activityLog->takeChangedDays();
+    if (!days.isEmpty())
+        enqueueTrackTime(rollupPayload(userId, days, QDateTime::currentMSecsSinceEpoch()),
+                         "rollup", "/api/v1/activity/rollups");
+}
+
+QJsonObject TrackerEngine::summary(ActivityLog::Period period, const QDate &date) const
+{
+    const IntervalDelta live = heartbeat->openInterval();
+    const QHash<int, qint64> totals = activityLog->totals(period, date, &live);
+
+    QVector<QPair<qint64, int>> ranked;
+    qint64 total = 0;
+    for (auto it = totals.cbegin(); it != totals.cend(); ++it) {
+        ranked.append({ it.value(), it.key() });
+        total += it.value();
+    }
+    std::sort(ranked.begin(), ranked.end(), std::greater<>());
+
+    QJsonArray tasks;
+    for (const auto &entry : std::as_const(ranked)) {
+        QJsonObject task;
+        task["taskId"] = entry.second;
+        task["secs"] = entry.first / 1000;
+        tasks.append(task);
+    }
+
+    // Weeks start on Monday
+    const QDate first = period == ActivityLog::Day ? date : date.addDays(1 - date.dayOfWeek());
+    QJsonObject json;
+    json["period"] = period == ActivityLog::Day ? "day" : "week";
+    json["from"] = first.toString(Qt::ISODate);
+    json["to"] = (period == ActivityLog::Day ? first : first.addDays(6)).toString(Qt::ISODate);
+    json["totalSecs"] = total / 1000;
+    json["tasks"] = tasks;
+    return json;
+}
+
+void TrackerEngine::enqueueTrackTime(const QJsonObject &json, const QString &tag, const QString &endpoint)
+{
+    UploadItem item;
+    item.kind = UploadItem::TrackTime;
+    item.endpoint = endpoint;
+    item.tag = tag;
+    item.body = apiClient->encode(json, &item.contentType);
+
+    uploadQueue->enqueue(item);
+}
+
+void TrackerEngine::handleUploadDelivered(const UploadItem &item, const QByteArray &response)
+{
+    if (!clientSessionId.isEmpty() && item.tag == "start:" + clientSessionId) {
+        QJsonObject jsonObj = QJsonDocument::fromJson(response).object();
+        currentSessionId = QString::number(jsonObj["id"].toInt()); // Assuming id is an integer
+        saveTimerState();
+        publishStatus();
+    }
+}
+
+void TrackerEngine::saveTimerState()
+{
+    TimerState state;
+    state.elapsedMsecs = timeAccount.elapsedMsecs();
+    state.running = isRunning;
+    state.paused = isPaused;
+    state.selectedTaskId = selectedTaskId;
+    state.currentSessionId = currentSessionId;
+    state.clientSessionId = clientSessionId;
+    stateStore->save(state);
+}
+
+void TrackerEngine::checkpointTimerState()
+{
+    stateStore->checkpoint(timeAccount.elapsedMsecs());
+}
+
+void TrackerEngine::restoreTimerState()
+{
+    TimerState state = stateStore->state();
+    if (!stateStore->hasState()) {
+        // State saved by versions that kept it in QSettings
+        QSettings settings("YourCompany", "TimeTrackerApp");
+        const qint64 elapsedSecs = settings.value("timeElapsed", 0).toLongLong();
+        state.elapsedMsecs = settings.value("timeElapsedMsecs", elapsedSecs * 1000).toLongLong();
+        state.paused = settings.value("isPaused", false).toBool();
+        state.selectedTaskId = settings.value("selectedTaskId", -1).toInt();
+        state.currentSessionId = settings.value("currentSessionId", "").toString();
+        state.clientSessionId = settings.value("clientSessionId", "").toString();
+    }
+
+    timeAccount.reset(state.elapsedMsecs);
+    isRunning = false; // Always start paused
+    // A session that was running when the app died comes back paused
+    isPaused = state.paused || state.running;
+    selectedTaskId = state.selectedTaskId;
+    currentSessionId = state.currentSessionId;
+    clientSessionId = state.clientSessionId;
+}
+
+void TrackerEngine::publishStatus()
+{
+    emit statusChanged(status());
+}
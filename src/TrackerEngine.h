@@ -0,0 +1,154 @@
+#ifndef TRACKERENGINE_H
+#define TRACKERENGINE_H
+
+#include <QObject>
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "ActivityLog.h"
+#include "SessionCache.h"
+#include "StateStore.h"
+#include "TaskCatalog.h"
+#include "TimeAccount.h"
+#include "UploadQueue.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTimer;
+class ApiClient;
+class TrackTimeHeartbeat;
+class EngineServer;
+
+// Snapshot of the engine for the UI and IPC clients. The elapsed time is
+// taken at steadyAt (TimeAccount::steadyNowMsecs()), so a viewer can keep
+// a running clock current without asking again every second.
+struct EngineStatus
+{
+    bool loggedIn = false;
+    int userId = -1;
+    QString userName;
+    bool running = false;
+    bool paused = false;
+    qint64 elapsedMsecs = 0;
+    qint64 steadyAt = 0;
+    int taskId = -1;
+    QString sessionId;
+    QString clientSessionId;
+    int pendingUploads = 0;
+    QString uploadError;
+    int retryInSecs = 0;
+
+    qint64 elapsedAt(qint64 steadyNow) const { return elapsedMsecs + (running ? qMax<qint64>(0, steadyNow - steadyAt) : 0); }
+
+    QJsonObject toJson() const;
+    static EngineStatus fromJson(const QJsonObject &json);
+};
+Q_DECLARE_METATYPE(EngineStatus)
+
+// The tracking core: session, timer accounting, crash-safe state,
+// heartbeats, local activity history and the upload queue, with no
+// dependency on QtGui. It is
+// meant to live on its own thread (see moveToThread() and initialize());
+// the desktop side (screenshots, idle detection) and the UI talk to it
+// through queued calls and signals, and other processes through the
+// EngineServer on a local socket. Every slot must be invoked in the
+// engine's thread.
+class TrackerEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TrackerEngine(QObject *parent = nullptr);
+    ~TrackerEngine();
+
+    // Local socket the engine is controlled through, per user
+    static QString socketName();
+
+    EngineStatus status() const;
+    // Per-task tracked time for the day or week holding `date`, answered
+    // from the local activity log and including the running interval
+    QJsonObject summary(ActivityLog::Period period, const QDate &date) const;
+
+public slots:
+    // Creates the network, queue and state objects in the current thread,
+    // restores the timer and any cached session, and starts listening for
+    // IPC clients
+    void initialize();
+    // Saves the timer state; call before the engine's thread stops
+    void shutdown();
+
+    void login(const QString &email, const QString &password);
+    void logout();
+
+    void setTask(int taskId);
+    void start();
+    void pause();
+    void resume();
+    void stop();
+
+    void enqueueUpload(const UploadItem &item);
+    // Input activity sampled on the desktop side; it rides along with the
+    // session's next heartbeat
+    void recordInputActivity(const QString &sessionClientId, const ActivityMinute &minute);
+    // Queues the totals of the days that changed since the last rollup
+    void sendRollups();
+    // Asks the host process to exit, e.g. a daemon told to quit over IPC
+    void requestQuit() { emit quitRequested(); }
+
+signals:
+    void statusChanged(const EngineStatus &status);
+    void sessionStarted(const QString &token, int userId, const QString &userName,
+                        const QJsonObject &screenshotPolicy, bool fromCache);
+    void loginFailed(const QString &title, const QString &message);
+    void sessionExpired();
+    // Tasks that came with the login payload
+    void tasksReceived(const QVector<TaskInfo> &tasks);
+    // The session just stopped; the desktop side takes its final screenshot
+    void trackingStopped(const QString &sessionId, const QString &clientSessionId);
+    void uploadDropped(const UploadItem &item, const QString &reason);
+    void quitRequested();
+
+private:
+    void handleLoginResponse(QNetworkReply *reply);
+    void handleSessionCheck(QNetworkReply *reply);
+    void startSession(const CachedSession &session, bool fromCache);
+    void restoreSession();
+    void handleUploadDelivered(const UploadItem &item, const QByteArray &response);
+    void enqueueTrackTime(const QJsonObject &json, const QString &tag,
+                          const QString &endpoint = "/api/v1/track-time");
+    void sendInputActivity(const QString &sessionClientId);
+    int serverSessionId(const QString &sessionClientId) const;
+    void saveTimerState();
+    void checkpointTimerState();
+    void restoreTimerState();
+    void publishStatus();
+
+    QNetworkAccessManager *networkManager;
+    ApiClient *apiClient;
+    UploadQueue *uploadQueue;
+    EngineServer *server;
+    std::unique_ptr<SessionCache> sessionCache;
+    std::unique_ptr<StateStore> stateStore;
+    std::unique_ptr<ActivityLog> activityLog;
+    QTimer *rollupTimer;
+    QTimer *checkpointTimer;
+    TrackTimeHeartbeat *heartbeat;
+    QHash<QString, QVector<ActivityMinute>> pendingActivity;
+    TimeAccount timeAccount;
+
+    QString token;
+    int userId;
+    QString userName;
+    int selectedTaskId;
+    QString currentSessionId;
+    QString clientSessionId; // generated locally, known even while offline
+    bool isRunning;
+    bool isPaused;
+
+    int pendingUploads;
+    QString uploadError;
+    int retryInSecs;
+};
+
+#endif // TRACKERENGINE_H
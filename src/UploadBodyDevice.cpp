@@ -0,0 +1,125 @@
+#include "UploadBodyDevice.h"
+#include <QMutex>
+#include <QVector>
+#include <cstring>
+
+namespace {
+
+// Chunks are recycled so steady uploads don't allocate per request
+constexpr int MaxPooledChunks = 8;
+
+QMutex poolMutex;
+QVector<QByteArray> freeChunks;
+qint64 leased = 0;
+
+QByteArray acquireChunk()
+{
+    QMutexLocker locker(&poolMutex);
+    leased += UploadBodyDevice::ChunkSize;
+    if (!freeChunks.isEmpty())
+        return freeChunks.takeLast();
+    return QByteArray(UploadBodyDevice::ChunkSize, Qt::Uninitialized);
+}
+
+void releaseChunk(QByteArray &chunk)
+{
+    if (chunk.isEmpty())
+        return;
+    QMutexLocker locker(&poolMutex);
+    leased -= UploadBodyDevice::ChunkSize;
+    if (freeChunks.size() < MaxPooledChunks)
+        freeChunks.append(chunk);
+    chunk = QByteArray();
+}
+
+}
+
+UploadBodyDevice::UploadBodyDevice(const QString &fileName, qint64 offset, qint64 bodyLength, QObject *parent)
+    : QIODevice(parent),
+      file(fileName),
+      start(offset),
+      length(bodyLength),
+      position(0),
+      chunkStart(0),
+      chunkFill(0)
+{
+}
+
+UploadBodyDevice::~UploadBodyDevice()
+{
+    close();
+}
+
+qint64 UploadBodyDevice::leasedBytes()
+{
+    QMutexLocker locker(&poolMutex);
+    return leased;
+}
+
+bool UploadBodyDevice::open(OpenMode mode)
+{
+    if (mode & WriteOnly)
+        return false;
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered) || file.size() < start + length) {
+        setErrorString(file.errorString());
+        file.close();
+        return false;
+    }
+    chunk = acquireChunk();
+    chunkFill = 0;
+    position = 0;
+    // The chunk is the only read buffer; QIODevice's own would double it
+    return QIODevice::open(mode | Unbuffered);
+}
+
+void UploadBodyDevice::close()
+{
+    if (!isOpen())
+        return;
+    QIODevice::close();
+    file.close();
+    releaseChunk(chunk);
+}
+
+bool UploadBodyDevice::seek(qint64 pos)
+{
+    if (pos < 0 || pos > length || !QIODevice::seek(pos))
+        return false;
+    position = pos;
+    return true;
+}
+
+qint64 UploadBodyDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 copied = 0;
+    while (copied < maxSize && position < length) {
+        if (position < chunkStart || position >= chunkStart + chunkFill) {
+            if (!fill(position))
+                return copied > 0 ? copied : -1;
+        }
+        const qint64 count = qMin(maxSize - copied, chunkStart + chunkFill - position);
+        std::memcpy(data + copied, chunk.constData() + (position - chunkStart), size_t(count));
+        copied += count;
+        position += count;
+    }
+    return copied;
+}
+
+qint64 UploadBodyDevice::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+bool UploadBodyDevice::fill(qint64 at)
+{
+    if (!file.seek(start + at))
+        return false;
+    const qint64 read = file.read(chunk.data(), qMin<qint64>(chunk.size(), length - at));
+    if (read <= 0) {
+        setErrorString(file.errorString());
+        return false;
+    }
+    chunkStart = at;
+    chunkFill = read;
+    return true;
+}
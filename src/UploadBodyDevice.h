@@ -0,0 +1,47 @@
+#ifndef UPLOADBODYDEVICE_H
+#define UPLOADBODYDEVICE_H
+
+#include <QIODevice>
+#include <QFile>
+
+// Read-only view of one upload body stored in the upload journal, handed to
+// Qt Network with setBodyDevice() so the body is streamed from disk instead
+// of being held in memory. The file is opened unbuffered and reads go
+// through a single chunk leased from a shared pool, so an open device never
+// holds more than ChunkSize bytes of its body.
+class UploadBodyDevice : public QIODevice
+{
+    Q_OBJECT
+public:
+    static constexpr qint64 ChunkSize = 256 * 1024;
+
+    UploadBodyDevice(const QString &fileName, qint64 offset, qint64 bodyLength, QObject *parent = nullptr);
+    ~UploadBodyDevice();
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return length; }
+    bool seek(qint64 pos) override;
+    qint64 bytesAvailable() const override { return length - position + QIODevice::bytesAvailable(); }
+
+    // Chunk memory currently leased by open devices, across all threads
+    static qint64 leasedBytes();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+    bool fill(qint64 at);
+
+    QFile file;
+    qint64 start;
+    qint64 length;
+    qint64 position;
+    QByteArray chunk;
+    qint64 chunkStart;
+    qint64 chunkFill;
+};
+
+#endif // UPLOADBODYDEVICE_H
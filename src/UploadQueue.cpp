@@ -0,0 +1,457 @@
+#include "UploadQueue.h"
+#include "PerfMonitor.h"
+#include "UploadBodyDevice.h"
+#include "ApiClient.h"
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QHttpMultiPart>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QTimer>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <QDebug>
+
+namespace {
+
+// Rewrite the journal once acknowledged records dominate it
+constexpr qint64 CompactThreshold = 16 * 1024 * 1024;
+constexpr quint32 MaxRecordSize = 256 * 1024 * 1024;
+constexpr qint64 MaxBackoffMsecs = 5 * 60 * 1000;
+// Bodies above this stay on disk and are streamed when sent
+constexpr qint64 InlineBodyLimit = 16 * 1024;
+constexpr qint64 DefaultMaxInFlightBytes = 32 * 1024 * 1024;
+// Enqueue records: [u8 version][u32 metadata length][metadata][body]
+constexpr quint8 RecordVersion = 2;
+
+QByteArray recordHeader(quint8 op, quint32 length)
+{
+    QByteArray header(5, Qt::Uninitialized);
+    qToLittleEndian<quint32>(length, header.data());
+    header[4] = char(op);
+    return header;
+}
+
+}
+
+UploadQueue::UploadQueue(ApiClient *client, const QString &directory, QObject *parent)
+    : QObject(parent),
+      apiClient(client),
+      inFlightBodyBytes(0),
+      maxInFlightBytes(DefaultMaxInFlightBytes),
+      nextId(0),
+      maxBatch(4),
+      consecutiveFailures(0),
+      batchFailed(false)
+{
+    qRegisterMetaType<UploadItem>();
+
+    retryTimer = new QTimer(this);
+    retryTimer->setSingleShot(true);
+    connect(retryTimer, &QTimer::timeout, this, &UploadQueue::drain);
+
+    QDir().mkpath(directory);
+    journal.setFileName(QDir(directory).filePath("upload-queue.journal"));
+    replay();
+}
+
+UploadQueue::~UploadQueue()
+{
+    journal.flush();
+}
+
+quint64 UploadQueue::enqueue(UploadItem item)
+{
+    item.id = nextId++;
+    item.attempts = 0;
+    appendEnqueue(item);
+    pending.insert(item.id, item);
+    PerfMonitor::instance()->setQueueDepth(PerfMonitor::Upload, pending.size());
+
+    emit statusChanged(pending.size(), lastErrorString, retryTimer->isActive() ? retryTimer->remainingTime() / 1000 : 0);
+    drain();
+    return item.id;
+}
+
+void UploadQueue::drain()
+{
+    if (!inFlight.isEmpty() || retryTimer->isActive() || !apiClient->hasToken() || apiClient->baseUrl().isEmpty())
+        return;
+
+    batchFailed = false;
+
+    // Track-time events must reach the server in order, so at most one of
+    // them is in flight; screenshots are independent and fill the batch up
+    // to the byte cap, though a single oversized item still goes alone
+    bool trackTimeQueued = false;
+    qint64 batchBytes = 0;
+    QList<quint64> batch;
+    for (auto it = pending.cbegin(); it != pending.cend() && batch.size() < maxBatch; ++it) {
+        if (it->kind == UploadItem::TrackTime) {
+            if (trackTimeQueued)
+                continue;
+            trackTimeQueued = true;
+        }
+        if (!batch.isEmpty() && batchBytes + it->bodyLength() > maxInFlightBytes)
+            continue;
+        batchBytes += it->bodyLength();
+        batch.append(it.key());
+    }
+
+    for (quint64 id : batch) {
+        inFlight.insert(id);
+        send(pending.value(id));
+    }
+}
+
+void UploadQueue::send(const UploadItem &item)
+{
+    QNetworkRequest request = apiClient->request(item.endpoint);
+    // Retries after a lost response must not be applied twice
+    request.setRawHeader("Idempotency-Key", QByteArray::number(item.id));
+
+    UploadBodyDevice *bodyDevice = nullptr;
+    if (item.bodyOffset >= 0) {
+        bodyDevice = new UploadBodyDevice(journal.fileName(), item.bodyOffset, item.bodySize);
+        if (!bodyDevice->open(QIODevice::ReadOnly)) {
+            const QString reason = "Could not read upload body: " + bodyDevice->errorString();
+            delete bodyDevice;
+            // The journal won't get any more readable; keeping the item
+            // would fail every batch from now on
+            QMetaObject::invokeMethod(this, [this, id = item.id, reason]() {
+                inFlight.remove(id);
+                if (pending.contains(id)) {
+                    const UploadItem item = pending.take(id);
+                    acknowledge(id);
+                    qWarning() << "Dropping upload" << id << reason;
+                    emit dropped(item, reason);
+                    PerfMonitor::instance()->setQueueDepth(PerfMonitor::Upload, pending.size());
+                }
+                if (inFlight.isEmpty())
+                    finishBatch();
+            }, Qt::QueuedConnection);
+            return;
+        }
+    }
+
+    QNetworkReply *reply = nullptr;
+    if (item.kind == UploadItem::Screenshot) {
+        reply = apiClient->post(request, buildMultiPart(item, bodyDevice));
+    } else if (bodyDevice) {
+        reply = apiClient->post(request, bodyDevice, item.contentType);
+    } else {
+        reply = apiClient->post(request, item.body, item.contentType);
+    }
+
+    const quint64 id = item.id;
+    sendStarted.insert(id, PerfMonitor::nowNsecs());
+    inFlightBodyBytes += item.bodyLength();
+    PerfMonitor::instance()->addBytes(PerfMonitor::Upload, item.bodyLength());
+    reportMemory();
+    connect(reply, &QNetworkReply::finished, this, [this, id, reply]() {
+        handleReply(id, reply);
+    });
+}
+
+QHttpMultiPart *UploadQueue::buildMultiPart(const UploadItem &item, QIODevice *bodyDevice)
+{
+    QHttpMultiPart *multiPart = new QHttpMultiPart(QHttpMultiPart::FormDataType);
+
+    QHttpPart filePart;
+    filePart.setHeader(QNetworkRequest::ContentDispositionHeader,
+                       QVariant("form-data; name=\"screenshot\"; filename=\"" + item.fileName + "\""));
+    filePart.setHeader(QNetworkRequest::ContentTypeHeader, QVariant(item.contentType));
+    if (bodyDevice) {
+        filePart.setBodyDevice(bodyDevice);
+        bodyDevice->setParent(multiPart);
+    } else {
+        filePart.setBody(item.body);
+    }
+    multiPart->append(filePart);
+
+    for (auto it = item.fields.cbegin(); it != item.fields.cend(); ++it) {
+        QHttpPart fieldPart;
+        fieldPart.setHeader(QNetworkRequest::ContentDispositionHeader,
+                            QVariant("form-data; name=\"" + it.key() + "\""));
+        fieldPart.setBody(it.value().toString().toUtf8());
+        multiPart->append(fieldPart);
+    }
+
+    return multiPart;
+}
+
+void UploadQueue::handleReply(quint64 id, QNetworkReply *reply)
+{
+    inFlight.remove(id);
+    inFlightBodyBytes -= pending.value(id).bodyLength();
+    // Release the journal handle and pooled chunk now rather than with the
+    // reply, so compaction below can replace the file
+    const QList<UploadBodyDevice *> devices = reply->findChildren<UploadBodyDevice *>();
+    for (UploadBodyDevice *device : devices)
+        device->close();
+    const qint64 started = sendStarted.take(id);
+    PerfMonitor::instance()->recordLatency(PerfMonitor::Upload, started, PerfMonitor::nowNsecs() - started);
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if (reply->error() == QNetworkReply::NoError) {
+        const UploadItem item = pending.take(id);
+        acknowledge(id);
+        emit delivered(item, reply->readAll());
+    } else if (status >= 400 && status < 500 && status != 401 && status != 403
+               && status != 408 && status != 429) {
+        // The server rejected the item itself; retrying can't help
+        const UploadItem item = pending.take(id);
+        acknowledge(id);
+        qWarning() << "Upload rejected, dropping item" << id << reply->errorString();
+        emit dropped(item, reply->errorString());
+    } else {
+        batchFailed = true;
+        lastErrorString = reply->errorString();
+        if (pending.contains(id))
+            pending[id].attempts++;
+    }
+
+    reply->deleteLater();
+    PerfMonitor::instance()->setQueueDepth(PerfMonitor::Upload, pending.size());
+    reportMemory();
+
+    if (inFlight.isEmpty())
+        finishBatch();
+}
+
+void UploadQueue::finishBatch()
+{
+    if (batchFailed) {
+        ++consecutiveFailures;
+        const qint64 ceiling = qMin<qint64>(MaxBackoffMsecs, 1000LL << qMin(consecutiveFailures, 9));
+        // Half fixed, half random so restarting clients don't retry in lockstep
+        const qint64 delay = ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1);
+        retryTimer->start(int(delay));
+    } else {
+        consecutiveFailures = 0;
+        lastErrorString.clear();
+        compactIfIdle();
+    }
+
+    emit statusChanged(pending.size(), lastErrorString, retryTimer->isActive() ? retryTimer->remainingTime() / 1000 : 0);
+
+    if (!batchFailed && !pending.isEmpty())
+        QTimer::singleShot(0, this, &UploadQueue::drain);
+}
+
+void UploadQueue::reportMemory()
+{
+    // Journaled bodies cost one pooled chunk each while sending; small ones
+    // are held inline
+    qint64 inlineBytes = 0;
+    for (quint64 id : std::as_const(inFlight))
+        inlineBytes += pending.value(id).body.size();
+    PerfMonitor::instance()->setMemoryBytes(PerfMonitor::Upload, inlineBytes + UploadBodyDevice::leasedBytes());
+}
+
+void UploadQueue::replay()
+{
+    if (!journal.open(QIODevice::ReadWrite)) {
+        qWarning() << "Could not open upload journal" << journal.fileName() << journal.errorString();
+        return;
+    }
+
+    quint64 lastId = 0;
+    qint64 validEnd = 0;
+    const qint64 fileSize = journal.size();
+    while (true) {
+        const QByteArray header = journal.read(5);
+        if (header.size() < 5)
+            break;
+        const quint32 length = qFromLittleEndian<quint32>(header.constData());
+        const qint64 recordEnd = journal.pos() + length;
+        if (length > MaxRecordSize || recordEnd > fileSize)
+            break;
+
+        if (quint8(header[4]) == Enqueue) {
+            UploadItem item;
+            if (readEnqueue(recordEnd, item)) {
+                pending.insert(item.id, item);
+                lastId = qMax(lastId, item.id);
+            }
+        } else if (quint8(header[4]) == Ack && length == 8) {
+            pending.remove(qFromLittleEndian<quint64>(journal.read(8).constData()));
+        }
+
+        if (!journal.seek(recordEnd))
+            break;
+        validEnd = recordEnd;
+    }
+
+    // A crash mid-append leaves a torn record at the tail; drop it
+    if (validEnd < journal.size())
+        journal.resize(validEnd);
+
+    // Ids double as idempotency keys, so they must not repeat after the
+    // journal has been truncated
+    nextId = qMax<quint64>(lastId + 1, quint64(QDateTime::currentMSecsSinceEpoch()) * 1000);
+
+    if (!pending.isEmpty())
+        qInfo() << "Upload queue restored" << pending.size() << "pending items";
+}
+
+void UploadQueue::appendRecord(Op op, const QByteArray &payload)
+{
+    if (!journal.isOpen())
+        return;
+
+    journal.seek(journal.size());
+    journal.write(recordHeader(op, quint32(payload.size())) + payload);
+    journal.flush();
+}
+
+void UploadQueue::appendEnqueue(UploadItem &item)
+{
+    if (!journal.isOpen())
+        return;
+
+    // Header, metadata and body are written separately so the body is never
+    // copied into a combined record buffer
+    journal.seek(journal.size());
+    journal.write(enqueuePrefix(item, item.body.size()));
+    const qint64 offset = journal.pos();
+    const bool written = journal.write(item.body) == item.body.size();
+    journal.flush();
+
+    if (written && item.body.size() > InlineBodyLimit) {
+        item.bodyOffset = offset;
+        item.bodySize = item.body.size();
+        item.body = QByteArray();
+    }
+}
+
+bool UploadQueue::readEnqueue(qint64 recordEnd, UploadItem &item)
+{
+    const QByteArray version = journal.peek(1);
+    if (version.isEmpty())
+        return false;
+
+    if (quint8(version[0]) == 1)
+        return deserializeV1(journal.read(recordEnd - journal.pos()), item);
+
+    const QByteArray prefix = journal.read(5);
+    if (prefix.size() < 5 || quint8(prefix[0]) != RecordVersion)
+        return false;
+    const quint32 metaLength = qFromLittleEndian<quint32>(prefix.constData() + 1);
+    if (journal.pos() + metaLength > recordEnd || !deserializeMeta(journal.read(metaLength), item))
+        return false;
+
+    const qint64 bodyLength = recordEnd - journal.pos();
+    if (bodyLength > InlineBodyLimit) {
+        item.bodyOffset = journal.pos();
+        item.bodySize = bodyLength;
+    } else {
+        item.body = journal.read(bodyLength);
+    }
+    return true;
+}
+
+void UploadQueue::acknowledge(quint64 id)
+{
+    QByteArray payload(8, Qt::Uninitialized);
+    qToLittleEndian<quint64>(id, payload.data());
+    appendRecord(Ack, payload);
+}
+
+void UploadQueue::compactIfIdle()
+{
+    if (!journal.isOpen() || !inFlight.isEmpty())
+        return;
+
+    if (pending.isEmpty()) {
+        journal.resize(0);
+        return;
+    }
+
+    if (journal.size() < CompactThreshold)
+        return;
+
+    QSaveFile out(journal.fileName());
+    if (!out.open(QIODevice::WriteOnly))
+        return;
+
+    // Journaled bodies are copied across in chunks and get new offsets
+    QHash<quint64, qint64> movedBodies;
+    QByteArray chunk;
+    for (const UploadItem &item : std::as_const(pending)) {
+        out.write(enqueuePrefix(item, item.bodyLength()));
+        if (item.bodyOffset < 0) {
+            out.write(item.body);
+            continue;
+        }
+        movedBodies.insert(item.id, out.pos());
+        chunk.resize(UploadBodyDevice::ChunkSize);
+        journal.seek(item.bodyOffset);
+        for (qint64 left = item.bodySize; left > 0;) {
+            const qint64 read = journal.read(chunk.data(), qMin<qint64>(chunk.size(), left));
+            if (read <= 0) {
+                qWarning() << "Upload journal compaction failed" << journal.errorString();
+                out.cancelWriting();
+                return;
+            }
+            out.write(chunk.constData(), read);
+            left -= read;
+        }
+    }
+
+    journal.close();
+    if (out.commit()) {
+        for (auto it = movedBodies.cbegin(); it != movedBodies.cend(); ++it)
+            pending[it.key()].bodyOffset = it.value();
+    } else {
+        qWarning() << "Upload journal compaction failed" << out.errorString();
+    }
+    if (!journal.open(QIODevice::ReadWrite))
+        qWarning() << "Could not reopen upload journal" << journal.errorString();
+}
+
+QByteArray UploadQueue::enqueuePrefix(const UploadItem &item, qint64 bodyLength)
+{
+    QByteArray meta;
+    QDataStream out(&meta, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << item.id << quint8(item.kind) << item.endpoint << item.tag
+        << item.contentType << item.fileName << item.fields;
+
+    QByteArray prefix = recordHeader(Enqueue, quint32(5 + meta.size() + bodyLength));
+    prefix.append(char(RecordVersion));
+    char metaLength[4];
+    qToLittleEndian<quint32>(quint32(meta.size()), metaLength);
+    prefix.append(metaLength, 4);
+    prefix.append(meta);
+    return prefix;
+}
+
+bool UploadQueue::deserializeMeta(const QByteArray &data, UploadItem &item)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint8 kind = 0;
+    in >> item.id >> kind >> item.endpoint >> item.tag
+       >> item.contentType >> item.fileName >> item.fields;
+    item.kind = UploadItem::Kind(kind);
+    return in.status() == QDataStream::Ok;
+}
+
+// Journals written before bodies were streamed keep them inline
+bool UploadQueue::deserializeV1(const QByteArray &data, UploadItem &item)
+{
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint8 version = 0;
+    quint8 kind = 0;
+    in >> version;
+    if (version != 1)
+        return false;
+    in >> item.id >> kind >> item.endpoint >> item.tag
+       >> item.contentType >> item.body >> item.fileName >> item.fields;
+    item.kind = UploadItem::Kind(kind);
+    return in.status() == QDataStream::Ok;
+}
@@ -0,0 +1,107 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <QObject>
+#include <QFile>
+#include <QMap>
+#include <QSet>
+#include <QHash>
+#include <QVariantMap>
+
+class ApiClient;
+class QNetworkReply;
+class QHttpMultiPart;
+class QTimer;
+
+struct UploadItem
+{
+    // ScreenshotRef posts its body as is and names a blob the server is
+    // expected to have; fields and fileName describe the full upload
+    enum Kind : quint8 { TrackTime = 1, Screenshot = 2, ScreenshotRef = 3 };
+
+    quint64 id = 0;
+    Kind kind = TrackTime;
+    QString endpoint;       // path below the API base URL
+    QString tag;            // lets the owner recognise the item on delivery
+    QByteArray contentType;
+    QByteArray body;        // empty once a large body lives in the journal
+    QString fileName;       // Screenshot only, sent as multipart form data
+    QVariantMap fields;     // Screenshot only, extra form fields
+    int attempts = 0;
+    qint64 bodyOffset = -1; // position of the body in the journal, if spilled
+    qint64 bodySize = 0;
+
+    qint64 bodyLength() const { return bodyOffset >= 0 ? bodySize : body.size(); }
+};
+Q_DECLARE_METATYPE(UploadItem)
+
+// Durable outbound queue. Every item is appended to an on-disk journal
+// before it is sent and acknowledged in the journal once the server has
+// accepted it, so nothing is lost across network outages or restarts.
+// Items drain in small batches through the ApiClient (which keeps
+// connections alive) and failed batches back off exponentially with
+// full jitter. Large bodies are not kept in memory: once journaled they are
+// streamed back from the journal file when sent, and a byte cap bounds how
+// much body data is in flight at once.
+class UploadQueue : public QObject
+{
+    Q_OBJECT
+public:
+    UploadQueue(ApiClient *client, const QString &directory, QObject *parent = nullptr);
+    ~UploadQueue();
+
+    void setMaxBatch(int count) { maxBatch = qMax(1, count); }
+    void setMaxInFlightBytes(qint64 bytes) { maxInFlightBytes = qMax<qint64>(1, bytes); }
+
+    quint64 enqueue(UploadItem item);
+
+    int pendingCount() const { return pending.size(); }
+    qint64 inFlightBytes() const { return inFlightBodyBytes; }
+
+    // Caller owns the result. With a body device the part streams from it
+    // and the multipart takes ownership of the device.
+    static QHttpMultiPart *buildMultiPart(const UploadItem &item, QIODevice *bodyDevice = nullptr);
+    QString lastError() const { return lastErrorString; }
+
+public slots:
+    void drain();
+
+signals:
+    void delivered(const UploadItem &item, const QByteArray &response);
+    void dropped(const UploadItem &item, const QString &reason);
+    void statusChanged(int pending, const QString &lastError, int retryInSecs);
+
+private:
+    enum Op : quint8 { Enqueue = 1, Ack = 2 };
+
+    void replay();
+    void appendRecord(Op op, const QByteArray &payload);
+    void appendEnqueue(UploadItem &item);
+    bool readEnqueue(qint64 recordEnd, UploadItem &item);
+    void acknowledge(quint64 id);
+    void compactIfIdle();
+    void send(const UploadItem &item);
+    void handleReply(quint64 id, QNetworkReply *reply);
+    void finishBatch();
+    void reportMemory();
+
+    static QByteArray enqueuePrefix(const UploadItem &item, qint64 bodyLength);
+    static bool deserializeMeta(const QByteArray &data, UploadItem &item);
+    static bool deserializeV1(const QByteArray &data, UploadItem &item);
+
+    ApiClient *apiClient;
+    QFile journal;
+    QMap<quint64, UploadItem> pending;
+    QSet<quint64> inFlight;
+    QHash<quint64, qint64> sendStarted; // PerfMonitor clock
+    qint64 inFlightBodyBytes;
+    qint64 maxInFlightBytes;
+    quint64 nextId;
+    int maxBatch;
+    int consecutiveFailures;
+    bool batchFailed;
+    QString lastErrorString;
+    QTimer *retryTimer;
+};
+
+#endif // UPLOADQUEUE_H
@@ -0,0 +1,48 @@
+#include "X11IdleBackend.h"
+
+// Xlib macros (None, Bool, Status...) clash with Qt, keep them last
+#include <X11/Xlib.h>
+#include <X11/extensions/scrnsaver.h>
+
+struct X11IdleBackend::Private
+{
+    Display *display = nullptr;
+    XScreenSaverInfo *info = nullptr;
+};
+
+X11IdleBackend::X11IdleBackend()
+    : d(new Private)
+{
+    d->display = XOpenDisplay(nullptr);
+    if (d->display)
+        d->info = XScreenSaverAllocInfo();
+}
+
+X11IdleBackend::~X11IdleBackend()
+{
+    if (d->info)
+        XFree(d->info);
+    if (d->display)
+        XCloseDisplay(d->display);
+}
+
+bool X11IdleBackend::isAvailable()
+{
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+        return false;
+    int eventBase = 0;
+    int errorBase = 0;
+    const bool available = XScreenSaverQueryExtension(display, &eventBase, &errorBase);
+    XCloseDisplay(display);
+    return available;
+}
+
+qint64 X11IdleBackend::idleMsecs()
+{
+    if (!d->display || !d->info)
+        return -1;
+    if (!XScreenSaverQueryInfo(d->display, DefaultRootWindow(d->display), d->info))
+        return -1;
+    return qint64(d->info->idle);
+}
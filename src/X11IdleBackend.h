@@ -0,0 +1,24 @@
+#ifndef X11IDLEBACKEND_H
+#define X11IDLEBACKEND_H
+
+#include "IdleMonitor.h"
+#include <memory>
+
+// System-wide idle time from the X server's MIT-SCREEN-SAVER extension,
+// queried over a private display connection
+class X11IdleBackend : public IdleBackend
+{
+public:
+    X11IdleBackend();
+    ~X11IdleBackend();
+
+    static bool isAvailable();
+    const char *name() const override { return "xss"; }
+    qint64 idleMsecs() override;
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+
+#endif // X11IDLEBACKEND_H
@@ -0,0 +1,150 @@
+#include "X11InputSource.h"
+#include <QThread>
+#include <QDebug>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+
+// Xlib macros (None, Bool, Status...) clash with Qt, keep them last
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+namespace {
+
+constexpr int BatchMsecs = 100;
+
+bool queryXInput2(Display *display, int *opcode)
+{
+    int event = 0;
+    int error = 0;
+    if (!XQueryExtension(display, "XInputExtension", opcode, &event, &error))
+        return false;
+    int major = 2;
+    int minor = 0;
+    return XIQueryVersion(display, &major, &minor) == Success;
+}
+
+}
+
+struct X11InputSource::Private
+{
+    Display *display = nullptr;
+    int opcode = 0;
+    int wake[2] = { -1, -1 };
+    QThread *thread = nullptr;
+};
+
+X11InputSource::X11InputSource()
+    : d(new Private)
+{
+}
+
+X11InputSource::~X11InputSource()
+{
+    stop();
+}
+
+bool X11InputSource::isAvailable()
+{
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+        return false;
+    int opcode = 0;
+    const bool available = queryXInput2(display, &opcode);
+    XCloseDisplay(display);
+    return available;
+}
+
+bool X11InputSource::start()
+{
+    if (d->thread)
+        return true;
+
+    d->display = XOpenDisplay(nullptr);
+    if (!d->display || !queryXInput2(d->display, &d->opcode) || pipe(d->wake) != 0) {
+        stop();
+        return false;
+    }
+
+    // Raw events carry no window or position and reach the root whichever
+    // client has focus
+    unsigned char bits[XIMaskLen(XI_LASTEVENT)] = {};
+    XISetMask(bits, XI_RawKeyPress);
+    XISetMask(bits, XI_RawButtonPress);
+    XISetMask(bits, XI_RawMotion);
+    XIEventMask mask;
+    mask.deviceid = XIAllMasterDevices;
+    mask.mask_len = sizeof(bits);
+    mask.mask = bits;
+    XISelectEvents(d->display, DefaultRootWindow(d->display), &mask, 1);
+    XFlush(d->display);
+
+    d->thread = QThread::create([this]() { run(); });
+    d->thread->start();
+    return true;
+}
+
+void X11InputSource::stop()
+{
+    if (d->thread) {
+        const char byte = 0;
+        if (write(d->wake[1], &byte, 1) != 1)
+            qWarning() << "Could not wake the input thread" << errno;
+        d->thread->wait();
+        delete d->thread;
+        d->thread = nullptr;
+    }
+    for (int &fd : d->wake) {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+    if (d->display) {
+        XCloseDisplay(d->display);
+        d->display = nullptr;
+    }
+}
+
+void X11InputSource::run()
+{
+    pollfd fds[2] = {
+        { ConnectionNumber(d->display), POLLIN, 0 },
+        { d->wake[0], POLLIN, 0 },
+    };
+
+    for (;;) {
+        bool moved = false;
+        while (XPending(d->display)) {
+            XEvent event;
+            XNextEvent(d->display, &event);
+            // The cookie's type is all that's needed; its data, key codes
+            // and deltas included, is never fetched and Xlib drops it
+            const XGenericEventCookie &cookie = event.xcookie;
+            if (cookie.type != GenericEvent || cookie.extension != d->opcode)
+                continue;
+            switch (cookie.evtype) {
+            case XI_RawKeyPress:
+                InputCounters::add(InputCounters::Key);
+                break;
+            case XI_RawButtonPress:
+                InputCounters::add(InputCounters::Click);
+                break;
+            case XI_RawMotion:
+                moved = true;
+                break;
+            default:
+                break;
+            }
+        }
+        if (moved)
+            InputCounters::add(InputCounters::Move);
+
+        // Wait for input, then let a batch pile up in the socket
+        if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            return;
+        if (fds[1].revents)
+            return;
+        if (poll(&fds[1], 1, BatchMsecs) > 0)
+            return;
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef X11INPUTSOURCE_H
+#define X11INPUTSOURCE_H
+
+#include "InputActivity.h"
+#include <memory>
+
+// System-wide input counts from XInput2 raw events on the root window,
+// read over a private display connection by a thread of its own
+class X11InputSource : public InputEventSource
+{
+public:
+    X11InputSource();
+    ~X11InputSource();
+
+    static bool isAvailable();
+    const char *name() const override { return "xinput2"; }
+    bool start() override;
+    void stop() override;
+
+private:
+    void run();
+
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+
+#endif // X11INPUTSOURCE_H
@@ -0,0 +1,146 @@
+#include "X11ShmCaptureSource.h"
+#include <QVector>
+#include <QScreen>
+#include <QDebug>
+
+// Xlib macros (None, Bool, Status...) clash with Qt, keep them last
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+struct X11ShmCaptureSource::Private
+{
+    Display *display = nullptr;
+    Window root = 0;
+    QPoint origin;
+    QVector<XImage *> images;
+    QVector<XShmSegmentInfo> segments;
+};
+
+X11ShmCaptureSource::X11ShmCaptureSource(QObject *parent)
+    : CaptureSource(parent),
+      d(new Private)
+{
+}
+
+X11ShmCaptureSource::~X11ShmCaptureSource()
+{
+    stop();
+}
+
+bool X11ShmCaptureSource::isAvailable()
+{
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+        return false;
+    const bool available = XShmQueryExtension(display);
+    XCloseDisplay(display);
+    return available;
+}
+
+bool X11ShmCaptureSource::open()
+{
+    d->display = XOpenDisplay(nullptr);
+    if (!d->display)
+        return false;
+
+    const int screen = DefaultScreen(d->display);
+    d->root = RootWindow(d->display, screen);
+    // Only the selected monitor's part of the root window
+    QRect area(0, 0, DisplayWidth(d->display, screen), DisplayHeight(d->display, screen));
+    if (QScreen *selected = selectedScreen()) {
+        const qreal ratio = selected->devicePixelRatio();
+        const QRect geometry = selected->geometry();
+        area &= QRect(geometry.topLeft() * ratio, geometry.size() * ratio);
+    }
+    if (area.isEmpty()) {
+        close();
+        return false;
+    }
+    d->origin = area.topLeft();
+    const int width = area.width();
+    const int height = area.height();
+    Visual *visual = DefaultVisual(d->display, screen);
+    const int depth = DefaultDepth(d->display, screen);
+
+    d->images.fill(nullptr, frameRing.slotCount());
+    d->segments.resize(frameRing.slotCount());
+
+    for (int i = 0; i < frameRing.slotCount(); ++i) {
+        XShmSegmentInfo &segment = d->segments[i];
+        segment.shmid = -1;
+        segment.shmaddr = nullptr;
+
+        XImage *image = XShmCreateImage(d->display, visual, depth, ZPixmap, nullptr, &segment, width, height);
+        if (!image || image->bits_per_pixel != 32) {
+            qWarning() << "XShm capture needs a 32 bpp visual";
+            if (image)
+                XDestroyImage(image);
+            close();
+            return false;
+        }
+        d->images[i] = image;
+
+        segment.shmid = shmget(IPC_PRIVATE, size_t(image->bytes_per_line) * image->height, IPC_CREAT | 0600);
+        if (segment.shmid < 0) {
+            close();
+            return false;
+        }
+        char *address = static_cast<char *>(shmat(segment.shmid, nullptr, 0));
+        if (address == reinterpret_cast<char *>(-1)) {
+            close();
+            return false;
+        }
+        segment.shmaddr = image->data = address;
+        segment.readOnly = False;
+        if (!XShmAttach(d->display, &segment)) {
+            shmdt(address);
+            segment.shmaddr = image->data = nullptr;
+            close();
+            return false;
+        }
+        XSync(d->display, False);
+        // Freed by the kernel once both sides detach, even after a crash
+        shmctl(segment.shmid, IPC_RMID, nullptr);
+
+        frameRing.attach(i, reinterpret_cast<uchar *>(image->data), width, height, image->bytes_per_line);
+    }
+
+    size = QSize(width, height);
+    return true;
+}
+
+void X11ShmCaptureSource::close()
+{
+    if (!d->display)
+        return;
+
+    for (int i = 0; i < d->images.size(); ++i) {
+        XShmSegmentInfo &segment = d->segments[i];
+        if (segment.shmaddr) {
+            XShmDetach(d->display, &segment);
+            shmdt(segment.shmaddr);
+        } else if (segment.shmid >= 0) {
+            shmctl(segment.shmid, IPC_RMID, nullptr);
+        }
+        if (d->images[i]) {
+            d->images[i]->data = nullptr;
+            XDestroyImage(d->images[i]);
+        }
+    }
+    d->images.clear();
+    d->segments.clear();
+
+    XCloseDisplay(d->display);
+    d->display = nullptr;
+}
+
+bool X11ShmCaptureSource::grab(int slot)
+{
+    XImage *image = d->images.value(slot);
+    if (!image)
+        return false;
+    return XShmGetImage(d->display, d->root, image, d->origin.x(), d->origin.y(), AllPlanes);
+}
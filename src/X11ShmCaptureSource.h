@@ -0,0 +1,32 @@
+#ifndef X11SHMCAPTURESOURCE_H
+#define X11SHMCAPTURESOURCE_H
+
+#include "CaptureSource.h"
+#include <memory>
+
+// MIT-SHM capture of the X11 root window. Every ring slot is its own
+// shared-memory segment, so the X server writes pixels straight into the
+// buffer the preview and the ffmpeg pipe read from. Grabs run on the
+// capture thread over a private display connection.
+class X11ShmCaptureSource : public CaptureSource
+{
+    Q_OBJECT
+public:
+    explicit X11ShmCaptureSource(QObject *parent = nullptr);
+    ~X11ShmCaptureSource();
+
+    static bool isAvailable();
+    const char *backendName() const override { return "xshm"; }
+
+protected:
+    bool open() override;
+    void close() override;
+    bool grab(int slot) override;
+    bool grabsOffThread() const override { return true; }
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+
+#endif // X11SHMCAPTURESOURCE_H
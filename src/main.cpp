@@ -1,12 +1,134 @@
 #include <QApplication>
+#include <QMessageBox>
+#include <QSettings>
+#include <QThread>
+#include <QDebug>
+#include <memory>
+#include "DesktopAgent.h"
+#include "EngineClient.h"
+#include "PerfMonitor.h"
 #include "TimeTrackerApp.h"
+#include "TrackerEngine.h"
 
+namespace {
+
+bool hasArgument(int argc, char *argv[], const char *name)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Without a display there is nothing to grab or to watch for input, and
+// QGuiApplication would refuse to start
+bool displayAvailable()
+{
+#if defined(Q_OS_UNIX) && !defined(Q_OS_MACOS)
+    return !qEnvironmentVariableIsEmpty("DISPLAY") || !qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")
+        || !qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM");
+#else
+    return true;
+#endif
+}
+
+}
+
+// Usage: TimeTrackerApp                  window
+//        TimeTrackerApp --daemon         no widgets; add --no-desktop to skip
+//                                        screenshots and idle detection
+//        TimeTrackerApp --ctl <command>  control the running instance
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // Startup phases are measured from here
+    PerfMonitor::nowNsecs();
+
+    if (hasArgument(argc, argv, "--ctl")) {
+        QCoreApplication a(argc, argv);
+        const QStringList arguments = a.arguments();
+        return EngineClient::runCommand(arguments.mid(arguments.indexOf("--ctl") + 1));
+    }
+
+    const bool daemon = hasArgument(argc, argv, "--daemon");
+    const bool desktop = !daemon || (!hasArgument(argc, argv, "--no-desktop") && displayAvailable());
+    std::unique_ptr<QCoreApplication> a;
+    if (!daemon)
+        a.reset(new QApplication(argc, argv));
+    else if (desktop)
+        a.reset(new QGuiApplication(argc, argv));
+    else
+        a.reset(new QCoreApplication(argc, argv));
+
+    // One engine per user owns the state log and the upload journal
+    if (EngineClient::isEngineRunning(TrackerEngine::socketName())) {
+        const QString message = "TimeTracker is already running; control it with --ctl.";
+        if (daemon)
+            qCritical().noquote() << message;
+        else
+            QMessageBox::warning(nullptr, "TimeTracker", message);
+        return 1;
+    }
+
+    // Instrumentation is always recorded; logging and the localhost
+    // endpoint are opt-in
+    QSettings perfSettings("YourCompany", "TimeTrackerApp");
+    PerfMonitor *perf = PerfMonitor::instance();
+    perf->startLogging(perfSettings.value("perf/logIntervalSecs", 0).toInt());
+    if (int port = perfSettings.value("perf/debugPort", 0).toInt())
+        perf->startDebugServer(quint16(port));
+
+    // Network, disk and accounting run on the engine's thread, off the one
+    // that paints
+    QThread engineThread;
+    engineThread.setObjectName("TrackerEngine");
+    TrackerEngine *engine = new TrackerEngine;
+    engine->moveToThread(&engineThread);
+    QObject::connect(&engineThread, &QThread::finished, engine, &QObject::deleteLater);
+    QObject::connect(engine, &TrackerEngine::quitRequested, a.get(), &QCoreApplication::quit);
+
+    std::unique_ptr<DesktopAgent> agent;
+    if (desktop) {
+        agent.reset(new DesktopAgent);
+        agent->attach(engine);
+    }
+
+    std::unique_ptr<TimeTrackerApp> window;
+    if (!daemon) {
+        window.reset(new TimeTrackerApp(engine, agent.get()));
+    } else if (agent && agent->idleMonitor()->isSystemWide()) {
+        // Nobody to ask: an idle user's session is paused
+        QObject::connect(agent.get(), &DesktopAgent::idleDetected, engine, [engine](qint64 idleMsecs) {
+            qInfo() << "Idle for" << idleMsecs / 1000 << "s, pausing";
+            engine->pause();
+        });
+    } else if (agent) {
+        // A windowless daemon gets no input events of its own, so this
+        // backend would call every user idle
+        qWarning() << "No system-wide idle time with the" << agent->idleMonitor()->backendName()
+                   << "backend, AFK detection is off";
+    }
+
+    engineThread.start();
+    QMetaObject::invokeMethod(engine, &TrackerEngine::initialize, Qt::BlockingQueuedConnection);
+    // Deliver the restored session before the first paint
+    QCoreApplication::sendPostedEvents(nullptr, QEvent::MetaCall);
+
+    if (window)
+        window->show();
+    else
+        qInfo().noquote() << "TimeTracker daemon running, control socket" << TrackerEngine::socketName();
+
+    const int code = a->exec();
 
-    TimeTrackerApp app;
-    app.show();
+    QMetaObject::invokeMethod(engine, &TrackerEngine::shutdown, Qt::BlockingQueuedConnection);
+    engineThread.quit();
+    engineThread.wait();
+    window.reset();
+    agent.reset();
 
-    return a.exec();
+    const QString traceFile = perfSettings.value("perf/traceFile").toString();
+    if (!traceFile.isEmpty())
+        perf->exportTrace(traceFile);
+    return code;
 }